@@ -0,0 +1,161 @@
+// Floods a pty with `cat` of a large file and drains it through a PaneReader and an
+// EventLoop, as the multiplexer does, once per backend. Prints one JSON object per backend.
+
+#include <pty.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <event_loop.hpp>
+#include <pane_reader.hpp>
+#include <utils.hpp>
+
+#define FLOOD_SIZE (8 * 1024 * 1024)
+#define FLOOD_LINE 80
+
+static std::string make_flood_file() {
+    char path[] = "/tmp/ishell_bench_flood_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+
+    std::string line;
+    for (int i = 0; i < FLOOD_LINE - 1; i++) {
+        line += static_cast<char>('a' + i % 26);
+    }
+    line += '\n';
+
+    std::string block;
+    while (block.size() < 1024 * 1024) {
+        block += line;
+    }
+
+    for (size_t written = 0; written < FLOOD_SIZE; written += block.size()) {
+        if (write(fd, block.data(), block.size()) != static_cast<ssize_t>(block.size())) {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    close(fd);
+    return path;
+}
+
+static int spawn_cat(const std::string &path, int &pid) {
+    int master, slave;
+
+    // Raw, so the byte count on the master matches the file
+    termios tios{};
+    cfmakeraw(&tios);
+
+    if (openpty(&master, &slave, nullptr, &tios, nullptr) == -1) {
+        perror("openpty");
+        exit(EXIT_FAILURE);
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        close(master);
+        setsid();
+        ioctl(slave, TIOCSCTTY, NULL);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        close(slave);
+
+        execlp("cat", "cat", path.c_str(), NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    close(slave);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL, 0) | O_NONBLOCK);
+
+    return master;
+}
+
+static uint64_t cpu_ns() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+static void bench_backend(const char *name, const LoopBackend backend, const std::string &path) {
+    int pid;
+    const int master = spawn_cat(path, pid);
+
+    const std::unique_ptr<EventLoop> loop = make_event_loop(backend);
+    PaneReader reader(master, loop->get_backend());
+
+    loop->add(reader.get_notify_fd(), EPOLLIN);
+
+    size_t bytes = 0, chunks = 0, wakeups = 0;
+    const uint64_t cpu_start = cpu_ns();
+    const uint64_t start = monotonic_ns();
+
+    reader.start();
+
+    bool done = false;
+    while (!done) {
+        LoopEvent events[MAX_EVENTS];
+        if (loop->wait(events, MAX_EVENTS, -1) <= 0) {
+            continue;
+        }
+
+        wakeups++;
+        reader.clear_notification();
+
+        PaneChunk chunk;
+        while (reader.pop(chunk)) {
+            if (chunk.n_bytes < 0) {
+                done = true;
+                break;
+            }
+
+            bytes += chunk.n_bytes;
+            chunks++;
+        }
+    }
+
+    const uint64_t ns = monotonic_ns() - start;
+    const uint64_t cpu = cpu_ns() - cpu_start;
+
+    printf("{\"bench\": \"event_loop\", \"backend\": \"%s\", \"bytes\": %zu, \"ns\": %lu, \"mb_per_s\": %.2f, "
+           "\"cpu_ns_per_kb\": %.1f, \"chunks\": %zu, \"wakeups\": %zu}\n",
+           name, bytes, ns, bytes / (ns / 1e9) / 1e6, cpu / (bytes / 1024.0), chunks, wakeups);
+
+    reader.stop();
+    waitpid(pid, nullptr, 0);
+    close(master);
+}
+
+int main() {
+    const std::string path = make_flood_file();
+
+    bench_backend("epoll", LoopBackend::Epoll, path);
+
+    const int opcodes[] = {IORING_OP_POLL_ADD, IORING_OP_PROVIDE_BUFFERS, IO_RING_OP_READ_MULTISHOT};
+    if (IoRing::supports(opcodes, sizeof(opcodes) / sizeof(opcodes[0]))) {
+        bench_backend("io_uring", LoopBackend::IoUring, path);
+    } else {
+        printf("{\"bench\": \"event_loop\", \"backend\": \"io_uring\", \"skipped\": true}\n");
+    }
+
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Times agent-sized POST requests to a local TLS stand-in for the agency, once with a fresh curl
+// handle per request (DNS, TCP and TLS every time) and once through a connection pool.
+// --connect-delay-ms adds a delay before each TLS handshake the server accepts, a stand-in
+// for the round trips to a remote agency. Prints one JSON object per mode.
+
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <http_connection_pool.hpp>
+#include <https_client.hpp>
+#include <utils.hpp>
+
+#define REQUESTS 200
+
+// Answers every request on a connection until the client closes it
+class TlsStandIn {
+public:
+    explicit TlsStandIn(const int connect_delay_ms) : connect_delay_ms(connect_delay_ms) {
+        ctx = SSL_CTX_new(TLS_server_method());
+
+        // Self-signed, the client does not verify it
+        EVP_PKEY *key = EVP_EC_gen("prime256v1");
+        X509 *cert = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert, X509_get_subject_name(cert));
+        X509_sign(cert, key, EVP_sha256());
+
+        if (SSL_CTX_use_certificate(ctx, cert) != 1 || SSL_CTX_use_PrivateKey(ctx, key) != 1) {
+            ERR_print_errors_fp(stderr);
+            exit(EXIT_FAILURE);
+        }
+
+        X509_free(cert);
+        EVP_PKEY_free(key);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1 || listen(fd, 64) == -1) {
+            perror("bind");
+            exit(EXIT_FAILURE);
+        }
+
+        socklen_t len = sizeof(addr);
+        getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+        url = "https://localhost:" + std::to_string(ntohs(addr.sin_port)) + "/agents/assistant";
+
+        std::thread(&TlsStandIn::accept_loop, this).detach();
+    }
+
+    std::string url;
+
+private:
+    SSL_CTX *ctx;
+    int fd;
+    int connect_delay_ms;
+
+    void accept_loop() const {
+        while (true) {
+            const int client = accept(fd, nullptr, nullptr);
+            if (client == -1) {
+                return;
+            }
+
+            std::thread(&TlsStandIn::serve, this, client).detach();
+        }
+    }
+
+    void serve(const int client) const {
+        usleep(connect_delay_ms * 1000);
+
+        // Like a real server, or the handshake waits on delayed ACKs
+        constexpr int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        SSL *ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, client);
+
+        if (SSL_accept(ssl) == 1) {
+            std::string request;
+            char buf[16 * 1024];
+
+            while (true) {
+                const size_t head_end = request.find("\r\n\r\n");
+                if (head_end != std::string::npos) {
+                    size_t body_length = 0;
+                    if (const char *length = strcasestr(request.c_str(), "content-length:");
+                        length != nullptr && length < request.c_str() + head_end) {
+                        body_length = strtoul(length + 15, nullptr, 10);
+                    }
+
+                    if (request.size() >= head_end + 4 + body_length) {
+                        request.erase(0, head_end + 4 + body_length);
+
+                        const std::string body = R"({"content": "The answer"})";
+                        const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                                                     std::to_string(body.size()) + "\r\n\r\n" + body;
+                        SSL_write(ssl, response.data(), static_cast<int>(response.size()));
+                        continue;
+                    }
+                }
+
+                const int n = SSL_read(ssl, buf, sizeof(buf));
+                if (n <= 0) {
+                    break;
+                }
+
+                request.append(buf, n);
+            }
+        }
+
+        SSL_free(ssl);
+        close(client);
+    }
+};
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, const double fraction) {
+    const auto index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+static void measure(const char *mode, const std::string &url, HttpConnectionPool *pool, const int connect_delay_ms) {
+    const json body = {
+        {"distro", "Linux"},
+        {"query", "why did make fail?"},
+        {"session_history", std::string(2048, 'x')}
+    };
+
+    const std::map<std::string, std::string> headers = {{"Content-Type", "application/json"}};
+
+    std::vector<uint64_t> samples;
+    int errors = 0;
+
+    for (int i = 0; i < REQUESTS; i++) {
+        HttpsClient client;
+        client.set_pool(pool);
+
+        const uint64_t start = monotonic_ns();
+        json response = client.make_http_request(HttpRequestType::POST, url, {}, body, headers);
+        samples.push_back(monotonic_ns() - start);
+
+        if (response.contains("error") || response["status_code"] != 200) {
+            errors++;
+        }
+    }
+
+    const uint64_t first = samples.front();
+    std::sort(samples.begin(), samples.end());
+
+    printf("{\"bench\": \"http_pool\", \"mode\": \"%s\", \"connect_delay_ms\": %d, \"requests\": %d, \"errors\": %d, "
+           "\"first_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f}\n",
+           mode, connect_delay_ms, REQUESTS, errors, first / 1e3, percentile(samples, 0.5) / 1e3,
+           percentile(samples, 0.99) / 1e3);
+    fflush(stdout);
+}
+
+int main(const int argc, char **argv) {
+    int connect_delay_ms = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--connect-delay-ms") == 0 && i + 1 < argc) {
+            connect_delay_ms = atoi(argv[++i]);
+        }
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    const TlsStandIn server(connect_delay_ms);
+
+    // Before: a handle, a connection and a handshake per request
+    measure("fresh", server.url, nullptr, connect_delay_ms);
+
+    // After: starts cold, then reuses the connection
+    HttpConnectionPool pool;
+    measure("pooled", server.url, &pool, connect_delay_ms);
+
+    return 0;
+}
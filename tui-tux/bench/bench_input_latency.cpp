@@ -0,0 +1,204 @@
+// Runs the multiplexer under a pty, types a probe key into the agent pane and times how long it
+// takes for the echoed glyph to show up in the rendered output. Measured while idle, while the
+// bash pane floods, and during a resize storm. Prints one JSON object per scenario.
+
+#include <pty.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+
+#include <terminal_multiplexer.hpp>
+#include <utils.hpp>
+
+#define SAMPLES 1000
+#define PROBE_TIMEOUT_NS (1000ULL * 1000 * 1000)
+
+// Probes are typed into fresh cells, since ncurses sends nothing for a cell that ends up unchanged.
+// After a batch the prompt is cleared, and the next batch uses the other glyph.
+#define PROBE_BATCH 40
+#define CLEAR_SETTLE_US (50 * 1000)
+
+// Output of the multiplexer, scanned for the probe glyph on a thread of its own, so it is
+// always drained and the multiplexer never blocks on a full pty
+class OutputWatcher {
+public:
+    explicit OutputWatcher(const int fd) : fd(fd), thread(&OutputWatcher::run, this) {}
+
+    ~OutputWatcher() {
+        thread.join();
+    }
+
+    // Time the glyph was seen after arm(), 0 while not yet
+    void arm(const char glyph) {
+        probe.store(glyph);
+        seen_ns.store(0);
+        armed.store(true);
+    }
+
+    uint64_t seen() const {
+        return seen_ns.load();
+    }
+
+private:
+    int fd;
+    std::atomic<char> probe{0};
+    std::atomic<bool> armed{false};
+    std::atomic<uint64_t> seen_ns{0};
+    std::thread thread;
+
+    void run() {
+        char buf[64 * 1024];
+
+        // Escape sequences and line drawing characters are not glyphs typed by anyone
+        enum { TEXT, ESCAPE, CSI, CHARSET } state = TEXT;
+        bool line_drawing = false;
+
+        while (true) {
+            const ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) {
+                return;
+            }
+
+            for (ssize_t i = 0; i < n; i++) {
+                const char ch = buf[i];
+
+                if (state == ESCAPE) {
+                    state = ch == '[' ? CSI : ch == '(' ? CHARSET : TEXT;
+                } else if (state == CSI) {
+                    if (ch >= 0x40 && ch <= 0x7e) {
+                        state = TEXT;
+                    }
+                } else if (state == CHARSET) {
+                    line_drawing = ch == '0';
+                    state = TEXT;
+                } else if (ch == '\x1b') {
+                    state = ESCAPE;
+                } else if (ch == probe.load() && !line_drawing && armed.load()) {
+                    armed.store(false);
+                    seen_ns.store(monotonic_ns());
+                }
+            }
+        }
+    }
+};
+
+static void type(const int master, const std::string &keys) {
+    write(master, keys.data(), keys.size());
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, const double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    const auto index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+static void measure(const char *scenario, const int master, OutputWatcher &watcher) {
+    std::vector<uint64_t> samples;
+    int timeouts = 0;
+
+    for (int i = 0; i < SAMPLES; i++) {
+        const char glyph = i / PROBE_BATCH % 2 == 0 ? 'z' : 'Z';
+
+        watcher.arm(glyph);
+        const uint64_t start = monotonic_ns();
+        type(master, std::string(1, glyph));
+
+        uint64_t seen;
+        while ((seen = watcher.seen()) == 0 && monotonic_ns() - start < PROBE_TIMEOUT_NS) {
+            usleep(10);
+        }
+
+        if (seen == 0) {
+            timeouts++;
+        } else {
+            samples.push_back(seen - start);
+        }
+
+        if ((i + 1) % PROBE_BATCH == 0) {
+            // Clear the prompt line (^U) and let the redraw pass
+            type(master, "\x15");
+            usleep(CLEAR_SETTLE_US);
+        }
+    }
+
+    type(master, "\x15");
+    usleep(CLEAR_SETTLE_US);
+
+    std::sort(samples.begin(), samples.end());
+
+    printf("{\"bench\": \"input_latency\", \"scenario\": \"%s\", \"samples\": %zu, \"timeouts\": %d, "
+           "\"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f}\n",
+           scenario, samples.size(), timeouts, percentile(samples, 0.5) / 1e3,
+           percentile(samples, 0.99) / 1e3, percentile(samples, 0.999) / 1e3);
+    fflush(stdout);
+}
+
+int main() {
+    winsize size = {40, 120, 0, 0};
+
+    int master;
+    const pid_t pid = forkpty(&master, nullptr, nullptr, &size);
+
+    if (pid < 0) {
+        perror("forkpty");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        setenv("TERM", "xterm-256color", 1);
+
+        TerminalMultiplexer multiplexer;
+        multiplexer.run();
+        exit(EXIT_SUCCESS);
+    }
+
+    OutputWatcher watcher(master);
+
+    // Let the panes start, the agent pane has the focus
+    sleep(2);
+
+    measure("idle", master, watcher);
+
+    // Flood the bash pane, then type into the agent pane again
+    type(master, "\x02\tyes\n");
+    usleep(200 * 1000);
+    type(master, "\x02\t");
+    usleep(100 * 1000);
+
+    measure("flooding_neighbour", master, watcher);
+
+    type(master, "\x02\t\x03\x02\t");
+    usleep(200 * 1000);
+
+    // Resize back and forth, like dragging a window edge
+    std::atomic<bool> storming{true};
+    std::thread storm([&] {
+        for (int i = 0; storming.load(); i++) {
+            winsize storm_size = {static_cast<unsigned short>(i % 2 == 0 ? 40 : 30),
+                                  static_cast<unsigned short>(i % 2 == 0 ? 120 : 100), 0, 0};
+            ioctl(master, TIOCSWINSZ, &storm_size);
+            usleep(1000);
+        }
+    });
+
+    measure("resize_storm", master, watcher);
+
+    storming.store(false);
+    storm.join();
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    close(master);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Reads the installed package list the way queries used to (popen of dpkg and awk) and through
+// the native reader, on this system's database. Prints one JSON object per method.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <package_database.hpp>
+#include <utils.hpp>
+
+#define ROUNDS 20
+
+static std::vector<std::string> read_popen() {
+    std::vector<std::string> names;
+
+    FILE *pipe = popen("dpkg --get-selections | awk '{print $1}'", "r");
+    if (pipe == nullptr) {
+        return names;
+    }
+
+    char buffer[128];
+    while (fgets(buffer, 128, pipe) != nullptr) {
+        names.emplace_back(buffer);
+    }
+    pclose(pipe);
+    return names;
+}
+
+static std::vector<std::string> read_native(const PackageFormat format, const std::string &path) {
+    std::vector<std::string> names;
+    for (PackageRecord &record : read_package_database(format, path)) {
+        if (is_installed(record)) {
+            names.push_back(std::move(record.name));
+        }
+    }
+    return names;
+}
+
+template <typename Read>
+static void run(const char *method, const PackageFormat format, Read read) {
+    std::vector<uint64_t> samples;
+    size_t packages = 0;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        const uint64_t start = monotonic_ns();
+        packages = read().size();
+        samples.push_back(monotonic_ns() - start);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    printf("{\"bench\": \"package_db\", \"method\": \"%s\", \"format\": %d, \"packages\": %zu, \"rounds\": %d, "
+           "\"p50_us\": %.1f, \"max_us\": %.1f}\n",
+           method, static_cast<int>(format), packages, ROUNDS,
+           samples[samples.size() / 2] / 1000.0, samples.back() / 1000.0);
+}
+
+int main() {
+    const PackageFormat format = detect_package_format();
+    const std::string path = package_database_path(format);
+
+    if (format == PackageFormat::Dpkg) {
+        run("popen", format, read_popen);
+    }
+    run("native", format, [&] { return read_native(format, path); });
+
+    return 0;
+}
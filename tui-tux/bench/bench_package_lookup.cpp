@@ -0,0 +1,71 @@
+// Answers the agency's package lookups from the index on this system's database, and compares a
+// request body carrying the whole package list with one that leaves it to lookups. Prints one
+// JSON object per measurement.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <package_inventory.hpp>
+#include <utils.hpp>
+#include "../nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+#define LOOKUPS 1000000
+
+// Hits and misses in turn, so neither the hash nor the comparison is always skipped
+template <typename Lookup>
+static void run(const char *method, const std::vector<std::string> &keys, Lookup lookup) {
+    size_t found = 0;
+
+    const uint64_t start = monotonic_ns();
+    for (int i = 0; i < LOOKUPS; i++) {
+        found += lookup(keys[i % keys.size()]) != nullptr;
+    }
+    const uint64_t elapsed = monotonic_ns() - start;
+
+    printf("{\"bench\": \"package_lookup\", \"method\": \"%s\", \"lookups\": %d, \"found\": %zu, \"ns_per_lookup\": %.1f}\n",
+           method, LOOKUPS, found, static_cast<double>(elapsed) / LOOKUPS);
+}
+
+int main() {
+    const uint64_t load_start = monotonic_ns();
+    const std::shared_ptr<const PackageIndex> index = PackageInventory::shared().get();
+    const uint64_t load_ns = monotonic_ns() - load_start;
+
+    const std::vector<PackageRecord> &records = index->get_records();
+    if (records.empty()) {
+        printf("{\"bench\": \"package_lookup\", \"error\": \"no package database\"}\n");
+        return 0;
+    }
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < records.size(); i++) {
+        names.push_back(records[i].name);
+        names.push_back(records[i].name + "-missing");
+    }
+    run("find", names, [&](const std::string &name) { return index->find(name); });
+
+    // The first owner lookup reads the file lists
+    const uint64_t files_start = monotonic_ns();
+    const PackageRecord *shell = index->owner_of("/bin/sh");
+    printf("{\"bench\": \"package_lookup\", \"method\": \"file_index\", \"load_us\": %.1f, \"build_us\": %.1f, \"bin_sh\": \"%s\"}\n",
+           load_ns / 1000.0, (monotonic_ns() - files_start) / 1000.0, shell != nullptr ? shell->name.c_str() : "");
+
+    const std::vector<std::string> paths = {"/bin/sh", "/usr/bin/env", "/usr/bin/missing", "/etc/missing"};
+    run("owner_of", paths, [&](const std::string &path) { return index->owner_of(path); });
+
+    // What each query carried before, against what the lookups it replaces cost
+    json list = json::array();
+    for (const PackageRecord &record : records) {
+        list.push_back(record.name);
+    }
+    const json lookup = {{"tool_calls", {{{"id", "1"}, {"name", AGENT_TOOL_PACKAGE_INSTALLED}, {"arguments", {{"package", "curl"}}}}}}};
+    const json answer = {{"tool_results", {{{"id", "1"}, {"result", {{"installed", true}}}}}}};
+
+    printf("{\"bench\": \"package_lookup\", \"method\": \"payload\", \"packages\": %zu, \"list_bytes\": %zu, \"lookup_bytes\": %zu}\n",
+           records.size(), json({{"installed_packages", list}}).dump().size(), lookup.dump().size() + answer.dump().size());
+
+    return 0;
+}
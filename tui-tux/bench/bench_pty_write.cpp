@@ -0,0 +1,140 @@
+// Pastes 1 MB into `cat > /dev/null` running on a pty: once with a write() per byte,
+// as the multiplexer used to, and once through an OutboundQueue. Prints one JSON object per mode.
+
+#include <pty.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/wait.h>
+
+#include <outbound_queue.hpp>
+#include <utils.hpp>
+
+#define PASTE_SIZE (1024 * 1024)
+#define PASTE_LINE 64
+
+// Size of the chunks stdin reads hand to the multiplexer
+#define CHUNK_SIZE 1024
+
+static std::string make_paste() {
+    std::string paste;
+    paste.reserve(PASTE_SIZE);
+
+    // Canonical mode buffers a line at a time, keep lines short
+    while (paste.size() < PASTE_SIZE) {
+        paste += static_cast<char>(paste.size() % PASTE_LINE == PASTE_LINE - 1 ? '\n' : 'a' + paste.size() % 26);
+    }
+
+    return paste;
+}
+
+static int spawn_cat(int &pid) {
+    int master, slave;
+
+    termios tios{};
+    cfmakeraw(&tios);
+    tios.c_lflag |= ICANON;
+
+    if (openpty(&master, &slave, nullptr, &tios, nullptr) == -1) {
+        perror("openpty");
+        exit(EXIT_FAILURE);
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        close(master);
+        setsid();
+        ioctl(slave, TIOCSCTTY, NULL);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        close(slave);
+
+        execl("/bin/sh", "/bin/sh", "-c", "cat > /dev/null", NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    close(slave);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL, 0) | O_NONBLOCK);
+
+    return master;
+}
+
+static void stop_cat(const int master, const int pid) {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    close(master);
+}
+
+static void print_result(const char *mode, const uint64_t ns, const size_t written, const size_t dropped, const size_t syscalls) {
+    printf("{\"bench\": \"pty_write\", \"mode\": \"%s\", \"bytes\": %d, \"ns\": %lu, \"mb_per_s\": %.2f, "
+           "\"written\": %zu, \"dropped\": %zu, \"write_calls\": %zu}\n",
+           mode, PASTE_SIZE, ns, PASTE_SIZE / (ns / 1e9) / 1e6, written, dropped, syscalls);
+}
+
+static void bench_per_byte(const std::string &paste) {
+    int pid;
+    const int master = spawn_cat(pid);
+
+    size_t written = 0, dropped = 0;
+    const uint64_t start = monotonic_ns();
+
+    for (const char ch : paste) {
+        // Return value ignored by the old code, a full buffer loses the byte
+        if (write(master, &ch, 1) == 1) {
+            written++;
+        } else {
+            dropped++;
+        }
+    }
+
+    print_result("per_byte", monotonic_ns() - start, written, dropped, paste.size());
+    stop_cat(master, pid);
+}
+
+static void bench_queue(const std::string &paste) {
+    int pid;
+    const int master = spawn_cat(pid);
+
+    OutboundQueue queue;
+    size_t offset = 0, syscalls = 0;
+    const uint64_t start = monotonic_ns();
+
+    while (offset < paste.size() || !queue.empty()) {
+        // Queue what arrived, flush once, wait for POLLOUT when the pty is full
+        if (offset < paste.size()) {
+            const size_t len = std::min(static_cast<size_t>(CHUNK_SIZE), paste.size() - offset);
+            if (queue.push(paste.data() + offset, len)) {
+                offset += len;
+            }
+        }
+
+        syscalls++;
+        if (queue.flush(master) > 0) {
+            pollfd pfd = {master, POLLOUT, 0};
+            poll(&pfd, 1, -1);
+        }
+    }
+
+    print_result("queue", monotonic_ns() - start, paste.size() - queue.get_dropped(), queue.get_dropped(), syscalls);
+    stop_cat(master, pid);
+}
+
+int main() {
+    const std::string paste = make_paste();
+
+    bench_per_byte(paste);
+    bench_queue(paste);
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Replays a recording made with ISHELL_RECORD through the parser and Screen, and prints one
+// JSON object. Usage: bench_replay [recording] [--realtime]
+// Without a recording, one is made of `ls -lR --color=always` output first.
+
+#include <pty.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+
+#include <recorder.hpp>
+#include <utils.hpp>
+
+#define CORPUS_LINES 40
+#define CORPUS_COLS 120
+#define CORPUS_SIZE (2 * 1024 * 1024)
+
+static std::string record_corpus() {
+    const std::string path = "/tmp/ishell_bench_replay.rec";
+
+    Recorder recorder;
+    if (!recorder.open(path)) {
+        exit(EXIT_FAILURE);
+    }
+
+    winsize size = {CORPUS_LINES, CORPUS_COLS, 0, 0};
+
+    int master;
+    const pid_t pid = forkpty(&master, nullptr, nullptr, &size);
+
+    if (pid < 0) {
+        perror("forkpty");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        const std::string command = "ls -lR --color=always /usr | head -c " + std::to_string(CORPUS_SIZE);
+        execlp("sh", "sh", "-c", command.c_str(), NULL);
+        exit(EXIT_FAILURE);
+    }
+
+    recorder.resize(1, CORPUS_LINES, CORPUS_COLS);
+
+    char buf[PANE_READ_BUFSIZ];
+    ssize_t n;
+
+    // The pty reports EIO once the command is gone
+    while ((n = read(master, buf, sizeof(buf))) > 0) {
+        recorder.data(1, buf, n);
+    }
+
+    waitpid(pid, nullptr, 0);
+    close(master);
+
+    return path;
+}
+
+int main(const int argc, char **argv) {
+    std::string path;
+    bool realtime = false;
+    bool made_corpus = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path.empty()) {
+        path = record_corpus();
+        made_corpus = true;
+    }
+
+    // Screens draw into pads, which need ncurses but no real terminal
+    FILE *out = fopen("/dev/null", "w");
+    FILE *in = fopen("/dev/null", "r");
+    SCREEN *term = newterm("xterm", out, in);
+    set_term(term);
+
+    RecordReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "%s: not a recording\n", path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    ReplayResult result;
+    uint64_t ns;
+
+    {
+        std::vector<Screen> screens;
+
+        const uint64_t start = monotonic_ns();
+        result = replay_recording(reader, screens, realtime);
+        ns = monotonic_ns() - start;
+    }
+
+    endwin();
+    delscreen(term);
+    fclose(out);
+    fclose(in);
+
+    printf("{\"bench\": \"replay\", \"recording\": \"%s\", \"realtime\": %s, \"entries\": %zu, \"bytes\": %zu, "
+           "\"ns\": %lu, \"mb_per_s\": %.2f, \"ns_per_byte\": %.1f, \"max_lag_us\": %.1f}\n",
+           made_corpus ? "ls_color" : path.c_str(), realtime ? "true" : "false", result.entries, result.bytes,
+           ns, result.bytes / (ns / 1e9) / 1e6, static_cast<double>(ns) / result.bytes, result.max_lag_ns / 1e3);
+
+    if (made_corpus) {
+        unlink(path.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+// Encodes the session history for each query of a long session, the way queries used to (the
+// whole history through an ostringstream) and as a window of the incrementally encoded buffer.
+// Prints one JSON object per method.
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <session_history.hpp>
+#include <utils.hpp>
+
+#define QUERIES 2000
+#define RESULT_SIZE 600
+
+static std::string encode_all(const std::vector<std::pair<std::string, std::string>> &session_history) {
+    std::ostringstream history_stream;
+    for (const auto &[fst, snd] : session_history) {
+        history_stream << "Query: " << fst << "\nAnswer: " << snd << "\n";
+    }
+    return history_stream.str();
+}
+
+template <typename Query>
+static void run(const char *method, Query query) {
+    uint64_t total_ns = 0;
+    uint64_t last_ns = 0;
+    size_t total_bytes = 0;
+    size_t last_bytes = 0;
+
+    for (int i = 0; i < QUERIES; i++) {
+        const uint64_t start = monotonic_ns();
+        last_bytes = query(i);
+        last_ns = monotonic_ns() - start;
+
+        total_ns += last_ns;
+        total_bytes += last_bytes;
+    }
+
+    printf("{\"bench\": \"session_history\", \"method\": \"%s\", \"queries\": %d, \"total_ms\": %.2f, \"last_query_us\": %.1f, "
+           "\"total_mb\": %.1f, \"last_query_kb\": %.1f}\n",
+           method, QUERIES, total_ns / 1e6, last_ns / 1000.0, total_bytes / 1e6, last_bytes / 1000.0);
+}
+
+int main() {
+    std::string result;
+    for (int i = 0; result.size() < RESULT_SIZE; i++) {
+        result += "word" + std::to_string(i) + " -flag /path/to/file\n";
+    }
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    run("ostringstream", [&](const int i) {
+        const size_t size = encode_all(pairs).size();
+        pairs.emplace_back("query number " + std::to_string(i), result);
+        return size;
+    });
+
+    SessionHistory history;
+    run("window", [&](const int i) {
+        const size_t size = history.window().size();
+        history.append("query number " + std::to_string(i), result);
+        return size;
+    });
+
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <agency_request_wrapper.hpp>
+#include <session_history.hpp>
 
 class AgencyManager {
 public:
@@ -13,6 +14,9 @@ public:
     std::string get_agency_url();
     virtual std::string execute_query(const std::string &endpoint, const std::string &query);
 
+    // Connects to the current agent ahead of the next query, while the user is still typing
+    virtual void prewarm();
+
     [[nodiscard]] virtual std::string get_agent_name() const;
     virtual void set_agent_name(const std::string &agent_name);
 
@@ -22,8 +26,8 @@ public:
 
     AgencyRequestWrapper* request_wrapper;
 
-    // <query, result>
-    std::vector<std::pair<std::string, std::string>> session_history;
+    // <query, result>, encoded as it grows
+    SessionHistory session_history;
 };
 
 #endif // AGENCY_HPP
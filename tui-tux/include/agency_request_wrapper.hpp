@@ -1,10 +1,17 @@
 #ifndef AGENCY_REQUEST_WRAPPER_HPP
 #define AGENCY_REQUEST_WRAPPER_HPP
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include "../nlohmann/json.hpp"
+#include <context_handshake.hpp>
 #include <https_client.hpp>
+#include <package_index.hpp>
+#include <session_history.hpp>
+#include <terminal_context.hpp>
 
 using json = nlohmann::json;
 
@@ -13,19 +20,35 @@ public:
     virtual ~AgencyRequestWrapper() = default;
 
     virtual std::string get_linux_distro();
-    virtual std::vector<std::string> get_installed_packages();
+    // What the agency's package lookups are answered from
+    virtual std::shared_ptr<const PackageIndex> get_package_index();
     virtual std::string get_ssh_ip();
     virtual int get_ssh_port();
     virtual std::string get_ssh_user();
-    json send_request_to_agent_server(const std::string &url, const std::string &user_query, std::vector<std::pair<std::string, std::string>> &session_history);
+    virtual TerminalContext get_terminal_context();
+    json send_request_to_agent_server(const std::string &url, const std::string &user_query, const SessionHistory &session_history);
 
-    static std::string get_session_history_string(std::vector<std::pair<std::string, std::string>> &session_history);
-    virtual std::string ask_agent(const std::string &url, const std::string &user_query, std::vector<std::pair<std::string, std::string>> &session_history);
+    // Answers one of the agency's tool calls, {"id", "name", "arguments"}
+    json run_tool_call(const json &call);
+
+    virtual std::string ask_agent(const std::string &url, const std::string &user_query, const SessionHistory &session_history);
     virtual json make_http_request(HttpRequestType request_type, const std::string& url,
                         const std::map<std::string, std::string>& query_params,
                         const json& body,
                         const std::map<std::string, std::string>& headers);
     virtual char *getenv(const char *key);
+
+    // Opens a pooled connection to the url's host in the background, returns right away
+    virtual void prewarm(const std::string &url);
+
+    // Set from another thread to abort the request in flight
+    std::atomic<bool> cancel_requested{false};
+
+    // Gets each piece of a streamed answer as it arrives, on the requesting thread
+    std::function<void(const std::string &)> on_delta;
+
+    // What of the static context the agency already has
+    ContextHandshake context_handshake;
 };
 
 #endif // AGENCY_REQUEST_WRAPPER_HPP
@@ -31,6 +31,13 @@ public:
 
     std::unordered_map<std::string, std::pair<std::string, std::string>> bookmarks;
 
+    // Session history turn each bookmark keeps pinned, at most one per alias
+    std::unordered_map<std::string, size_t> pinned_turns;
+
+    // Pins the turn for the alias instead of the one it pinned before
+    void pin_turn(const std::string &alias, size_t index);
+    void unpin_turn(const std::string &alias);
+
     virtual bool create_bookmarks_file(const std::string &filename);
     virtual void parse_bookmark_json(const json &bookmark);
 };
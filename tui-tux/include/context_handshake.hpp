@@ -0,0 +1,39 @@
+#ifndef ISHELL_CONTEXT_HANDSHAKE
+#define ISHELL_CONTEXT_HANDSHAKE
+
+#include <string>
+#include "../nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+// Keeps the static part of a query (distro, SSH details) off the wire once the agency has it.
+// Every request names the context by its hash ("context_hash"):
+//  - in full, until the agency acknowledges the hash with a Context-Hash response header,
+//  - as that hash alone afterwards.
+// Installed packages are not part of it, the agency asks about them with tool calls.
+// An agency that does not know the hash (status 409, or error "unknown_context") gets the full
+// context again. One that never acknowledges keeps getting it in full, as before.
+class ContextHandshake {
+public:
+    // Adds the context to a request body
+    void attach(json &body, const json &context);
+
+    // Takes note of the acknowledgment. True if the agency did not know the context, the request
+    // should then be attached and sent again.
+    bool on_response(const json &response);
+
+    // Sends the full context next time
+    void reset();
+
+    // Stable across runs and field order
+    static std::string fingerprint(const json &context);
+
+private:
+    std::string acked_hash;
+
+    // Last attached, acknowledged or not
+    std::string sent_hash;
+    bool sent_full = false;
+};
+
+#endif
@@ -38,13 +38,57 @@
 // Insert character
 #define E_KEY_ICH 266
 
+// Bracketed paste start and end, sent by the outer terminal
+#define E_KEY_PASTE_BEGIN 267
+#define E_KEY_PASTE_END 268
+
+// Bracketed paste mode set and reset, sent by applications
+#define E_KEY_BRACKETED_PASTE_ON 269
+#define E_KEY_BRACKETED_PASTE_OFF 270
+
+// Status queries, answered by the emulator: Device Attributes (primary, secondary),
+// Device Status Report (5: status, 6: cursor position) and XTVERSION
+#define E_KEY_DA1 271
+#define E_KEY_DA2 272
+#define E_KEY_DSR 273
+#define E_KEY_XTVERSION 274
+
+// Shell integration marks (OSC 133): prompt start, command start, output start, command done
+#define E_KEY_MARK_PROMPT 275
+#define E_KEY_MARK_COMMAND 276
+#define E_KEY_MARK_OUTPUT 277
+#define E_KEY_MARK_DONE 278
+
+// Longest OSC string kept, longer ones are cut (titles, hyperlinks)
+#define OSC_MAX_LEN 4096
+
+// VT100 with advanced video option, like tmux and screen report
+#define DA1_REPLY "\x1b[?1;2c"
+#define DA2_REPLY "\x1b[>0;1;0c"
+#define DSR_OK_REPLY "\x1b[0n"
+#define XTVERSION_REPLY "\x1bP>|ishell\x1b\\"
+
+#define PASTE_BEGIN_MARKER "\x1b[200~"
+#define PASTE_END_MARKER "\x1b[201~"
+#define BRACKETED_PASTE_ENABLE "\x1b[?2004h"
+#define BRACKETED_PASTE_DISABLE "\x1b[?2004l"
+
 struct TerminalChar {
     int ch;
     std::vector<int> args;
     std::string sequence;
 };
 
+struct PasteState {
+    bool active = false;
+
+    // Bytes of the end marker matched so far, possibly across reads
+    size_t matched = 0;
+};
+
 TerminalChar escape(const std::string &seq);
 int read_and_escape(int fd, std::vector<TerminalChar> &vec);
+int escape_buffer(int fd, const char *buf, int n, std::vector<TerminalChar> &vec, bool stop_at_paste = false);
+int scan_paste(PasteState &state, const char *buf, int n, std::string &payload);
 
 #endif
\ No newline at end of file
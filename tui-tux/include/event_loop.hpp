@@ -0,0 +1,88 @@
+#ifndef ISHELL_EVENT_LOOP
+#define ISHELL_EVENT_LOOP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include <io_ring.hpp>
+
+// Selected with ISHELL_EVENT_LOOP=epoll|io_uring, epoll is the fallback
+enum class LoopBackend {
+    Epoll,
+    IoUring,
+};
+
+struct LoopEvent {
+    int fd = -1;
+
+    // EPOLLIN, EPOLLOUT, EPOLLERR, EPOLLHUP
+    uint32_t events = 0;
+};
+
+// Level-triggered readiness of a set of fds, like epoll
+class EventLoop {
+public:
+    virtual ~EventLoop() = default;
+
+    virtual void add(int fd, uint32_t events) = 0;
+
+    // events may be 0 to stop watching the fd for a while
+    virtual void modify(int fd, uint32_t events) = 0;
+    virtual void remove(int fd) = 0;
+
+    // timeout_ms is 0 to poll or -1 to block. Returns the number of events, or -errno.
+    virtual int wait(LoopEvent *events, int max_events, int timeout_ms) = 0;
+
+    [[nodiscard]] virtual LoopBackend get_backend() const = 0;
+};
+
+class EpollEventLoop final : public EventLoop {
+public:
+    EpollEventLoop();
+    ~EpollEventLoop() override;
+
+    void add(int fd, uint32_t events) override;
+    void modify(int fd, uint32_t events) override;
+    void remove(int fd) override;
+    int wait(LoopEvent *events, int max_events, int timeout_ms) override;
+    [[nodiscard]] LoopBackend get_backend() const override;
+
+private:
+    int epoll_fd = -1;
+};
+
+// Poll requests on an io_uring. A poll is re-armed together with the next wait, so
+// reporting readiness costs no syscall of its own.
+class IoUringEventLoop final : public EventLoop {
+public:
+    IoUringEventLoop();
+
+    [[nodiscard]] bool ok() const;
+
+    void add(int fd, uint32_t events) override;
+    void modify(int fd, uint32_t events) override;
+    void remove(int fd) override;
+    int wait(LoopEvent *events, int max_events, int timeout_ms) override;
+    [[nodiscard]] LoopBackend get_backend() const override;
+
+private:
+    struct Watch {
+        uint32_t events = 0;
+
+        // user_data of the poll request in flight, 0 if none
+        uint64_t tag = 0;
+    };
+
+    IoRing ring;
+    std::map<int, Watch> watches;
+    uint32_t generation = 0;
+
+    void arm(int fd, Watch &watch);
+    void cancel(Watch &watch);
+};
+
+LoopBackend loop_backend_from_env();
+std::unique_ptr<EventLoop> make_event_loop(LoopBackend backend);
+
+#endif
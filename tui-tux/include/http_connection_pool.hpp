@@ -0,0 +1,60 @@
+#ifndef ISHELL_HTTP_CONNECTION_POOL
+#define ISHELL_HTTP_CONNECTION_POOL
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+
+// Easy handles that outlive a request, so the next one to the same host skips DNS, TCP and TLS.
+// All handles share a DNS cache and TLS sessions, which curl allows across threads. Connections
+// stay with the handle that opened them (curl cannot share those between threads), and acquire()
+// hands out the handle released last, so the next request gets the one a prewarm just used.
+// Safe to use from any thread, each handle by one thread at a time.
+class HttpConnectionPool {
+public:
+    HttpConnectionPool();
+    ~HttpConnectionPool();
+
+    HttpConnectionPool(const HttpConnectionPool &) = delete;
+    HttpConnectionPool &operator=(const HttpConnectionPool &) = delete;
+
+    // The pool requests use unless told otherwise
+    static HttpConnectionPool &shared();
+
+    // An idle handle with its options reset, or a new one. Null if curl cannot make one.
+    CURL *acquire();
+
+    // Back to the pool, or cleaned up if it is full
+    void release(CURL *curl);
+
+    [[nodiscard]] size_t idle_handles();
+
+    // Connects to the url's host in the background (a HEAD request), so DNS, TCP and TLS are done
+    // by the time the next request goes there. Skipped while the last one is still under way.
+    void prewarm(const std::string &url);
+
+    // TLS options a connection is matched on for reuse, the same for every request and prewarm
+    static void set_tls_options(CURL *curl);
+
+private:
+    CURLSH *share = nullptr;
+
+    // One per kind of shared data, curl locks them independently
+    std::mutex share_mutexes[CURL_LOCK_DATA_LAST];
+
+    std::mutex idle_mutex;
+    std::vector<CURL *> idle;
+
+    std::thread prewarm_thread;
+    std::atomic<bool> prewarming{false};
+
+    void configure(CURL *curl) const;
+
+    static void lock(CURL *curl, curl_lock_data data, curl_lock_access access, void *pool);
+    static void unlock(CURL *curl, curl_lock_data data, void *pool);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef ISHELL_HTTP_MULTI
+#define ISHELL_HTTP_MULTI
+
+#include <functional>
+#include <map>
+#include <curl/curl.h>
+
+#include <event_loop.hpp>
+
+// Runs many transfers at once on one thread. curl's sockets and its timeout (a timerfd) are
+// watched by an event loop, whose events are handed to handle(). Not thread safe, everything,
+// callbacks included, happens on the thread that calls handle() or run().
+class HttpMulti {
+public:
+    explicit HttpMulti(EventLoop *loop);
+
+    // Transfers still in flight are aborted, their callbacks get CURLE_ABORTED_BY_CALLBACK
+    ~HttpMulti();
+
+    HttpMulti(const HttpMulti &) = delete;
+    HttpMulti &operator=(const HttpMulti &) = delete;
+
+    // Starts a configured easy handle. on_done gets the result once it is out of the multi handle,
+    // so it may clean up or reuse the handle, and start new transfers.
+    void add(CURL *curl, std::function<void(CURLcode)> on_done);
+
+    // Returns false if the event is not for one of its fds
+    bool handle(const LoopEvent &event);
+
+    // Waits on the loop until no transfer is in flight, for loops that watch nothing else
+    void run();
+
+    [[nodiscard]] size_t in_flight() const;
+
+private:
+    CURLM *multi = nullptr;
+    EventLoop *loop;
+    int timer_fd = -1;
+
+    std::map<CURL *, std::function<void(CURLcode)>> transfers;
+
+    // Sockets curl asked to watch, and for what
+    std::map<curl_socket_t, uint32_t> sockets;
+
+    void socket_action(curl_socket_t fd, int ev_bitmask);
+    void check_done();
+
+    static int socket_callback(CURL *curl, curl_socket_t fd, int what, void *multi, void *socketp);
+    static int timer_callback(CURLM *curlm, long timeout_ms, void *multi);
+};
+
+#endif
@@ -1,10 +1,15 @@
 #ifndef HTTPS_CLIENT_HPP
 #define HTTPS_CLIENT_HPP
 
+#include <atomic>
+#include <functional>
+#include <future>
 #include <string>
 #include <map>
 #include <curl/curl.h>
 #include "../nlohmann/json.hpp"
+#include <http_connection_pool.hpp>
+#include <http_multi.hpp>
 
 using json = nlohmann::json;
 
@@ -27,14 +32,61 @@ public:
                            const json& body,
                            const std::map<std::string, std::string>& headers);
 
+    // The same request run by the multi handle, so many can be in flight on one thread.
+    // on_done gets the response on the thread that drives the multi. The client must outlive it.
+    void make_http_request_async(HttpMulti& multi, HttpRequestType request_type, const std::string& url,
+                                 const std::map<std::string, std::string>& query_params,
+                                 const json& body,
+                                 const std::map<std::string, std::string>& headers,
+                                 std::function<void(json)> on_done);
+
+    // Ready once the multi has run the request, so only wait for it off the multi's thread
+    std::future<json> make_http_request_async(HttpMulti& multi, HttpRequestType request_type, const std::string& url,
+                                              const std::map<std::string, std::string>& query_params,
+                                              const json& body,
+                                              const std::map<std::string, std::string>& headers);
+
+    // Transfers in flight abort once the flag is set, null to never abort
+    void set_cancel_flag(const std::atomic<bool> *flag);
+
+    // Streamed responses (SSE, NDJSON) hand each content delta to the callback as it arrives.
+    // The body is then {"content": all deltas}, or {"error": ...} if the stream sent one.
+    void set_stream_callback(std::function<void(const std::string &)> callback);
+
+    // Handles come from the pool and go back to it, null for a fresh handle per request
+    void set_pool(HttpConnectionPool *connection_pool);
+
     static std::string build_query_string(const std::map<std::string, std::string>& query_params);
     virtual void set_request_type(CURL* curl, HttpRequestType request_type);
     static void add_request_body(CURL* curl, HttpRequestType request_type, const json& body, std::string& jsonData);
-    static void add_request_headers(CURL* curl, const std::map<std::string, std::string>& headers);
+    // The list must outlive the transfer, the caller frees it
+    static curl_slist *add_request_headers(CURL* curl, const std::map<std::string, std::string>& headers);
     virtual void set_response_callbacks(CURL* curl, std::string& readBuffer, std::map<std::string, std::string>& response_headers);
     virtual json perform_request(CURL* curl);
     virtual CURL *curl_easy_init();
     virtual CURLcode curl_easy_perform(CURL *curl);
+    // What curl_easy_perform is to a blocking request
+    virtual void curl_multi_add_handle(HttpMulti &multi, CURL *curl, std::function<void(CURLcode)> on_done);
+
+private:
+    // Must outlive the transfer: the body and headers sent, and what came back
+    struct RequestData;
+    struct ResponseData;
+    struct AsyncTransfer;
+
+    const std::atomic<bool> *cancel_flag = nullptr;
+    std::function<void(const std::string &)> stream_callback;
+    HttpConnectionPool *pool = &HttpConnectionPool::shared();
+
+    void release_handle(CURL *curl) const;
+
+    // A configured handle, or null if there is none to be had
+    CURL *prepare_request(RequestData &request, HttpRequestType request_type, const std::string& url,
+                          const std::map<std::string, std::string>& query_params,
+                          const json& body,
+                          const std::map<std::string, std::string>& headers);
+    void prepare_response(CURL *curl, ResponseData &response);
+    json finish_response(CURL *curl, CURLcode res, ResponseData &response);
 };
 
 
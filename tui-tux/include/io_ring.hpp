@@ -0,0 +1,56 @@
+#ifndef ISHELL_IO_RING
+#define ISHELL_IO_RING
+
+#include <linux/io_uring.h>
+#include <cstddef>
+#include <cstdint>
+
+// Missing from older uapi headers, the kernel has it since 6.7
+#define IO_RING_OP_READ_MULTISHOT (IORING_OP_SENDMSG_ZC + 1)
+
+// Minimal io_uring instance driven through the raw syscalls, so no liburing is needed.
+// Owned and used by a single thread.
+class IoRing {
+public:
+    explicit IoRing(unsigned entries);
+    ~IoRing();
+
+    IoRing(const IoRing &) = delete;
+    IoRing &operator=(const IoRing &) = delete;
+
+    // False if the kernel refused to set up the ring
+    [[nodiscard]] bool ok() const;
+
+    // Zeroed entry to fill in, queued for the next submit(). Submits on its own when the queue is full.
+    io_uring_sqe *get_sqe();
+
+    // Submits queued entries and waits for at least wait_nr completions, in one syscall.
+    // Returns -errno on failure.
+    int submit(unsigned wait_nr = 0);
+    [[nodiscard]] unsigned pending() const;
+
+    // Copies out and consumes the oldest completion, if any
+    bool peek(io_uring_cqe &cqe);
+
+    // True if the running kernel supports all of the given opcodes
+    static bool supports(const int *opcodes, size_t n);
+
+private:
+    int ring_fd = -1;
+
+    void *sq_ring = nullptr, *cq_ring = nullptr;
+    size_t sq_ring_size = 0, cq_ring_size = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+    unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+
+    // Entries queued since the last submit
+    unsigned to_submit = 0;
+
+    void unmap();
+};
+
+#endif
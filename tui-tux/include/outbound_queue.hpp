@@ -0,0 +1,40 @@
+#ifndef ISHELL_OUTBOUND_QUEUE
+#define ISHELL_OUTBOUND_QUEUE
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+
+#include <utils.hpp>
+
+// Bytes waiting to be written to a pty master. Everything queued in one turn goes out
+// in a single write, and whatever the kernel does not accept stays queued until the fd
+// becomes writable again.
+class OutboundQueue {
+public:
+    explicit OutboundQueue(size_t capacity = PTY_OUTBOUND_CAPACITY);
+
+    // Queues the data as a whole, so key sequences are never split.
+    // Returns false and drops the data if it does not fit.
+    bool push(const char *data, size_t len);
+    bool push(const std::string &data);
+
+    // Writes as much as the fd accepts. Returns the number of bytes still queued, or -1 on error.
+    ssize_t flush(int fd);
+
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] size_t get_capacity() const;
+    [[nodiscard]] size_t get_dropped() const;
+
+private:
+    std::string buffer;
+
+    // Start of the unwritten data in buffer
+    size_t head = 0;
+
+    size_t capacity;
+    size_t dropped = 0;
+};
+
+#endif
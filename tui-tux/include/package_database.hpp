@@ -0,0 +1,48 @@
+#ifndef ISHELL_PACKAGE_DATABASE
+#define ISHELL_PACKAGE_DATABASE
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class PackageFormat {
+    None,
+    Dpkg,
+    Apk,
+    Rpm,
+};
+
+struct PackageRecord {
+    std::string name;
+    std::string version;
+
+    // dpkg's "want flag status" triple, "installed" for apk and rpm
+    std::string status;
+};
+
+// The first package database found under root, "" for /
+PackageFormat detect_package_format(const std::string &root = "");
+
+// The file the database lives in, "" for PackageFormat::None
+std::string package_database_path(PackageFormat format, const std::string &root = "");
+
+// Scanners over a database already in memory, appending a record per package
+void parse_dpkg_status(const char *data, size_t size, std::vector<PackageRecord> &records);
+void parse_apk_installed(const char *data, size_t size, std::vector<PackageRecord> &records);
+
+// Output of `rpm -qa` with a "name\tversion\n" query format
+void parse_rpm_query(const char *data, size_t size, std::vector<PackageRecord> &records);
+
+// dpkg's and apk's databases are mapped and scanned. rpm's is asked through the rpm binary,
+// its formats (BDB, NDB, SQLite) have no layout stable enough to read directly.
+std::vector<PackageRecord> read_package_database(PackageFormat format, const std::string &path);
+
+// Calls on_file with each file of each package, as (package, absolute path). dpkg's file lists
+// live next to its status file, apk's in its database. rpm's are not read.
+void read_package_files(PackageFormat format, const std::string &path, const std::function<void(const std::string &, std::string)> &on_file);
+
+// dpkg keeps removed packages around (config files left, or just the selection)
+bool is_installed(const PackageRecord &record);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ISHELL_PACKAGE_INDEX
+#define ISHELL_PACKAGE_INDEX
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <package_database.hpp>
+
+// Installed packages by name, and by the files they own, for the agency's lookups.
+// The file map is only built on the first owner lookup, most sessions never make one.
+// Safe to use from any thread.
+class PackageIndex {
+public:
+    // records are installed packages. The files are read from the database at database_path.
+    PackageIndex(std::vector<PackageRecord> records, PackageFormat format, std::string database_path);
+
+    // Null if no such package is installed
+    [[nodiscard]] const PackageRecord *find(const std::string &name) const;
+
+    // The package that owns the file, null if none does (or the database lists no files)
+    [[nodiscard]] const PackageRecord *owner_of(const std::string &path) const;
+
+    [[nodiscard]] const std::vector<PackageRecord> &get_records() const;
+
+private:
+    std::vector<PackageRecord> records;
+    std::unordered_map<std::string, size_t> by_name;
+
+    PackageFormat format;
+    std::string database_path;
+
+    mutable std::once_flag files_read;
+    mutable std::unordered_map<std::string, size_t> by_file;
+
+    void read_files() const;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef ISHELL_PACKAGE_INVENTORY
+#define ISHELL_PACKAGE_INVENTORY
+
+#include <sys/types.h>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <package_database.hpp>
+#include <package_index.hpp>
+
+// Index of the installed packages, read once and again only when the package database changes,
+// so queries do not read it each time. Safe to use from any thread.
+class PackageInventory {
+public:
+    PackageInventory(PackageFormat format, std::string database_path);
+    virtual ~PackageInventory();
+
+    PackageInventory(const PackageInventory &) = delete;
+    PackageInventory &operator=(const PackageInventory &) = delete;
+
+    // Reads whichever database the system has
+    static PackageInventory &shared();
+
+    // Reads the database on a thread of its own, get() waits for it if it is still under way
+    void load_in_background();
+
+    // Records sorted by name, read again first if the database changed since the last read
+    std::shared_ptr<const PackageIndex> get();
+
+protected:
+    // The installed packages in any order
+    virtual std::vector<PackageRecord> read_packages();
+
+private:
+    // Tells whether the database file changed, all zero if there is none
+    struct Stamp {
+        dev_t dev = 0;
+        ino_t ino = 0;
+        off_t size = 0;
+        int64_t mtime_ns = 0;
+
+        bool operator==(const Stamp &other) const;
+    };
+
+    PackageFormat format;
+    std::string database_path;
+
+    std::mutex mutex;
+    std::condition_variable loaded;
+    bool loading = false;
+    std::shared_ptr<const PackageIndex> packages;
+    Stamp packages_stamp;
+
+    std::thread loader;
+
+    [[nodiscard]] Stamp stamp() const;
+
+    // Reads the database as of the stamp, which is taken first so a change during the read is not missed
+    void load(const Stamp &current);
+};
+
+#endif
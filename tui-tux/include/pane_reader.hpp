@@ -0,0 +1,72 @@
+#ifndef ISHELL_PANE_READER
+#define ISHELL_PANE_READER
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <escape.hpp>
+#include <event_loop.hpp>
+#include <perf_stats.hpp>
+#include <recorder.hpp>
+#include <spsc_queue.hpp>
+
+// Output of one pty read, already split into terminal characters
+struct PaneChunk {
+    // Bytes read, or -1 once the pty is closed
+    int n_bytes = 0;
+    std::vector<TerminalChar> chars;
+};
+
+// Reads and parses a pane's pty on its own thread. Parsed chunks are handed to the
+// thread owning the Screen through a single-producer/single-consumer queue, so ncurses
+// stays on that thread. With the io_uring backend the pty is read with a multishot read
+// into provided buffers instead of a poll() and read() per chunk.
+class PaneReader {
+public:
+    // Bytes read and time spent parsing go to stats, if given
+    explicit PaneReader(int fd, LoopBackend backend = LoopBackend::Epoll, PaneStats *stats = nullptr);
+    ~PaneReader();
+
+    PaneReader(const PaneReader &) = delete;
+    PaneReader &operator=(const PaneReader &) = delete;
+
+    // Raw pty output also goes to the recorder, as the given stream. Set before start().
+    void set_recorder(Recorder *new_recorder, uint8_t new_stream);
+
+    void start();
+    void stop();
+
+    // Readable whenever chunks were published since the last clear_notification()
+    [[nodiscard]] int get_notify_fd() const;
+    [[nodiscard]] int get_fd() const;
+    void clear_notification() const;
+
+    // Consumer side
+    bool pop(PaneChunk &chunk);
+    [[nodiscard]] bool empty() const;
+
+private:
+    int fd;
+    LoopBackend backend;
+    PaneStats *stats;
+    Recorder *recorder = nullptr;
+    uint8_t stream = 0;
+    int notify_fd = -1;
+    int stop_fd = -1;
+
+    // Wakes the producer once the consumer made room
+    int space_fd = -1;
+    std::atomic<bool> producer_waiting{false};
+
+    SpscQueue<PaneChunk> queue;
+    std::thread thread;
+
+    void run();
+    void run_poll();
+    void run_ring();
+    bool publish_read(const char *buf, int n);
+    bool publish(PaneChunk &chunk);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef ISHELL_PERF_STATS
+#define ISHELL_PERF_STATS
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Counters have a single writer, so a relaxed load and store is enough and no locked
+// instruction lands on the hot paths. Readers on other threads see them eventually.
+inline void stat_add(std::atomic<uint64_t> &counter, const uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline void stat_set(std::atomic<uint64_t> &counter, const uint64_t value) {
+    counter.store(value, std::memory_order_relaxed);
+}
+
+inline uint64_t stat_get(const std::atomic<uint64_t> &counter) {
+    return counter.load(std::memory_order_relaxed);
+}
+
+// What happens to one pane's output, from the pty to the pad
+struct PaneStats {
+    // Written by the pane's reader thread
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> parse_ns{0};
+
+    // Written by the thread owning the Screen
+    std::atomic<uint64_t> chars{0};
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> last_frame_ns{0};
+};
+
+// Durations in power-of-two buckets, good enough for a percentile at a glance
+class LatencyHistogram {
+public:
+    void record(uint64_t ns);
+
+    // Upper bound of the bucket holding the given fraction of samples, 0 if empty
+    [[nodiscard]] uint64_t percentile(double fraction) const;
+    [[nodiscard]] uint64_t count() const;
+    void reset();
+
+private:
+    uint64_t buckets[64] = {};
+    uint64_t samples = 0;
+};
+
+// Shared with the forked agent process, so the multiplexer sees requests in flight
+struct SharedPerfStats {
+    // Start of the agent request in flight (monotonic_ns), 0 if none
+    std::atomic<uint64_t> agent_request_start_ns{0};
+};
+
+// Mapped before forking the panes, null until then
+extern SharedPerfStats *shared_perf_stats;
+void map_shared_perf_stats();
+
+// Short human readable forms for the HUD
+std::string format_ns(uint64_t ns);
+std::string format_rate(double per_second, const char *unit);
+
+#endif
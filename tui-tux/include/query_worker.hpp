@@ -0,0 +1,52 @@
+#ifndef ISHELL_QUERY_WORKER
+#define ISHELL_QUERY_WORKER
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <agency_manager.hpp>
+
+// Runs one agent query at a time off the readline thread, so the agent window stays
+// responsive and the query can be cancelled. The manager is only touched by the worker
+// while a query runs.
+class QueryWorker {
+public:
+    explicit QueryWorker(AgencyManager *manager);
+    ~QueryWorker();
+
+    QueryWorker(const QueryWorker &) = delete;
+    QueryWorker &operator=(const QueryWorker &) = delete;
+
+    void start(const std::string &endpoint, const std::string &query);
+
+    // Aborts the transfer in flight, the query then finishes as cancelled
+    void cancel();
+
+    // Readable when streamed text came in or the query finished
+    [[nodiscard]] int get_fd() const;
+    [[nodiscard]] bool is_busy() const;
+    [[nodiscard]] bool is_finished() const;
+
+    // Streamed text that came in since the last call. False if there is none.
+    bool take_partial(std::string &text);
+
+    // Waits for the query to finish. False if it was cancelled.
+    bool finish(std::string &result);
+
+private:
+    AgencyManager *manager;
+    std::thread thread;
+    std::string result;
+    int done_fd = -1;
+    std::atomic<bool> finished{false};
+
+    // Written by the worker as the answer streams in
+    std::mutex partial_mutex;
+    std::string partial;
+
+    void notify() const;
+};
+
+#endif
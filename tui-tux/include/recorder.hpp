@@ -0,0 +1,77 @@
+#ifndef ISHELL_RECORDER
+#define ISHELL_RECORDER
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <screen.hpp>
+
+// Recordings start with this, followed by entries of
+// [u64 ns since start][u8 stream][u8 kind][u32 length][length bytes], in host byte order
+#define RECORDING_MAGIC "ISHREC01"
+
+// Stream 0 is stdin, stream i + 1 is pane i
+#define RECORD_STREAM_STDIN 0
+
+#define RECORD_KIND_DATA 0
+
+// Payload is the u16 lines and u16 columns given to the stream's pty
+#define RECORD_KIND_RESIZE 1
+
+struct RecordEntry {
+    uint64_t ns = 0;
+    uint8_t stream = 0;
+    uint8_t kind = RECORD_KIND_DATA;
+    std::string data;
+};
+
+// Writes the raw bytes of stdin and of each pane's pty, with monotonic timestamps.
+// Panes are read on threads of their own, so writes are serialized.
+class Recorder {
+public:
+    ~Recorder();
+
+    bool open(const std::string &path);
+    void close();
+
+    void data(uint8_t stream, const char *buf, size_t n);
+    void resize(uint8_t stream, int lines, int cols);
+
+private:
+    FILE *file = nullptr;
+    uint64_t start_ns = 0;
+    std::mutex mutex;
+
+    void write_entry(uint8_t stream, uint8_t kind, const char *buf, size_t n);
+};
+
+class RecordReader {
+public:
+    ~RecordReader();
+
+    bool open(const std::string &path);
+
+    // False at the end, or at an entry cut short
+    bool next(RecordEntry &entry);
+
+private:
+    FILE *file = nullptr;
+};
+
+struct ReplayResult {
+    size_t bytes = 0;
+    size_t entries = 0;
+
+    // How far behind the recorded timing replay fell, with realtime
+    uint64_t max_lag_ns = 0;
+};
+
+// Feeds each pane's output through the parser into screens[pane], laid out and drawn as recorded.
+// With realtime, entries are spaced as recorded, otherwise replayed as fast as possible.
+// Screens are created as panes appear. Stdin is not replayed.
+ReplayResult replay_recording(RecordReader &reader, std::vector<Screen> &screens, bool realtime);
+
+#endif
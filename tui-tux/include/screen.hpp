@@ -2,15 +2,46 @@
 #define ISHELL_SCREEN
 
 #include <ncurses.h>
+#include <cstdint>
+#include <deque>
+#include <string>
 #include <vector>
 
 #include <escape.hpp>
+#include <perf_stats.hpp>
+
+// Position in the whole history of a screen. Lines count from the first line ever written,
+// so they stay valid when old lines are dropped from the pad.
+struct HistoryPos {
+    // -1 while unset
+    int64_t line = -1;
+    int col = 0;
+};
+
+// A command run at a shell prompt, from the shell integration marks (OSC 133)
+struct CommandMark {
+    HistoryPos prompt;
+    HistoryPos command;
+    HistoryPos output;
+    HistoryPos done;
+
+    // -1 until the command finished
+    int exit_status = -1;
+};
 
+// Owns its pad. Move-only, so a relayout never duplicates the history.
 class Screen {
 public:
     Screen();
     Screen(int lines, int cols, int pty_master, int pid);
-    Screen(int lines, int cols, Screen &old_screen);
+    Screen(int lines, int cols, const Screen &old_screen);
+    ~Screen();
+
+    Screen(const Screen &) = delete;
+    Screen &operator=(const Screen &) = delete;
+    Screen(Screen &&other) noexcept;
+    Screen &operator=(Screen &&other) noexcept;
+
     [[nodiscard]] int get_n_lines() const;
     [[nodiscard]] int get_n_cols() const;
     void handle_char(const TerminalChar &tch);
@@ -32,19 +63,50 @@ public:
     [[nodiscard]] int get_pid() const;
     [[nodiscard]] int get_pad_height() const;
     [[nodiscard]] WINDOW *get_pad() const;
-    void delete_wins() const;
     void insert_next(int num);
     [[nodiscard]] int translate_given_x(int x) const;
     int translate_given_y(int y) const;
     void translate_given_coords(int y, int x, int &new_y, int &new_x) const;
     void refresh_screen() const;
     void set_screen_coords(int sminy, int sminx, int smaxy, int smaxx);
-    void expand_pad();
+    void set_viewport(int lines);
+    bool expand_pad();
+    void keep_in_pad();
     bool is_in_manual_scroll() const;
     void reset_manual_scroll();
     void enter_manual_scroll();
     void manual_scroll_up();
     void manual_scroll_down();
+    [[nodiscard]] int get_manual_scrolling_start() const;
+    [[nodiscard]] bool is_bracketed_paste() const;
+    [[nodiscard]] uint64_t get_generation() const;
+    void set_stats(PaneStats *new_stats);
+
+    // Commands in history order, oldest first
+    [[nodiscard]] const std::deque<CommandMark> &get_command_marks() const;
+
+    // Last finished command, null if there is none
+    [[nodiscard]] const CommandMark *last_finished_command() const;
+
+    // Output of the last finished command. False if there is none.
+    bool last_command_output(std::string &output) const;
+
+    // Commands finished so far, including those dropped from the history
+    [[nodiscard]] uint64_t get_commands_done() const;
+
+    // The last lines up to the cursor, wrapped lines joined
+    [[nodiscard]] std::string last_lines(int n) const;
+
+    // Text between two history positions, wrapped lines joined, trailing blanks dropped
+    [[nodiscard]] std::string read_text(HistoryPos from, HistoryPos to) const;
+
+    // In manual scroll, shows the previous or next prompt at the top. False if there is none.
+    bool jump_to_prompt(bool previous);
+
+    // Answers to status queries the application sent, to be written back to its pty
+    [[nodiscard]] bool has_replies() const;
+    std::string take_replies();
+    [[nodiscard]] PaneStats *get_stats() const;
 
 private:
     int n_lines{}, n_cols{};
@@ -55,6 +117,25 @@ private:
     int pushing_right = 0;
     bool cursor_wrapped = false;
 
+    // The application asked for pastes to be wrapped in markers
+    bool bracketed_paste = false;
+
+    // Bumped by all output, tells whether a cached layout of this content is still current
+    uint64_t generation = 0;
+
+    // Lines dropped from the top of the pad so far
+    int64_t lines_dropped = 0;
+
+    // Shell integration index, only touched by marks, trims and reflows
+    std::deque<CommandMark> command_marks;
+    uint64_t commands_done = 0;
+
+    // Answers not yet sent, applications block until they get them
+    std::string replies;
+
+    // Counters shown by the HUD, not owned
+    PaneStats *stats = nullptr;
+
     // Point where pad displaying starts
     int pad_start = 0;
 
@@ -66,7 +147,7 @@ private:
     int sminx = -1, sminy = -1;
     int smaxx = -1, smaxy = -1;
 
-    WINDOW *pad{};
+    WINDOW *pad = nullptr;
 
     // Keeps track of characters placed by the user
     std::vector<std::vector<bool>> user_placed;
@@ -78,7 +159,10 @@ private:
     std::vector<int> line_info;
 
     void init(int new_lines, int new_cols, int new_pty_master, int new_pid);
-    void init(int new_lines, int new_cols, Screen &old_screen);
+    void init(int new_lines, int new_cols, const Screen &old_screen);
+    void answer_query(const TerminalChar &tch);
+    void handle_mark(const TerminalChar &tch);
+    [[nodiscard]] HistoryPos cursor_pos() const;
 
 public:
     // Wrappers
@@ -87,4 +171,19 @@ public:
     int wmove(WINDOW *window, int y, int x);
 };
 
+// Keeps the wrap layout a pane had before its last reflow, so going back to that width
+// is instant as long as the pane got no output in between
+class LayoutCache {
+public:
+    // Lays the screen out for the new geometry in place, swapping in the cached layout if possible.
+    // The layout it replaces is cached.
+    void relayout(Screen &screen, int lines, int cols);
+
+private:
+    Screen cached;
+
+    // Generation of the current layout when this one was cached
+    uint64_t generation = 0;
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef ISHELL_SESSION_HISTORY
+#define ISHELL_SESSION_HISTORY
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The session's <query, result> turns, encoded for the agency once as they are added, in the
+// "Query: ...\nAnswer: ...\n" form it expects. What a request carries is a window of the most
+// recent turns within a token budget, so its size stays bounded however long the session runs.
+// Pinned turns (bookmarks) are kept in the window before recent ones.
+class SessionHistory {
+public:
+    explicit SessionHistory(size_t token_budget = 0);
+
+    void append(const std::string &query, const std::string &result, bool pinned = false);
+
+    // Keeps the turn in the window while the budget allows
+    void pin(size_t index);
+    void unpin(size_t index);
+    [[nodiscard]] bool is_pinned(size_t index) const;
+
+    void clear();
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] bool empty() const;
+
+    // <query, result> of a turn, oldest first
+    std::pair<std::string, std::string> operator[](size_t index) const;
+
+    // Pinned turns that fit the budget, then as many recent turns as still fit, in the order they
+    // were added. Costs as much as the window and the pinned turns hold, not the whole history.
+    [[nodiscard]] std::string window() const;
+
+    [[nodiscard]] size_t get_token_budget() const;
+    void set_token_budget(size_t token_budget);
+
+    // Rough count of the tokens a model would make of the text: four characters of a word per
+    // token, one per punctuation mark or non-ASCII character, and at least one per eight bytes
+    static size_t estimate_tokens(const char *data, size_t size);
+
+private:
+    struct Turn {
+        size_t offset;
+        size_t query_size;
+        size_t result_size;
+        size_t tokens;
+        bool pinned;
+    };
+
+    std::string encoded;
+    std::vector<Turn> turns;
+    // Indices of pinned turns, ascending
+    std::vector<size_t> pinned_turns;
+
+    size_t token_budget;
+
+    [[nodiscard]] size_t encoded_size(const Turn &turn) const;
+};
+
+#endif
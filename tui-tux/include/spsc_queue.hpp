@@ -0,0 +1,59 @@
+#ifndef ISHELL_SPSC_QUEUE
+#define ISHELL_SPSC_QUEUE
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+template <typename T>
+class SpscQueue {
+public:
+    // One slot stays empty to tell a full queue from an empty one
+    explicit SpscQueue(const size_t capacity) : slots(capacity + 1) {}
+
+    // Producer only. Moves the item in on success, leaves it untouched if the queue is full.
+    bool push(T &item) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t next = (t + 1) % slots.size();
+
+        if (next == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        slots[t] = std::move(item);
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool pop(T &item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = std::move(slots[h]);
+        head.store((h + 1) % slots.size(), std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] bool full() const {
+        return (tail.load(std::memory_order_acquire) + 1) % slots.size() == head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> slots;
+
+    // Written by the consumer and the producer respectively, kept on separate cache lines
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef ISHELL_STREAM_PARSER
+#define ISHELL_STREAM_PARSER
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+enum class StreamFormat {
+    SSE,
+    NDJSON
+};
+
+// Content deltas of an agent answer streamed as server-sent events or newline delimited JSON.
+// Each event is an object with a "delta" (or "content") string, an "error", or "done": true.
+// SSE events may also be plain text, and "[DONE]" ends the stream. Bytes may be fed in any pieces.
+class StreamParser {
+public:
+    StreamParser(StreamFormat format, std::function<void(const std::string &)> on_delta);
+
+    // False for content types that are not streamed
+    static bool detect(const std::string &content_type, StreamFormat &format);
+
+    void feed(const char *data, size_t n);
+
+    // Handles what is left after the last line break
+    void finish();
+
+    // Every delta so far
+    [[nodiscard]] const std::string &get_text() const;
+    [[nodiscard]] const std::string &get_error() const;
+    [[nodiscard]] bool is_done() const;
+
+private:
+    StreamFormat format;
+    std::function<void(const std::string &)> on_delta;
+
+    std::string line;
+
+    // The line went past STREAM_LINE_MAX, the rest of it is skipped
+    bool line_dropped = false;
+
+    // Data lines of the SSE event being read
+    std::string event_data;
+    bool has_event_data = false;
+
+    std::string text;
+    std::string error;
+    bool done = false;
+
+    void handle_line();
+    void drop(const char *what);
+    void handle_event(const std::string &payload);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef ISHELL_TERMINAL_CONTEXT
+#define ISHELL_TERMINAL_CONTEXT
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <utils.hpp>
+
+#define TERMINAL_CONTEXT_NONE 0
+#define TERMINAL_CONTEXT_LAST_COMMAND 1
+#define TERMINAL_CONTEXT_LAST_LINES 2
+
+// What the bash window last showed, as attached to agent queries
+struct TerminalContext {
+    int source = TERMINAL_CONTEXT_NONE;
+
+    // Of the last command, -1 for last lines
+    int exit_status = -1;
+
+    // Output was cut down to the budget, the end is kept
+    bool truncated = false;
+
+    std::string output;
+};
+
+// Written in place by the multiplexer, read by the forked agent. The sequence is odd while
+// a write is under way, readers retry until they copied a snapshot with an even, unchanged one.
+struct SharedTerminalContext {
+    std::atomic<uint64_t> sequence{0};
+    int source = TERMINAL_CONTEXT_NONE;
+    int exit_status = -1;
+    bool truncated = false;
+    uint32_t length = 0;
+    char output[TERMINAL_CONTEXT_BUDGET] = {};
+};
+
+// Mapped before forking the panes, null until then
+extern SharedTerminalContext *shared_terminal_context;
+void map_shared_terminal_context();
+
+// Single writer
+void publish_terminal_context(int source, int exit_status, const std::string &output);
+
+// Source is TERMINAL_CONTEXT_NONE if nothing was published
+TerminalContext read_terminal_context();
+
+// The end of the text that fits the budget, starting on a whole UTF-8 character
+std::string tail_within_budget(const std::string &text, size_t budget);
+
+// Bytes that are not part of valid UTF-8 become '?', the output is sent as JSON
+std::string sanitize_utf8(const std::string &text);
+
+#endif
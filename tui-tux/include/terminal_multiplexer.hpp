@@ -1,11 +1,36 @@
 #ifndef ISHELL_TERMINAL_MULTIPLEXER
 #define ISHELL_TERMINAL_MULTIPLEXER
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <screen.hpp>
+#include <event_loop.hpp>
+#include <pane_reader.hpp>
+#include <outbound_queue.hpp>
+#include <perf_stats.hpp>
+#include <recorder.hpp>
 #include <utils.hpp>
 
+struct LoopStats {
+    uint64_t turns = 0;
+
+    // Worst delay between a keystroke becoming readable and it being handled, and the time spent
+    // handling each turn, both since the HUD last refreshed
+    uint64_t max_input_latency_ns = 0;
+    LatencyHistogram turn_latency;
+};
+
+// Pane counters as of the last HUD refresh, to turn totals into rates
+struct PaneSample {
+    uint64_t bytes = 0;
+    uint64_t parse_ns = 0;
+    uint64_t chars = 0;
+    uint64_t frames = 0;
+};
+
 class TerminalMultiplexer {
 public:
     TerminalMultiplexer();
@@ -22,26 +47,90 @@ private:
     WINDOW *bottom_bar = nullptr, *middle_divider = nullptr;
 
     std::vector<Screen> screens;
-    std::vector<WINDOW *> windows;
+
+    // Layout of each screen for the width it had before its last reflow
+    std::vector<LayoutCache> layout_caches;
+
+    // Reader thread for each screen's pty, and whether parsed output is waiting
+    std::vector<std::unique_ptr<PaneReader>> readers;
+    std::vector<bool> pane_pending;
+
+    // Pending input for each screen's pty, and whether EPOLLOUT is watched for it
+    std::vector<OutboundQueue> outbound;
+    std::vector<bool> watching_output;
+
+    std::unique_ptr<EventLoop> event_loop;
+
+    // Bracketed paste from the outer terminal. Stdin is paused while the target pane is behind,
+    // but only until the timer fires, so a pane that stops reading cannot hold up the keyboard.
+    PasteState paste;
+    int paste_target = -1;
+    bool paste_wrapped = false;
+    bool paste_stalled = false;
+    bool input_paused = false;
+    int paste_timer_fd = -1;
+
+    LoopStats loop_stats;
+
+    // Raw I/O of the session, if $ISHELL_RECORD is set
+    std::unique_ptr<Recorder> recorder;
+
+    // Counters of each pane, fed by its reader thread and its Screen
+    std::vector<PaneStats> pane_stats;
+
+    // Performance HUD in the bottom bar, refreshed by a timer only while shown
+    bool hud_visible = false;
+    int hud_timer_fd = -1;
+    uint64_t hud_sampled_at = 0;
+    std::vector<PaneSample> hud_samples;
+    std::string hud_text;
+
+    // Commands the bash window finished when its output was last handed to the agent
+    uint64_t context_commands_done = 0;
+
+    // Without shell integration marks the last lines are handed over on a throttle, the timer
+    // catches the output that came after the last time
+    int context_timer_fd = -1;
+    bool context_timer_armed = false;
+    uint64_t context_published_at = 0;
+
+    // SIGWINCH is debounced: the layout follows right away, the history reflow and the
+    // children's SIGWINCH wait until the size settles
+    int resize_timer_fd = -1;
+    uint64_t resize_pending_since = 0;
 
     void init();
+    [[nodiscard]] int bash_integration_rc() const;
     void init_nc();
     void refresh_cursor() const;
     void draw_focus() const;
+    void draw_bottom_bar() const;
     void switch_focus();
-    void create_wins_draw();
+    void create_wins_draw(bool reflow = true);
+    static void place_window(WINDOW *&window, int lines, int cols, int y, int x);
     void delete_windows();
     void cleanup();
     void send_dims();
     void resize();
+    void schedule_resize();
+    void relayout();
     void run_terminal();
-    int handle_screen_output(Screen &screen, int fd) const;
+    int handle_screen_output(int index, bool &more);
     int handle_input();
+    void handle_key(const TerminalChar &tch);
+    void begin_paste();
+    void handle_paste(const std::string &payload);
+    void pause_input(bool paused);
 
-    static void handle_pty_input(int fd, char ch);
+    void handle_pty_input(int index, const std::string &data);
+    void flush_pty_input(int index);
     void zoom_in();
     void zoom_out();
     void toggle_manual_scroll();
+    void toggle_hud();
+    void update_hud();
+    void update_terminal_context();
+    void publish_last_lines();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef ISHELL_TRACE
+#define ISHELL_TRACE
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <utils.hpp>
+
+// Spans recorded while tracing is on, written as Chrome trace events (chrome://tracing, Perfetto).
+// Each thread records into its own lock-free buffer, a background thread writes them out.
+extern std::atomic<bool> trace_enabled;
+
+struct TraceEvent {
+    const char *name = nullptr;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
+};
+
+void trace_record(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+// Records the enclosing scope. Off, it costs one well predicted branch.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *span_name) {
+        if (__builtin_expect(trace_enabled.load(std::memory_order_relaxed), false)) {
+            name = span_name;
+            start_ns = monotonic_ns();
+        }
+    }
+
+    ~TraceSpan() {
+        if (name != nullptr) {
+            trace_record(name, start_ns, monotonic_ns());
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    // Names are string literals, only the pointer is kept
+    const char *name = nullptr;
+    uint64_t start_ns = 0;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+// Starts writing a trace to the given file. Returns false if it cannot be opened.
+bool trace_start(const std::string &path);
+
+// Starts tracing to $ISHELL_TRACE with the suffix appended, if set
+void trace_start_from_env(const std::string &suffix = "");
+
+// Writes out what is left and closes the file
+void trace_stop();
+
+#endif
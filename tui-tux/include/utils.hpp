@@ -5,10 +5,83 @@
 #define FOCUS_AGENT 0
 #define FOCUS_BASH 1
 
-#define MAX_EVENTS 5
+#define MAX_EVENTS 8
+
+// Per-turn read budget of a single pty, so a flooding pane cannot starve stdin
+#define PTY_READ_BUDGET_BYTES (64 * 1024)
+#define PTY_READ_BUDGET_NS (4 * 1000 * 1000)
+
+// Pty reads are parsed on a thread per pane and queued for the main thread
+#define PANE_READ_BUFSIZ (16 * 1024)
+#define PANE_QUEUE_CHUNKS 64
+
+// Buffers handed to the kernel for multishot pty reads with the io_uring backend
+#define PANE_RING_BUFFERS 8
+
+// Size of a single read from stdin, large enough to stream pastes
+#define INPUT_READ_BUFSIZ (64 * 1024)
+
+// Bytes that may wait for a slow pty before further input is dropped
+#define PTY_OUTBOUND_CAPACITY (1024 * 1024)
+
+// Longest stdin waits for a pane to take a paste, after that the rest of the paste is dropped
+#define PASTE_STALL_NS (500 * 1000 * 1000)
+
+// Quiet time after the last SIGWINCH before panes are reflowed, and the longest a reflow waits
+#define RESIZE_DEBOUNCE_NS (40 * 1000 * 1000)
+#define RESIZE_MAX_DELAY_NS (250 * 1000 * 1000)
+
+// Spans each thread may buffer before the trace flusher writes them out, and how often it does
+#define TRACE_BUFFER_EVENTS (16 * 1024)
+#define TRACE_FLUSH_NS (100 * 1000 * 1000)
+
+// How often the performance HUD refreshes while shown
+#define HUD_REFRESH_NS (1000 * 1000 * 1000)
+
+// Most of the bash window's output attached to an agent query, the end is kept.
+// Without shell integration marks, the last lines of the window are sent instead.
+#define TERMINAL_CONTEXT_BUDGET (8 * 1024)
+#define TERMINAL_CONTEXT_LINES 50
+
+// Without the marks the last lines are handed over at most this often while output keeps coming
+#define TERMINAL_CONTEXT_REFRESH_NS (250 * 1000 * 1000)
+
+// Estimated tokens of session history sent with a query, unless ISHELL_HISTORY_TOKENS says
+// otherwise. The most recent turns that fit are sent, bookmarked ones first.
+#define SESSION_HISTORY_TOKENS 4096
+
+// Agent requests, in seconds unless ISHELL_CONNECT_TIMEOUT / ISHELL_TIMEOUT say otherwise
+#define HTTP_CONNECT_TIMEOUT_S 10
+#define HTTP_TIMEOUT_S 300
+
+// Idle easy handles kept for reuse, each may hold live connections
+#define HTTP_POOL_HANDLES 4
+
+// Longest line, and SSE event, of a streamed answer. A server that never ends one gets it dropped.
+#define STREAM_LINE_MAX (1024 * 1024)
+
+// Spinner frame interval while an agent query runs
+#define SPINNER_INTERVAL_MS 100
+
+// Package databases, the installed package list is read again only once the one in use changes
+#define DPKG_STATUS_PATH "/var/lib/dpkg/status"
+#define APK_INSTALLED_PATH "/lib/apk/db/installed"
+#define RPM_DB_DIR "/var/lib/rpm"
+#define PACKAGE_READ_BUFSIZ (64 * 1024)
+
+// Lookups the agency may ask for instead of getting the package list, and how many rounds of
+// them one query may take before its last answer stands
+#define AGENT_TOOL_PACKAGE_INSTALLED "package_installed"
+#define AGENT_TOOL_PACKAGE_VERSION "package_version"
+#define AGENT_TOOL_PACKAGE_OWNER "package_owner"
+#define AGENT_TOOL_ROUNDS 4
 
 #define INITIAL_PAD_HEIGHT 100
 
+// ncurses windows have at most SHRT_MAX lines. Once full, the oldest lines are dropped in chunks.
+#define MAX_PAD_HEIGHT 32000
+#define PAD_TRIM_LINES 4000
+
 #define KEY_BEL 0x07
 #define KEY_SI 0x0f
 #define KEY_BS 0x08
@@ -16,11 +89,13 @@
 #define LINE_INFO_UNTOUCHED 0
 #define LINE_INFO_UNWRAPPED 1
 #define LINE_INFO_WRAPPED 2
+#include <cstdint>
 #include <string>
 #include <vector>
 
 std::vector<std::string> split(std::string &str, char delim, bool ignore_empty);
 std::string join(std::vector<std::string> &words, char delim);
+uint64_t monotonic_ns();
 
 #define DEFAULT_AGENCY_URL "https://ishell-stage.csai.site/agents"
 #define DEFAULT_ISHELL_LOCAL_DIR "/etc/ishell"
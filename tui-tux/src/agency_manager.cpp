@@ -5,6 +5,11 @@
 
 AgencyManager::AgencyManager(AgencyRequestWrapper* request_wrapper)
     : request_wrapper(request_wrapper) {
+    if (const char *budget_env = getenv("ISHELL_HISTORY_TOKENS"); budget_env != nullptr) {
+        if (const long budget = strtol(budget_env, nullptr, 10); budget > 0) {
+            session_history.set_token_budget(budget);
+        }
+    }
 }
 
 AgencyManager::~AgencyManager() = default;
@@ -30,9 +35,19 @@ void AgencyManager::set_agent_name(const std::string &agent_name) {
     this->agent_name = agent_name;
 }
 
+void AgencyManager::prewarm() {
+    request_wrapper->prewarm(get_agency_url() + "/" + get_agent_name());
+}
+
 std::string AgencyManager::execute_query(const std::string &endpoint, const std::string &query) {
     std::string result = request_wrapper->ask_agent(endpoint, query, session_history);
-    session_history.emplace_back(query, result);
+
+    // A cancelled query never got an answer, it stays out of the context
+    if (request_wrapper->cancel_requested) {
+        return "";
+    }
+
+    session_history.append(query, result);
 
     return result;
 }
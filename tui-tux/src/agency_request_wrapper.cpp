@@ -7,8 +7,8 @@
 #include "../nlohmann/json.hpp"
 #include <https_client.hpp>
 #include <agency_request_wrapper.hpp>
-
-#define INSTALLED_PACKAGES_BUFSIZ 128
+#include <package_inventory.hpp>
+#include <utils.hpp>
 
 using json = nlohmann::json;
 
@@ -21,19 +21,9 @@ std::string AgencyRequestWrapper::get_linux_distro() {
     return std::string(buffer.sysname) + std::string(" ") + std::string(buffer.version); // or use buffer.release, buffer.version
 }
 
-// Function to get installed packages (simple example using dpkg on Debian/Ubuntu systems)
-std::vector<std::string> AgencyRequestWrapper::get_installed_packages() {
-    std::vector<std::string> packages;
-    FILE* pipe = popen("dpkg --get-selections | awk '{print $1}'", "r");
-    if (!pipe) {
-        return packages;
-    }
-    char buffer[INSTALLED_PACKAGES_BUFSIZ];
-    while (fgets(buffer, 128, pipe) != nullptr) {
-        packages.emplace_back(buffer);
-    }
-    pclose(pipe);
-    return packages;
+// Installed packages, cached until the package database changes
+std::shared_ptr<const PackageIndex> AgencyRequestWrapper::get_package_index() {
+    return PackageInventory::shared().get();
 }
 
 // Function to get SSH IP, port, and user from environment variables (? might change ?)
@@ -60,44 +50,171 @@ std::string AgencyRequestWrapper::get_ssh_user() {
     return "Unknown";
 }
 
+// What the bash window last showed, shared by the multiplexer
+TerminalContext AgencyRequestWrapper::get_terminal_context() {
+    return read_terminal_context();
+}
+
 // Function to send request to agent's server
-json AgencyRequestWrapper::send_request_to_agent_server(const std::string& url, const std::string& user_query, std::vector<std::pair<std::string, std::string>> &session_history) {
+json AgencyRequestWrapper::send_request_to_agent_server(const std::string& url, const std::string& user_query, const SessionHistory &session_history) {
     std::string distro = get_linux_distro();
-    std::vector<std::string> installed_packages = get_installed_packages();
     std::string ssh_ip = get_ssh_ip();
     int ssh_port = get_ssh_port();
     std::string ssh_user = get_ssh_user();
-    std::string history = get_session_history_string(session_history);
 
-    const json request_body = {
+    // Same from one query to the next, sent in full only until the agency has it
+    const json context = {
         {"distro", distro},
-        {"installed_packages", installed_packages},
-        {"query", user_query},
-        {"session_history", history},
         {"ssh_ip", ssh_ip},
         {"ssh_port", ssh_port},
         {"ssh_user", ssh_user}
     };
 
+    // Packages are looked up by the agency as needed, instead of all of them sent along
+    json request_body = {
+        {"query", user_query},
+        {"session_history", session_history.window()},
+        {"tools", {AGENT_TOOL_PACKAGE_INSTALLED, AGENT_TOOL_PACKAGE_VERSION, AGENT_TOOL_PACKAGE_OWNER}}
+    };
+
+    // Only when there is something to show, the field is optional for the server
+    if (const TerminalContext terminal = get_terminal_context(); !terminal.output.empty()) {
+        json terminal_context = {
+            {"source", terminal.source == TERMINAL_CONTEXT_LAST_COMMAND ? "last_command" : "last_lines"},
+            {"output", terminal.output},
+            {"truncated", terminal.truncated}
+        };
+
+        if (terminal.source == TERMINAL_CONTEXT_LAST_COMMAND) {
+            terminal_context["exit_status"] = terminal.exit_status;
+        }
+
+        request_body["terminal_context"] = terminal_context;
+    }
+
     const char *token_env = getenv("ISHELL_TOKEN");
 
+    // Servers that can stream the answer send deltas as they are generated
     std::map<std::string, std::string> headers = {
         {"Content-Type", "application/json"},
+        {"Accept", "text/event-stream, application/x-ndjson, application/json"},
     };
 
     if (token_env != nullptr) {
         headers.emplace("Authorization", std::string("token ") + std::string(token_env));
     }
 
-    json response = make_http_request(HttpRequestType::POST, url, {}, request_body, headers);
+    json response;
+
+    for (int round = 0; ; round++) {
+        json body = request_body;
+        context_handshake.attach(body, context);
+        response = make_http_request(HttpRequestType::POST, url, {}, body, headers);
+
+        // The agency lost the context it acknowledged, once more in full
+        if (context_handshake.on_response(response)) {
+            body = request_body;
+            context_handshake.attach(body, context);
+            response = make_http_request(HttpRequestType::POST, url, {}, body, headers);
+            context_handshake.on_response(response);
+        }
+
+        // Asked something instead of answering, the request goes again with the results
+        const json &response_body = response.contains("body") ? response["body"] : json();
+        if (!response_body.is_object() || !response_body.contains("tool_calls") || !response_body["tool_calls"].is_array() ||
+            cancel_requested) {
+            break;
+        }
+
+        if (round == AGENT_TOOL_ROUNDS) {
+            response["error"] = "agent still asking for tool calls after " + std::to_string(AGENT_TOOL_ROUNDS) + " rounds";
+            break;
+        }
+
+        json &results = request_body["tool_results"];
+        if (!results.is_array()) {
+            results = json::array();
+        }
+        for (const json &call : response_body["tool_calls"]) {
+            results.push_back(run_tool_call(call));
+        }
+    }
 
     return response;
 }
 
+// The string argument, or false if it is missing or of another type
+static bool string_argument(const json &arguments, const char *key, std::string &value) {
+    if (!arguments.contains(key) || !arguments[key].is_string()) {
+        return false;
+    }
+
+    value = arguments[key].get<std::string>();
+    return true;
+}
+
+json AgencyRequestWrapper::run_tool_call(const json &call) {
+    // Whatever the agency sent, it gets an error back rather than the agent going down
+    if (!call.is_object()) {
+        return {{"id", json()}, {"error", "tool call is not an object"}};
+    }
+
+    json result = {{"id", call.contains("id") ? call["id"] : json()}};
+
+    if (!call.contains("name") || !call["name"].is_string()) {
+        result["error"] = "tool call without a name";
+        return result;
+    }
+    if (call.contains("arguments") && !call["arguments"].is_object()) {
+        result["error"] = "tool call arguments are not an object";
+        return result;
+    }
+
+    const std::string name = call["name"].get<std::string>();
+    const json arguments = call.contains("arguments") ? call["arguments"] : json::object();
+    std::string argument;
+
+    if (name == AGENT_TOOL_PACKAGE_INSTALLED || name == AGENT_TOOL_PACKAGE_VERSION) {
+        if (!string_argument(arguments, "package", argument)) {
+            result["error"] = "package must be a string";
+            return result;
+        }
+
+        const std::shared_ptr<const PackageIndex> index = get_package_index();
+        const PackageRecord *record = index != nullptr ? index->find(argument) : nullptr;
+
+        result["result"] = {{"installed", record != nullptr}};
+        if (name == AGENT_TOOL_PACKAGE_VERSION) {
+            result["result"]["version"] = record != nullptr ? json(record->version) : json();
+        }
+    } else if (name == AGENT_TOOL_PACKAGE_OWNER) {
+        if (!string_argument(arguments, "path", argument)) {
+            result["error"] = "path must be a string";
+            return result;
+        }
+
+        const std::shared_ptr<const PackageIndex> index = get_package_index();
+        const PackageRecord *record = index != nullptr ? index->owner_of(argument) : nullptr;
+        result["result"] = {{"package", record != nullptr ? json(record->name) : json()}};
+    } else {
+        result["error"] = "unknown tool: " + name;
+    }
+
+    return result;
+}
+
 // Wrapper prep function for request for agent
-std::string AgencyRequestWrapper::ask_agent(const std::string& url, const std::string& user_query, std::vector<std::pair<std::string, std::string>> &session_history) {
+std::string AgencyRequestWrapper::ask_agent(const std::string& url, const std::string& user_query, const SessionHistory &session_history) {
     json response = send_request_to_agent_server(url, user_query, session_history);
 
+    // Transfer failed or was cancelled, there is no body
+    if (response.contains("error")) {
+        if (!cancel_requested) {
+            std::cerr << "Request failed: " << response["error"] << std::endl;
+        }
+        return "";
+    }
+
     const json response_body = response["body"];
 
     if (response_body.contains("error")) {
@@ -118,17 +235,15 @@ json AgencyRequestWrapper::make_http_request(const HttpRequestType request_type,
                                              const json& body,
                                              const std::map<std::string, std::string>& headers) {
     HttpsClient https_client;
+    https_client.set_cancel_flag(&cancel_requested);
+    https_client.set_stream_callback(on_delta);
     return https_client.make_http_request(request_type, url, query_params, body, headers);
 }
 
+void AgencyRequestWrapper::prewarm(const std::string &url) {
+    HttpConnectionPool::shared().prewarm(url);
+}
+
 char *AgencyRequestWrapper::getenv(const char *key) {
     return std::getenv(key);
 }
-
-std::string AgencyRequestWrapper::get_session_history_string(std::vector<std::pair<std::string, std::string>> &session_history) {
-    std::ostringstream history_stream;
-    for (const auto &[fst, snd] : session_history) {
-        history_stream << "Query: " << fst << "\nAnswer: " << snd << "\n";
-    }
-    return history_stream.str();
-}
\ No newline at end of file
@@ -2,12 +2,21 @@
 #include <readline/history.h>
 #include <cstdio>
 #include <cstdlib>
+#include <cerrno>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <agency_manager.hpp>
 #include <bookmark_manager.hpp>
 #include <agency_request_wrapper.hpp>
+#include <package_inventory.hpp>
+#include <query_worker.hpp>
+#include <perf_stats.hpp>
+#include <trace.hpp>
+#include <utils.hpp>
 
 #include "command_manager.hpp"
 
@@ -22,6 +31,10 @@ AgencyRequestWrapper request_wrapper;
 AgencyManager manager(&request_wrapper);
 BookmarkManager bookmark_manager(&manager);
 CommandManager command_manager(&bookmark_manager);
+QueryWorker query_worker(&manager);
+
+// Installed again once the answer to a query is shown
+std::string prompt;
 
 bool running = true;
 int prompt_mode = MODE_AGENT;
@@ -52,8 +65,15 @@ void line_handler(char *line) {
     if (prompt_mode == MODE_AGENT) {
         // New query to agent
         const std::string agency = manager.get_agency_url();
-        const std::string result = manager.execute_query(agency + "/" + bookmark_manager.agency_manager->get_agent_name(), input_str);
-        std::cout << result << "\n";
+
+        // Shown by the multiplexer's HUD while in flight
+        if (shared_perf_stats != nullptr) {
+            stat_set(shared_perf_stats->agent_request_start_ns, monotonic_ns());
+        }
+
+        // The answer comes later, the prompt comes back with it
+        rl_callback_handler_remove();
+        query_worker.start(agency + "/" + bookmark_manager.agency_manager->get_agent_name(), input_str);
     } else if (prompt_mode == MODE_SYSTEM) {
         command_manager.run_command(input_str);
     }
@@ -61,7 +81,106 @@ void line_handler(char *line) {
     free(line);
 }
 
+// Shows a spinner until the query in flight finished. Ctrl-C, or ESC on its own, cancels it.
+void wait_for_query() {
+    static const char frames[] = "|/-\\";
+
+    // Keys are read as they come. The pty is not our controlling terminal, so with ISIG
+    // the line discipline would swallow Ctrl-C without any signal to show for it.
+    termios saved{};
+    const bool is_tty = tcgetattr(STDIN_FILENO, &saved) == 0;
+    if (is_tty) {
+        termios raw = saved;
+        raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    }
+
+    pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {query_worker.get_fd(), POLLIN, 0}};
+    bool cancelling = false;
+
+    // Once a streamed answer starts coming in, it replaces the spinner
+    bool streamed = false;
+
+    for (int frame = 0; ; frame++) {
+        if (!streamed) {
+            std::cout << "\r" << frames[frame % 4] << (cancelling ? " cancelling" : " waiting for the agent, Ctrl-C to cancel") << std::flush;
+        }
+
+        if (poll(fds, 2, SPINNER_INTERVAL_MS) < 0 && errno != EINTR) {
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            // Checked first, the text taken after it is then all there is
+            const bool finished = query_worker.is_finished();
+
+            if (std::string text; query_worker.take_partial(text)) {
+                if (!streamed) {
+                    std::cout << "\r\x1b[K";
+                    streamed = true;
+                }
+
+                std::cout << text << std::flush;
+            }
+
+            if (finished) {
+                break;
+            }
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            char keys[64];
+            const ssize_t n = read(STDIN_FILENO, keys, sizeof(keys));
+
+            // Arrow keys start with ESC too, only a lone one cancels
+            bool cancel = n <= 0 || (n == 1 && keys[0] == 0x1B);
+            for (ssize_t i = 0; i < n; i++) {
+                cancel = cancel || keys[i] == 0x03;
+            }
+
+            if (n <= 0) {
+                running = false;
+                fds[0].fd = -1;
+            }
+
+            if (cancel && !cancelling) {
+                query_worker.cancel();
+                cancelling = true;
+            }
+        }
+    }
+
+    std::string result;
+    const bool answered = query_worker.finish(result);
+
+    if (shared_perf_stats != nullptr) {
+        stat_set(shared_perf_stats->agent_request_start_ns, 0);
+    }
+
+    if (streamed) {
+        // The answer is already out
+        std::cout << (answered ? "\n" : "\nCancelled\n");
+    } else {
+        // Clear the spinner line
+        std::cout << "\r\x1b[K" << (answered ? result : "Cancelled") << "\n";
+    }
+
+    if (is_tty) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    }
+
+    if (running) {
+        rl_callback_handler_install(prompt.c_str(), &line_handler);
+    }
+}
+
 void agent() {
+    // A trace file of its own, next to the multiplexer's
+    trace_start_from_env("." + std::to_string(getpid()));
+
     // Enable history storage
     history_storage = std::vector(2, std::vector<std::string>());
 
@@ -69,7 +188,12 @@ void agent() {
     rl_inhibit_completion = 1;
 
     using_history();
-    manager.get_agency_url();
+
+    // Connect while the user types the first query
+    manager.prewarm();
+
+    // Ready by the first query, it is sent along with each
+    PackageInventory::shared().load_in_background();
 
     bookmark_manager.load_bookmarks("local/bookmarks.json");
 
@@ -83,12 +207,17 @@ void agent() {
             agent_name = system_name;
         }
 
-        std::string prompt = agent_name + "> ";
+        prompt = agent_name + "> ";
         rl_callback_handler_install(prompt.c_str(), &line_handler);
 
         while (running) {
             rl_callback_read_char();
 
+            if (query_worker.is_busy()) {
+                wait_for_query();
+                continue;
+            }
+
             if (const int pos = rl_point; pos > 0 && rl_line_buffer[pos - 1] == '\t') {
                 // Erase last character, break out, switch agent type
                 rl_delete_text(pos - 1, pos);
@@ -105,4 +234,6 @@ void agent() {
     }
 
     bookmark_manager.save_bookmarks("local/bookmarks.json");
+
+    trace_stop();
 }
@@ -119,6 +119,9 @@ void BookmarkManager::bookmark(int index, const std::string &alias) {
 
     auto pair = agency_manager->session_history[len - index];
 
+    // A turn worth keeping stays in the window sent with queries
+    pin_turn(alias, len - index);
+
     // bookmark
     bookmarks[alias] = pair;
     std::cout << "Saved the query under the bookmark '" << alias  << "'" << "\n";
@@ -127,6 +130,7 @@ void BookmarkManager::bookmark(int index, const std::string &alias) {
 void BookmarkManager::remove_bookmark(const std::string &alias) {
     if (const auto it = bookmarks.find(alias); it != bookmarks.end()) {
         bookmarks.erase(it);
+        unpin_turn(alias);
         std::cout << "Removed bookmark '" << alias << "'.\n";
     } else {
         std::cerr << "Error: Bookmark '" << alias << "' not found.\n";
@@ -134,6 +138,31 @@ void BookmarkManager::remove_bookmark(const std::string &alias) {
     }
 }
 
+void BookmarkManager::pin_turn(const std::string &alias, const size_t index) {
+    unpin_turn(alias);
+
+    pinned_turns[alias] = index;
+    agency_manager->session_history.pin(index);
+}
+
+void BookmarkManager::unpin_turn(const std::string &alias) {
+    const auto it = pinned_turns.find(alias);
+    if (it == pinned_turns.end()) {
+        return;
+    }
+
+    const size_t index = it->second;
+    pinned_turns.erase(it);
+
+    // Another bookmark may have saved the same turn
+    for (const auto &[other, other_index] : pinned_turns) {
+        if (other_index == index) {
+            return;
+        }
+    }
+    agency_manager->session_history.unpin(index);
+}
+
 void BookmarkManager::list_bookmarks() const {
     constexpr int alias_width = 20;
     constexpr int query_width = 50;
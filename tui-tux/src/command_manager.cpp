@@ -33,13 +33,18 @@ void CommandManager::run_command(std::string &command) {
 
 void CommandManager::run_alias(std::string &alias) {
     const std::pair<std::string, std::string> bookmark = bookmark_manager->get_bookmark(alias);
-    bookmark_manager->agency_manager->session_history.push_back(bookmark);
+    SessionHistory &session_history = bookmark_manager->agency_manager->session_history;
+    session_history.append(bookmark.first, bookmark.second);
+
+    // Kept in the window sent with queries ahead of older turns, only its latest run
+    bookmark_manager->pin_turn(alias, session_history.size() - 1);
     std::cout << bookmark.second << "\n";
 }
 
 void CommandManager::clear(const std::vector<std::string> &args) {
     if (args.empty()) {
         bookmark_manager->agency_manager->session_history.clear();
+        bookmark_manager->pinned_turns.clear();
         std::cout << "Cleared session history.\n\n";
     }
 }
@@ -51,6 +56,9 @@ void CommandManager::agent_switch(const std::vector<std::string> &args) {
     }
 
     bookmark_manager->agency_manager->set_agent_name(args[0]);
+
+    // The first query to the new agent should not pay for the connection
+    bookmark_manager->agency_manager->prewarm();
 }
 
 int CommandManager::read_from_file(std::string &filepath, std::string &output) {
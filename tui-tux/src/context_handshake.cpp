@@ -0,0 +1,75 @@
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <strings.h>
+
+#include <context_handshake.hpp>
+
+#define HTTP_CONFLICT 409
+
+// FNV-1a, 64 bit
+static uint64_t fnv1a(const std::string &data) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char c : data) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string ContextHandshake::fingerprint(const json &context) {
+    // json objects keep their keys sorted, so the dump does not depend on insertion order
+    const uint64_t hash = fnv1a(context.dump());
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016" PRIx64, hash);
+    return hex;
+}
+
+void ContextHandshake::attach(json &body, const json &context) {
+    const std::string hash = fingerprint(context);
+
+    body["context_hash"] = hash;
+    sent_hash = hash;
+
+    // The agency has it all
+    sent_full = acked_hash.empty() || hash != acked_hash;
+    if (!sent_full) {
+        return;
+    }
+
+    for (const auto &[key, value] : context.items()) {
+        body[key] = value;
+    }
+}
+
+bool ContextHandshake::on_response(const json &response) {
+    const json &status_code = response.contains("status_code") ? response["status_code"] : json();
+    const json &body = response.contains("body") ? response["body"] : json();
+
+    if ((status_code.is_number() && status_code.get<int>() == HTTP_CONFLICT) ||
+        (body.is_object() && body.contains("error") && body["error"] == "unknown_context")) {
+        reset();
+
+        // Already sent in full, sending it again would not help
+        return !sent_full;
+    }
+
+    if (!response.contains("headers") || !response["headers"].is_object()) {
+        return false;
+    }
+
+    // HTTP/2 header names come lowercase
+    for (const auto &[name, value] : response["headers"].items()) {
+        if (strcasecmp(name.c_str(), "Context-Hash") == 0 && value.is_string() && value == sent_hash) {
+            acked_hash = sent_hash;
+            break;
+        }
+    }
+
+    return false;
+}
+
+void ContextHandshake::reset() {
+    acked_hash.clear();
+}
@@ -1,5 +1,8 @@
+#include <algorithm>
+#include <climits>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <cstring>
 #include <unistd.h>
 #include <unordered_map>
 
@@ -7,76 +10,219 @@
 
 #define READ_BUFSIZ 1024
 
-TerminalChar escape(const std::string &seq) {
-    // Check `infocmp linux-m`
+// Digits of a CSI parameter, possibly none, appended to args. Numbers too large for an int
+// are left out. False if there is anything but digits.
+static bool parse_number(const std::string_view digits, std::vector<int> &args) {
+    long value = 0;
 
-    std::vector<std::pair<std::regex, int>> regexes = {
-        {std::regex("^\x1b\\[J$"), E_KEY_CLEAR},
-        {std::regex("^\x1b\\[(\\d*)P$"), E_KEY_DCH},
-        {std::regex("^\x1b\\[K$"), E_KEY_EL},
-        {std::regex("^\x1b\\[H|^\x1b\\[(\\d+);(\\d+)H$"), E_KEY_CUP},
-        {std::regex("^\x1b\\[(\\d*)d$"), E_KEY_VPA},
-        {std::regex("^\x1b\\[(\\d*)D$"), E_KEY_CUB},
-        {std::regex("^\x1b\\[(\\d*)C$"), E_KEY_CUF},
-        {std::regex("^\x1b\\[(\\d*)A$"), E_KEY_CUU},
-        {std::regex("^\x1b\\[(\\d*)B$"), E_KEY_CUD},
-        {std::regex("^\x1bM$"), E_KEY_RI},
-        {std::regex("^\x1b\\[(\\d*)@$"), E_KEY_ICH}
-    };
+    for (const char c : digits) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+
+        if (value <= INT_MAX) {
+            value = value * 10 + (c - '0');
+        }
+    }
+
+    if (!digits.empty() && value <= INT_MAX) {
+        args.push_back(static_cast<int>(value));
+    }
 
-    std::smatch matches;
+    return true;
+}
+
+// CSI sequences are told apart by their final byte, then their parameters
+static int escape_csi(const char final, const std::string_view params, std::vector<int> &args) {
+    switch (final) {
+        case 'J':
+            return params.empty() ? E_KEY_CLEAR : 0;
+        case 'K':
+            return params.empty() ? E_KEY_EL : 0;
+        case 'H': {
+            if (params.empty()) {
+                return E_KEY_CUP;
+            }
 
+            // Both the row and the column, or neither
+            const size_t semicolon = params.find(';');
+            if (semicolon == std::string_view::npos || semicolon == 0 || semicolon == params.size() - 1) {
+                return 0;
+            }
+
+            if (!parse_number(params.substr(0, semicolon), args) || !parse_number(params.substr(semicolon + 1), args)) {
+                args.clear();
+                return 0;
+            }
+            return E_KEY_CUP;
+        }
+        case 'P':
+            return parse_number(params, args) ? E_KEY_DCH : 0;
+        case 'd':
+            return parse_number(params, args) ? E_KEY_VPA : 0;
+        case 'D':
+            return parse_number(params, args) ? E_KEY_CUB : 0;
+        case 'C':
+            return parse_number(params, args) ? E_KEY_CUF : 0;
+        case 'A':
+            return parse_number(params, args) ? E_KEY_CUU : 0;
+        case 'B':
+            return parse_number(params, args) ? E_KEY_CUD : 0;
+        case '@':
+            return parse_number(params, args) ? E_KEY_ICH : 0;
+        case '~':
+            if (params == "200") {
+                return E_KEY_PASTE_BEGIN;
+            }
+            return params == "201" ? E_KEY_PASTE_END : 0;
+        case 'h':
+            return params == "?2004" ? E_KEY_BRACKETED_PASTE_ON : 0;
+        case 'l':
+            return params == "?2004" ? E_KEY_BRACKETED_PASTE_OFF : 0;
+        case 'c':
+            if (params.empty() || params == "0") {
+                return E_KEY_DA1;
+            }
+            return params == ">" || params == ">0" ? E_KEY_DA2 : 0;
+        case 'n':
+            return (params == "5" || params == "6") && parse_number(params, args) ? E_KEY_DSR : 0;
+        case 'q':
+            return params == ">" || params == ">0" ? E_KEY_XTVERSION : 0;
+        default:
+            return 0;
+    }
+}
+
+// OSC strings, ended by BEL or ST. Only the shell integration marks mean anything, they are told
+// apart by their prefix; anything else (titles, hyperlinks) comes back as 0.
+static TerminalChar escape_osc(const std::string &seq) {
     TerminalChar ret;
     ret.ch = 0;
     ret.sequence = seq;
 
-    for (auto &[regex, key] : regexes) {
-        if (std::regex_match(seq, matches, regex)) {
-            ret.ch = key;
-            for (size_t i = 1; i < matches.size(); i++) {
-                int arg;
-
-                try {
-                    arg = std::stoi(matches[i].str());
-                } catch ([[maybe_unused]] const std::invalid_argument &e) {
-                    continue;
-                } catch ([[maybe_unused]] const std::out_of_range &e) {
-                    continue;
-                }
+    size_t end;
+    if (seq.size() >= 3 && seq.back() == 0x07) {
+        end = seq.size() - 1;
+    } else if (seq.size() >= 4 && seq.back() == '\\' && seq[seq.size() - 2] == 0x1B) {
+        end = seq.size() - 2;
+    } else {
+        return ret;
+    }
 
-                ret.args.push_back(arg);
-            }
+    const std::string_view body = std::string_view(seq).substr(2, end - 2);
+    if (body.size() < 5 || body.substr(0, 4) != "133;" || body.find_first_of("\x07\x1b") != std::string_view::npos) {
+        return ret;
+    }
+
+    switch (body[4]) {
+        case 'A':
+            ret.ch = E_KEY_MARK_PROMPT;
+            break;
+        case 'B':
+            ret.ch = E_KEY_MARK_COMMAND;
+            break;
+        case 'C':
+            ret.ch = E_KEY_MARK_OUTPUT;
+            break;
+        case 'D': {
+            ret.ch = E_KEY_MARK_DONE;
 
-            return ret;
+            // The exit status, if given, comes first
+            if (body.size() > 5 && body[5] == ';') {
+                const std::string_view rest = body.substr(6);
+                parse_number(rest.substr(0, std::min(rest.find_first_not_of("0123456789"), rest.size())), ret.args);
+            }
+            break;
         }
+        default:
+            break;
+    }
+
+    return ret;
+}
+
+TerminalChar escape(const std::string &seq) {
+    // Check `infocmp linux-m`
+
+    TerminalChar ret;
+    ret.ch = 0;
+    ret.sequence = seq;
+
+    if (seq.size() < 2 || seq[0] != 0x1B) {
+        return ret;
+    }
+
+    if (seq == "\x1bM") {
+        ret.ch = E_KEY_RI;
+        return ret;
+    }
+
+    if (seq[1] == ']') {
+        return escape_osc(seq);
+    }
+
+    // Parsed by hand, they make up most of what panes print
+    if (seq[1] == '[' && seq.size() >= 3) {
+        ret.ch = escape_csi(seq.back(), std::string_view(seq).substr(2, seq.size() - 3), ret.args);
     }
 
     return ret;
 }
 
 int read_and_escape(const int fd, std::vector<TerminalChar> &vec) {
+    char buf[READ_BUFSIZ];
+
+    const ssize_t n = read(fd, buf, READ_BUFSIZ);
+    if (n <= 0) {
+        return static_cast<int>(n);
+    }
+
+    escape_buffer(fd, buf, static_cast<int>(n), vec);
+
+    return static_cast<int>(n);
+}
+
+// Parses bytes read from fd, keeping unfinished escape sequences for the next call.
+// With stop_at_paste, stops right after a paste start so the payload can bypass parsing.
+// Returns the number of bytes consumed.
+int escape_buffer(const int fd, const char *buf, const int n, std::vector<TerminalChar> &vec, const bool stop_at_paste) {
     struct FdEscapeData {
         bool in_escape{};
+        bool in_osc{};
         std::string escape_seq;
     };
 
-    static std::unordered_map<int, FdEscapeData> fd_escape_data;
+    // Each fd is only ever parsed by one thread
+    static thread_local std::unordered_map<int, FdEscapeData> fd_escape_data;
 
     if (fd_escape_data.find(fd) == fd_escape_data.end()) {
         fd_escape_data[fd].in_escape = false;
         fd_escape_data[fd].escape_seq = "";
     }
 
-    char buf[READ_BUFSIZ];
+    vec = std::vector<TerminalChar>();
 
-    const ssize_t n = read(fd, buf, READ_BUFSIZ);
-    if (n <= 0) {
-        return static_cast<int>(n);
-    }
+    for (int i = 0; i < n; i++) {
+        // OSC strings run until BEL or ST (ESC \), and may contain anything else
+        if (fd_escape_data[fd].in_osc) {
+            std::string &seq = fd_escape_data[fd].escape_seq;
+            const bool st = buf[i] == '\\' && seq.back() == 0x1B;
 
-    vec = std::vector<TerminalChar>();
+            // Past the limit only what may end the string is kept. No 8-bit ST, it would cut UTF-8 titles.
+            if (seq.size() < OSC_MAX_LEN || buf[i] == 0x1B || st || buf[i] == 0x07) {
+                seq += buf[i];
+            }
+
+            if (buf[i] == 0x07 || st) {
+                vec.push_back(escape_osc(seq));
+                fd_escape_data[fd].in_osc = false;
+                fd_escape_data[fd].in_escape = false;
+                seq = "";
+            }
+
+            continue;
+        }
 
-    for (ssize_t i = 0; i < n; i++) {
         // ESC sequence
         if (buf[i] == 0x1B) {
             fd_escape_data[fd].in_escape = true;
@@ -85,6 +231,13 @@ int read_and_escape(const int fd, std::vector<TerminalChar> &vec) {
         }
 
         if (fd_escape_data[fd].in_escape) {
+            // Keys never carry OSC strings, Alt+] typed on stdin stays a key
+            if (buf[i] == ']' && fd_escape_data[fd].escape_seq == "\x1B" && fd != STDIN_FILENO) {
+                fd_escape_data[fd].in_osc = true;
+                fd_escape_data[fd].escape_seq += buf[i];
+                continue;
+            }
+
             if (buf[i] != 0x9c) {
                 fd_escape_data[fd].escape_seq += buf[i];
             }
@@ -93,6 +246,10 @@ int read_and_escape(const int fd, std::vector<TerminalChar> &vec) {
                 vec.push_back(escape(fd_escape_data[fd].escape_seq));
                 fd_escape_data[fd].in_escape = false;
                 fd_escape_data[fd].escape_seq = "";
+
+                if (stop_at_paste && vec.back().ch == E_KEY_PASTE_BEGIN) {
+                    return i + 1;
+                }
             }
         } else {
             TerminalChar tch;
@@ -102,5 +259,45 @@ int read_and_escape(const int fd, std::vector<TerminalChar> &vec) {
         }
     }
 
-    return static_cast<int>(n);
-}
\ No newline at end of file
+    return n;
+}
+
+// Collects paste payload until the end marker. The marker itself is not part of the payload.
+// Returns the number of bytes consumed; state.active is cleared once the marker is consumed.
+int scan_paste(PasteState &state, const char *buf, const int n, std::string &payload) {
+    static const std::string marker = PASTE_END_MARKER;
+
+    int i = 0;
+
+    while (i < n) {
+        if (state.matched == 0) {
+            // Everything up to the next ESC is payload
+            const void *esc = memchr(buf + i, 0x1B, n - i);
+            const int end = esc == nullptr ? n : static_cast<int>(static_cast<const char *>(esc) - buf);
+
+            payload.append(buf + i, end - i);
+            i = end;
+
+            if (i == n) {
+                break;
+            }
+        }
+
+        if (buf[i] == marker[state.matched]) {
+            state.matched++;
+            i++;
+
+            if (state.matched == marker.size()) {
+                state.active = false;
+                state.matched = 0;
+                return i;
+            }
+        } else {
+            // Not the end marker after all, the partial match was payload
+            payload.append(marker, 0, state.matched);
+            state.matched = 0;
+        }
+    }
+
+    return n;
+}
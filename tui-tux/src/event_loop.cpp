@@ -0,0 +1,200 @@
+#include <sys/epoll.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <event_loop.hpp>
+#include <utils.hpp>
+
+EpollEventLoop::EpollEventLoop() {
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+}
+
+EpollEventLoop::~EpollEventLoop() {
+    close(epoll_fd);
+}
+
+void EpollEventLoop::add(const int fd, const uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("epoll_ctl: add");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void EpollEventLoop::modify(const int fd, const uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1) {
+        perror("epoll_ctl: mod");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void EpollEventLoop::remove(const int fd) {
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+        perror("epoll_ctl: del");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int EpollEventLoop::wait(LoopEvent *events, const int max_events, const int timeout_ms) {
+    epoll_event epoll_events[MAX_EVENTS];
+
+    const int n = epoll_wait(epoll_fd, epoll_events, std::min(max_events, MAX_EVENTS), timeout_ms);
+    if (n < 0) {
+        return -errno;
+    }
+
+    for (int i = 0; i < n; i++) {
+        events[i].fd = epoll_events[i].data.fd;
+        events[i].events = epoll_events[i].events;
+    }
+
+    return n;
+}
+
+LoopBackend EpollEventLoop::get_backend() const {
+    return LoopBackend::Epoll;
+}
+
+IoUringEventLoop::IoUringEventLoop() : ring(64) {}
+
+bool IoUringEventLoop::ok() const {
+    return ring.ok();
+}
+
+void IoUringEventLoop::add(const int fd, const uint32_t events) {
+    Watch &watch = watches[fd];
+    watch.events = events;
+    arm(fd, watch);
+}
+
+void IoUringEventLoop::modify(const int fd, const uint32_t events) {
+    Watch &watch = watches[fd];
+    cancel(watch);
+    watch.events = events;
+    arm(fd, watch);
+}
+
+void IoUringEventLoop::remove(const int fd) {
+    const auto it = watches.find(fd);
+    if (it != watches.end()) {
+        cancel(it->second);
+        watches.erase(it);
+    }
+}
+
+void IoUringEventLoop::arm(const int fd, Watch &watch) {
+    if (watch.events == 0 || watch.tag != 0) {
+        return;
+    }
+
+    // The generation tells completions of a cancelled poll apart from the current one
+    generation++;
+    watch.tag = static_cast<uint64_t>(generation) << 32 | static_cast<uint32_t>(fd);
+
+    io_uring_sqe *sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = watch.events;
+    sqe->user_data = watch.tag;
+}
+
+void IoUringEventLoop::cancel(Watch &watch) {
+    if (watch.tag == 0) {
+        return;
+    }
+
+    // Its completion, -ECANCELED, is ignored since the tag no longer matches
+    io_uring_sqe *sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->addr = watch.tag;
+    sqe->user_data = 0;
+
+    watch.tag = 0;
+}
+
+int IoUringEventLoop::wait(LoopEvent *events, const int max_events, const int timeout_ms) {
+    // Polls are one-shot, re-arming whatever fired last time keeps them level-triggered
+    for (auto &[fd, watch] : watches) {
+        arm(fd, watch);
+    }
+
+    int n = 0;
+    unsigned wait_nr = 0;
+
+    while (true) {
+        // A single syscall submits the polls and, when blocking, waits for one to complete
+        if (ring.pending() > 0 || wait_nr > 0) {
+            if (const int rc = ring.submit(wait_nr); rc < 0) {
+                return rc;
+            }
+        }
+
+        io_uring_cqe cqe{};
+        while (n < max_events && ring.peek(cqe)) {
+            const int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+            const auto it = watches.find(fd);
+
+            if (cqe.user_data == 0 || it == watches.end() || it->second.tag != cqe.user_data) {
+                // Poll removals and stale polls
+                continue;
+            }
+
+            Watch &watch = it->second;
+            watch.tag = 0;
+
+            events[n].fd = fd;
+            events[n].events = cqe.res < 0 ? POLLERR : cqe.res & (watch.events | POLLERR | POLLHUP);
+            n++;
+        }
+
+        if (n > 0 || timeout_ms == 0) {
+            return n;
+        }
+
+        wait_nr = 1;
+    }
+}
+
+LoopBackend IoUringEventLoop::get_backend() const {
+    return LoopBackend::IoUring;
+}
+
+LoopBackend loop_backend_from_env() {
+    const char *name = getenv("ISHELL_EVENT_LOOP");
+    if (name == nullptr || strcmp(name, "io_uring") != 0) {
+        return LoopBackend::Epoll;
+    }
+
+    // Pane readers need multishot reads, the main loop needs polls
+    const int opcodes[] = {IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_PROVIDE_BUFFERS, IO_RING_OP_READ_MULTISHOT};
+    if (!IoRing::supports(opcodes, sizeof(opcodes) / sizeof(opcodes[0]))) {
+        return LoopBackend::Epoll;
+    }
+
+    return LoopBackend::IoUring;
+}
+
+std::unique_ptr<EventLoop> make_event_loop(const LoopBackend backend) {
+    if (backend == LoopBackend::IoUring) {
+        auto loop = std::make_unique<IoUringEventLoop>();
+        if (loop->ok()) {
+            return loop;
+        }
+    }
+
+    return std::make_unique<EpollEventLoop>();
+}
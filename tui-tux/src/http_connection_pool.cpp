@@ -0,0 +1,133 @@
+#include <http_connection_pool.hpp>
+#include <utils.hpp>
+
+HttpConnectionPool::HttpConnectionPool() {
+    share = curl_share_init();
+    if (share == nullptr) {
+        return;
+    }
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+    if (prewarm_thread.joinable()) {
+        prewarm_thread.join();
+    }
+
+    // Handles go first, the share refuses to go while in use
+    for (CURL *curl : idle) {
+        curl_easy_cleanup(curl);
+    }
+
+    if (share != nullptr) {
+        curl_share_cleanup(share);
+    }
+}
+
+HttpConnectionPool &HttpConnectionPool::shared() {
+    static HttpConnectionPool pool;
+    return pool;
+}
+
+CURL *HttpConnectionPool::acquire() {
+    CURL *curl = nullptr;
+
+    {
+        std::lock_guard guard(idle_mutex);
+        if (!idle.empty()) {
+            curl = idle.back();
+            idle.pop_back();
+        }
+    }
+
+    if (curl != nullptr) {
+        // Options of the last request are gone, its connections and caches are not
+        curl_easy_reset(curl);
+    } else {
+        curl = curl_easy_init();
+        if (curl == nullptr) {
+            return nullptr;
+        }
+    }
+
+    configure(curl);
+    return curl;
+}
+
+void HttpConnectionPool::release(CURL *curl) {
+    if (curl == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard guard(idle_mutex);
+        if (idle.size() < HTTP_POOL_HANDLES) {
+            idle.push_back(curl);
+            return;
+        }
+    }
+
+    curl_easy_cleanup(curl);
+}
+
+size_t HttpConnectionPool::idle_handles() {
+    std::lock_guard guard(idle_mutex);
+    return idle.size();
+}
+
+void HttpConnectionPool::prewarm(const std::string &url) {
+    if (prewarming.exchange(true)) {
+        return;
+    }
+
+    // Done with, or it would still be prewarming
+    if (prewarm_thread.joinable()) {
+        prewarm_thread.join();
+    }
+
+    prewarm_thread = std::thread([this, url] {
+        if (CURL *curl = acquire(); curl != nullptr) {
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+            curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, HTTP_CONNECT_TIMEOUT_S * 1000L);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, HTTP_CONNECT_TIMEOUT_S * 1000L);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+            set_tls_options(curl);
+
+            // Whatever the answer, the connection is what counts
+            curl_easy_perform(curl);
+            release(curl);
+        }
+
+        prewarming = false;
+    });
+}
+
+void HttpConnectionPool::set_tls_options(CURL *curl) {
+    // disable SSL verification for simplicity (not recommended for production) !!!
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+}
+
+void HttpConnectionPool::configure(CURL *curl) const {
+    if (share != nullptr) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    }
+
+    // Idle connections stay up between queries, HTTP/2 multiplexes where the server offers it
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+}
+
+void HttpConnectionPool::lock(CURL *, const curl_lock_data data, curl_lock_access, void *pool) {
+    static_cast<HttpConnectionPool *>(pool)->share_mutexes[data].lock();
+}
+
+void HttpConnectionPool::unlock(CURL *, const curl_lock_data data, void *pool) {
+    static_cast<HttpConnectionPool *>(pool)->share_mutexes[data].unlock();
+}
@@ -0,0 +1,194 @@
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include <http_multi.hpp>
+#include <utils.hpp>
+
+HttpMulti::HttpMulti(EventLoop *loop) : loop(loop) {
+    multi = curl_multi_init();
+    if (multi == nullptr) {
+        fprintf(stderr, "curl_multi_init failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        perror("timerfd_create");
+        exit(EXIT_FAILURE);
+    }
+    loop->add(timer_fd, EPOLLIN);
+
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, socket_callback);
+    curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, timer_callback);
+    curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+}
+
+HttpMulti::~HttpMulti() {
+    std::map<CURL *, std::function<void(CURLcode)>> aborted;
+    aborted.swap(transfers);
+
+    for (auto &[curl, on_done] : aborted) {
+        curl_multi_remove_handle(multi, curl);
+        on_done(CURLE_ABORTED_BY_CALLBACK);
+    }
+
+    for (const auto &[fd, events] : sockets) {
+        loop->remove(fd);
+    }
+    sockets.clear();
+
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, nullptr);
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, nullptr);
+    curl_multi_cleanup(multi);
+
+    loop->remove(timer_fd);
+    close(timer_fd);
+}
+
+void HttpMulti::add(CURL *curl, std::function<void(CURLcode)> on_done) {
+    if (curl_multi_add_handle(multi, curl) != CURLM_OK) {
+        on_done(CURLE_FAILED_INIT);
+        return;
+    }
+
+    // curl arms the timer from within add, the transfer starts on the next handle()
+    transfers[curl] = std::move(on_done);
+}
+
+bool HttpMulti::handle(const LoopEvent &event) {
+    if (event.fd == timer_fd) {
+        uint64_t expirations;
+        while (read(timer_fd, &expirations, sizeof(expirations)) > 0) {}
+
+        socket_action(CURL_SOCKET_TIMEOUT, 0);
+        return true;
+    }
+
+    if (sockets.find(event.fd) == sockets.end()) {
+        return false;
+    }
+
+    int ev_bitmask = 0;
+    if (event.events & EPOLLIN) {
+        ev_bitmask |= CURL_CSELECT_IN;
+    }
+    if (event.events & EPOLLOUT) {
+        ev_bitmask |= CURL_CSELECT_OUT;
+    }
+    if (event.events & (EPOLLERR | EPOLLHUP)) {
+        ev_bitmask |= CURL_CSELECT_ERR;
+    }
+
+    socket_action(event.fd, ev_bitmask);
+    return true;
+}
+
+void HttpMulti::run() {
+    LoopEvent events[MAX_EVENTS];
+
+    while (!transfers.empty()) {
+        const int n = loop->wait(events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (n == -EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            handle(events[i]);
+        }
+    }
+}
+
+size_t HttpMulti::in_flight() const {
+    return transfers.size();
+}
+
+void HttpMulti::socket_action(const curl_socket_t fd, const int ev_bitmask) {
+    int running;
+    curl_multi_socket_action(multi, fd, ev_bitmask, &running);
+    check_done();
+}
+
+void HttpMulti::check_done() {
+    CURLMsg *msg;
+    int pending;
+
+    while ((msg = curl_multi_info_read(multi, &pending)) != nullptr) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        // msg is gone once the handle is removed
+        CURL *curl = msg->easy_handle;
+        const CURLcode result = msg->data.result;
+
+        curl_multi_remove_handle(multi, curl);
+
+        const auto it = transfers.find(curl);
+        if (it == transfers.end()) {
+            continue;
+        }
+
+        const std::function<void(CURLcode)> on_done = std::move(it->second);
+        transfers.erase(it);
+        on_done(result);
+    }
+}
+
+int HttpMulti::socket_callback(CURL *, const curl_socket_t fd, const int what, void *multi, void *) {
+    auto *self = static_cast<HttpMulti *>(multi);
+    const auto it = self->sockets.find(fd);
+
+    if (what == CURL_POLL_REMOVE) {
+        if (it != self->sockets.end()) {
+            self->loop->remove(fd);
+            self->sockets.erase(it);
+        }
+        return 0;
+    }
+
+    uint32_t events = 0;
+    if (what & CURL_POLL_IN) {
+        events |= EPOLLIN;
+    }
+    if (what & CURL_POLL_OUT) {
+        events |= EPOLLOUT;
+    }
+
+    if (it == self->sockets.end()) {
+        self->loop->add(fd, events);
+        self->sockets[fd] = events;
+    } else if (it->second != events) {
+        self->loop->modify(fd, events);
+        it->second = events;
+    }
+
+    return 0;
+}
+
+int HttpMulti::timer_callback(CURLM *, const long timeout_ms, void *multi) {
+    const auto *self = static_cast<HttpMulti *>(multi);
+
+    // -1 disarms. 0 means as soon as possible, a zero it_value would disarm too.
+    itimerspec spec{};
+    if (timeout_ms == 0) {
+        spec.it_value.tv_nsec = 1;
+    } else if (timeout_ms > 0) {
+        spec.it_value.tv_sec = timeout_ms / 1000;
+        spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000 * 1000;
+    }
+
+    if (timerfd_settime(self->timer_fd, 0, &spec, nullptr) == -1) {
+        return -1;
+    }
+
+    return 0;
+}
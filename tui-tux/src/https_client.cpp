@@ -1,11 +1,17 @@
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <curl/curl.h>
 #include "../nlohmann/json.hpp"
 #include <sstream>
 #include <map>
+#include <memory>
+#include <utility>
 
 #include <https_client.hpp>
+#include <stream_parser.hpp>
+#include <trace.hpp>
+#include <utils.hpp>
 
 using json = nlohmann::json;
 
@@ -27,6 +33,78 @@ static size_t HeaderCallback(const char* buffer, const size_t size, const size_t
     return nitems * size;
 }
 
+// Response body that is parsed as it arrives if the server streams it
+struct StreamingBody {
+    CURL* curl;
+    std::string* buffer;
+    const std::function<void(const std::string&)>* on_delta;
+    bool checked = false;
+    std::unique_ptr<StreamParser> parser;
+};
+
+static size_t StreamingWriteCallback(void* contents, const size_t size, const size_t nmemb, StreamingBody* body) {
+    // Headers are all in by the first byte of the body
+    if (!body->checked) {
+        body->checked = true;
+
+        const char* content_type = nullptr;
+        StreamFormat format;
+        if (curl_easy_getinfo(body->curl, CURLINFO_CONTENT_TYPE, &content_type) == CURLE_OK && content_type != nullptr &&
+            StreamParser::detect(content_type, format)) {
+            body->parser = std::make_unique<StreamParser>(format, *body->on_delta);
+        }
+    }
+
+    if (body->parser != nullptr) {
+        body->parser->feed(static_cast<char *>(contents), size * nmemb);
+    } else {
+        body->buffer->append(static_cast<char *>(contents), size * nmemb);
+    }
+
+    return size * nmemb;
+}
+
+// Called by curl at least once a second while a transfer runs, non-zero aborts it
+static int ProgressCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    return static_cast<const std::atomic<bool> *>(clientp)->load() ? 1 : 0;
+}
+
+// Timeout from the environment in seconds, or the default
+static long TimeoutMs(const char* env, const long default_s) {
+    const char* value = std::getenv(env);
+    if (value == nullptr || *value == '\0') {
+        return default_s * 1000;
+    }
+
+    char* end = nullptr;
+    const double seconds = std::strtod(value, &end);
+    if (*end != '\0' || seconds < 0) {
+        return default_s * 1000;
+    }
+
+    return static_cast<long>(seconds * 1000);
+}
+
+void HttpsClient::set_cancel_flag(const std::atomic<bool> *flag) {
+    cancel_flag = flag;
+}
+
+void HttpsClient::set_pool(HttpConnectionPool *connection_pool) {
+    pool = connection_pool;
+}
+
+void HttpsClient::release_handle(CURL *curl) const {
+    if (pool != nullptr) {
+        pool->release(curl);
+    } else {
+        curl_easy_cleanup(curl);
+    }
+}
+
+void HttpsClient::set_stream_callback(std::function<void(const std::string &)> callback) {
+    stream_callback = std::move(callback);
+}
+
 // Function to convert query parameters to a URL-encoded string
 std::string HttpsClient::build_query_string(const std::map<std::string, std::string>& query_params) {
     std::stringstream ss;
@@ -79,7 +157,7 @@ void HttpsClient::add_request_body(CURL* curl, HttpRequestType request_type, con
 }
 
 // Function to add request headers
-void HttpsClient::add_request_headers(CURL* curl, const std::map<std::string, std::string>& headers) {
+curl_slist *HttpsClient::add_request_headers(CURL* curl, const std::map<std::string, std::string>& headers) {
     struct curl_slist* curl_headers = nullptr;
     for (const auto& header : headers) {
         std::string header_string = header.first + ": " + header.second;
@@ -88,6 +166,7 @@ void HttpsClient::add_request_headers(CURL* curl, const std::map<std::string, st
     if (curl_headers) {
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, curl_headers);
     }
+    return curl_headers;
 }
 
 // Function to set CURL options for handling the response
@@ -98,46 +177,90 @@ void HttpsClient::set_response_callbacks(CURL* curl, std::string& readBuffer, st
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
 }
 
-// Function to perform the CURL request and handle the response
-json HttpsClient::perform_request(CURL* curl) {
-    long response_code = 0;
-    std::string readBuffer;
-    std::map<std::string, std::string> response_headers;
+struct HttpsClient::RequestData {
+    std::string json_data;
+    curl_slist* header_list = nullptr;
 
-    set_response_callbacks(curl, readBuffer, response_headers);
+    ~RequestData() {
+        curl_slist_free_all(header_list);
+    }
+};
 
-    const CURLcode res = curl_easy_perform(curl);
+struct HttpsClient::ResponseData {
+    std::string read_buffer;
+    std::map<std::string, std::string> headers;
+    StreamingBody streaming{};
+};
+
+struct HttpsClient::AsyncTransfer {
+    RequestData request;
+    ResponseData response;
+};
+
+void HttpsClient::prepare_response(CURL* curl, ResponseData& response) {
+    set_response_callbacks(curl, response.read_buffer, response.headers);
+
+    // Streamed answers go through the parser as they arrive, anything else is buffered as before
+    response.streaming = {curl, &response.read_buffer, &stream_callback};
+    if (stream_callback) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamingWriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response.streaming);
+    }
+}
+
+json HttpsClient::finish_response(CURL* curl, const CURLcode res, ResponseData& response_data) {
+    long response_code = 0;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
 
     json response = {
         {"status_code", response_code},
-        {"headers", response_headers},
+        {"headers", response_data.headers},
         {"body", nullptr}
     };  
 
+    const std::unique_ptr<StreamParser>& parser = response_data.streaming.parser;
+
     if (res != CURLE_OK) {
         response["error"] = curl_easy_strerror(res);
+    } else if (parser != nullptr) {
+        parser->finish();
+
+        if (!parser->get_error().empty()) {
+            response["body"] = {{"error", parser->get_error()}};
+        } else {
+            response["body"] = {{"content", parser->get_text()}};
+        }
     } else {
         try {
-            response["body"] = json::parse(readBuffer);
+            response["body"] = json::parse(response_data.read_buffer);
         } catch (json::parse_error&) {
-            response["body"] = readBuffer; // if response is not JSON, return raw string
+            response["body"] = response_data.read_buffer; // if response is not JSON, return raw string
         }
     }
 
-    curl_easy_cleanup(curl);
+    // Its connection stays open for the next request
+    release_handle(curl);
     return response;
 }
 
-// Function to make an HTTP request
-json HttpsClient::make_http_request(const HttpRequestType request_type, const std::string& url,
-                                    const std::map<std::string, std::string>& query_params = {},
-                                    const json& body = nullptr,
-                                    const std::map<std::string, std::string>& headers = {}) {
+// Function to perform the CURL request and handle the response
+json HttpsClient::perform_request(CURL* curl) {
+    TRACE_SPAN("http_request");
+
+    ResponseData response;
+    prepare_response(curl, response);
+
+    const CURLcode res = curl_easy_perform(curl);
+    return finish_response(curl, res, response);
+}
 
+CURL *HttpsClient::prepare_request(RequestData& request, const HttpRequestType request_type, const std::string& url,
+                                   const std::map<std::string, std::string>& query_params,
+                                   const json& body,
+                                   const std::map<std::string, std::string>& headers) {
     CURL* curl = curl_easy_init();
     if (!curl) {
-        return json({{"error", "Failed to initialize CURL"}});
+        return nullptr;
     }
 
     std::string final_url = url;
@@ -146,23 +269,84 @@ json HttpsClient::make_http_request(const HttpRequestType request_type, const st
     }
     curl_easy_setopt(curl, CURLOPT_URL, final_url.c_str());
 
-    std::string jsonData;
-
     set_request_type(curl, request_type);
-    add_request_body(curl, request_type, body, jsonData);
-    add_request_headers(curl, headers);
+    add_request_body(curl, request_type, body, request.json_data);
+    request.header_list = add_request_headers(curl, headers);
 
-    // disable SSL verification for simplicity (not recommended for production) !!!
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    HttpConnectionPool::set_tls_options(curl);
+
+    // A hung server must not hang the agent. 0 waits forever.
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, TimeoutMs("ISHELL_CONNECT_TIMEOUT", HTTP_CONNECT_TIMEOUT_S));
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, TimeoutMs("ISHELL_TIMEOUT", HTTP_TIMEOUT_S));
+
+    // Timeouts must not use signals, requests run off the main thread
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    if (cancel_flag != nullptr) {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, const_cast<std::atomic<bool> *>(cancel_flag));
+    }
+
+    return curl;
+}
+
+// Function to make an HTTP request
+json HttpsClient::make_http_request(const HttpRequestType request_type, const std::string& url,
+                                    const std::map<std::string, std::string>& query_params = {},
+                                    const json& body = nullptr,
+                                    const std::map<std::string, std::string>& headers = {}) {
+
+    RequestData request;
+    CURL* curl = prepare_request(request, request_type, url, query_params, body, headers);
+    if (!curl) {
+        return json({{"error", "Failed to initialize CURL"}});
+    }
 
     return perform_request(curl);
 }
 
+void HttpsClient::make_http_request_async(HttpMulti& multi, const HttpRequestType request_type, const std::string& url,
+                                          const std::map<std::string, std::string>& query_params,
+                                          const json& body,
+                                          const std::map<std::string, std::string>& headers,
+                                          std::function<void(json)> on_done) {
+    auto transfer = std::make_shared<AsyncTransfer>();
+
+    CURL* curl = prepare_request(transfer->request, request_type, url, query_params, body, headers);
+    if (!curl) {
+        on_done(json({{"error", "Failed to initialize CURL"}}));
+        return;
+    }
+
+    prepare_response(curl, transfer->response);
+
+    curl_multi_add_handle(multi, curl, [this, curl, transfer, on_done = std::move(on_done)](const CURLcode res) {
+        on_done(finish_response(curl, res, transfer->response));
+    });
+}
+
+std::future<json> HttpsClient::make_http_request_async(HttpMulti& multi, const HttpRequestType request_type, const std::string& url,
+                                                       const std::map<std::string, std::string>& query_params,
+                                                       const json& body,
+                                                       const std::map<std::string, std::string>& headers) {
+    auto promise = std::make_shared<std::promise<json>>();
+    std::future<json> future = promise->get_future();
+
+    make_http_request_async(multi, request_type, url, query_params, body, headers, [promise](json response) {
+        promise->set_value(std::move(response));
+    });
+
+    return future;
+}
+
 CURL *HttpsClient::curl_easy_init() {
-    return ::curl_easy_init();
+    return pool != nullptr ? pool->acquire() : ::curl_easy_init();
 }
 
 CURLcode HttpsClient::curl_easy_perform(CURL *curl) {
     return ::curl_easy_perform(curl);
-}
\ No newline at end of file
+}
+void HttpsClient::curl_multi_add_handle(HttpMulti &multi, CURL *curl, std::function<void(CURLcode)> on_done) {
+    multi.add(curl, std::move(on_done));
+}
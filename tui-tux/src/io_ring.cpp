@@ -0,0 +1,161 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <io_ring.hpp>
+
+static int io_uring_setup(const unsigned entries, io_uring_params *params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(const int fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int io_uring_register(const int fd, const unsigned opcode, void *arg, const unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+IoRing::IoRing(const unsigned entries) {
+    io_uring_params params{};
+    ring_fd = io_uring_setup(entries, &params);
+    if (ring_fd < 0) {
+        ring_fd = -1;
+        return;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    void *sqes_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes_map == MAP_FAILED) {
+        sq_ring = sq_ring == MAP_FAILED ? nullptr : sq_ring;
+        cq_ring = cq_ring == MAP_FAILED ? nullptr : cq_ring;
+        sqes = sqes_map == MAP_FAILED ? nullptr : static_cast<io_uring_sqe *>(sqes_map);
+        unmap();
+
+        close(ring_fd);
+        ring_fd = -1;
+        return;
+    }
+
+    sqes = static_cast<io_uring_sqe *>(sqes_map);
+
+    auto *sq = static_cast<char *>(sq_ring);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    auto *cq = static_cast<char *>(cq_ring);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+IoRing::~IoRing() {
+    unmap();
+
+    if (ring_fd >= 0) {
+        // Closing the ring cancels whatever is still in flight
+        close(ring_fd);
+    }
+}
+
+void IoRing::unmap() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+        sqes = nullptr;
+    }
+
+    if (cq_ring != nullptr) {
+        munmap(cq_ring, cq_ring_size);
+        cq_ring = nullptr;
+    }
+
+    if (sq_ring != nullptr) {
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = nullptr;
+    }
+}
+
+bool IoRing::ok() const {
+    return ring_fd >= 0;
+}
+
+io_uring_sqe *IoRing::get_sqe() {
+    // Only this thread moves the tail, the kernel moves the head once it consumed entries
+    if (to_submit > *sq_mask) {
+        submit();
+    }
+
+    const unsigned tail = *sq_tail;
+    const unsigned index = tail & *sq_mask;
+
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    to_submit++;
+
+    return sqe;
+}
+
+int IoRing::submit(const unsigned wait_nr) {
+    const unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    const int rc = io_uring_enter(ring_fd, to_submit, wait_nr, flags);
+    if (rc < 0) {
+        return -errno;
+    }
+
+    to_submit -= static_cast<unsigned>(rc) < to_submit ? static_cast<unsigned>(rc) : to_submit;
+    return rc;
+}
+
+unsigned IoRing::pending() const {
+    return to_submit;
+}
+
+bool IoRing::peek(io_uring_cqe &cqe) {
+    const unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    cqe = cqes[head & *cq_mask];
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool IoRing::supports(const int *opcodes, const size_t n) {
+    const IoRing ring(2);
+    if (!ring.ok()) {
+        return false;
+    }
+
+    constexpr unsigned n_ops = 256;
+    std::vector<char> buf(sizeof(io_uring_probe) + n_ops * sizeof(io_uring_probe_op), 0);
+    auto *probe = reinterpret_cast<io_uring_probe *>(buf.data());
+
+    if (io_uring_register(ring.ring_fd, IORING_REGISTER_PROBE, probe, n_ops) < 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (opcodes[i] > probe->last_op || !(probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,69 @@
+#include <unistd.h>
+#include <cerrno>
+
+#include <outbound_queue.hpp>
+
+OutboundQueue::OutboundQueue(const size_t capacity) : capacity(capacity) {
+}
+
+bool OutboundQueue::push(const char *data, const size_t len) {
+    if (size() + len > capacity) {
+        dropped += len;
+        return false;
+    }
+
+    buffer.append(data, len);
+    return true;
+}
+
+bool OutboundQueue::push(const std::string &data) {
+    return push(data.data(), data.size());
+}
+
+ssize_t OutboundQueue::flush(const int fd) {
+    while (head < buffer.size()) {
+        const ssize_t n = write(fd, buffer.data() + head, buffer.size() - head);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Kernel buffer is full, keep the rest
+                break;
+            }
+
+            return -1;
+        }
+
+        head += n;
+    }
+
+    if (head == buffer.size()) {
+        buffer.clear();
+        head = 0;
+    } else if (head > buffer.size() / 2) {
+        // Drop the written part once it dominates the buffer
+        buffer.erase(0, head);
+        head = 0;
+    }
+
+    return static_cast<ssize_t>(size());
+}
+
+bool OutboundQueue::empty() const {
+    return size() == 0;
+}
+
+size_t OutboundQueue::size() const {
+    return buffer.size() - head;
+}
+
+size_t OutboundQueue::get_capacity() const {
+    return capacity;
+}
+
+size_t OutboundQueue::get_dropped() const {
+    return dropped;
+}
@@ -0,0 +1,299 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <package_database.hpp>
+#include <utils.hpp>
+
+// Value of a "Key: value" line if it has the key, or null
+static const char *field_value(const char *line, const char *end, const char *key, const size_t key_len) {
+    if (static_cast<size_t>(end - line) < key_len || memcmp(line, key, key_len) != 0) {
+        return nullptr;
+    }
+
+    const char *value = line + key_len;
+    while (value < end && (*value == ' ' || *value == '\t')) {
+        value++;
+    }
+    return value;
+}
+
+// Calls on_line for each line without its newline. memchr does the scanning, glibc vectorises it.
+template <typename OnLine>
+static void scan_lines(const char *data, const size_t size, OnLine on_line) {
+    const char *end = data + size;
+
+    while (data < end) {
+        const void *newline = memchr(data, '\n', end - data);
+        const char *line_end = newline != nullptr ? static_cast<const char *>(newline) : end;
+
+        on_line(data, line_end);
+        data = line_end + 1;
+    }
+}
+
+static bool file_exists(const std::string &path) {
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0;
+}
+
+PackageFormat detect_package_format(const std::string &root) {
+    for (const PackageFormat format : {PackageFormat::Dpkg, PackageFormat::Apk, PackageFormat::Rpm}) {
+        if (const std::string path = package_database_path(format, root); !path.empty() && file_exists(path)) {
+            return format;
+        }
+    }
+
+    return PackageFormat::None;
+}
+
+std::string package_database_path(const PackageFormat format, const std::string &root) {
+    switch (format) {
+        case PackageFormat::Dpkg:
+            return root + DPKG_STATUS_PATH;
+        case PackageFormat::Apk:
+            return root + APK_INSTALLED_PATH;
+        case PackageFormat::Rpm:
+            // SQLite since rpm 4.16, NDB on SUSE, Berkeley DB before
+            for (const char *name : {"/rpmdb.sqlite", "/Packages.db", "/Packages"}) {
+                if (std::string path = root + RPM_DB_DIR + name; file_exists(path)) {
+                    return path;
+                }
+            }
+            return root + RPM_DB_DIR "/rpmdb.sqlite";
+        default:
+            return "";
+    }
+}
+
+void parse_dpkg_status(const char *data, const size_t size, std::vector<PackageRecord> &records) {
+    PackageRecord record;
+
+    scan_lines(data, size, [&](const char *line, const char *end) {
+        // A blank line ends the stanza
+        if (line == end) {
+            if (!record.name.empty()) {
+                records.push_back(std::move(record));
+            }
+            record = PackageRecord();
+            return;
+        }
+
+        const char *value;
+        switch (*line) {
+            case 'P':
+                if ((value = field_value(line, end, "Package:", 8)) != nullptr) {
+                    record.name.assign(value, end - value);
+                }
+                break;
+            case 'V':
+                if ((value = field_value(line, end, "Version:", 8)) != nullptr) {
+                    record.version.assign(value, end - value);
+                }
+                break;
+            case 'S':
+                if ((value = field_value(line, end, "Status:", 7)) != nullptr) {
+                    record.status.assign(value, end - value);
+                }
+                break;
+            default:
+                // Other fields and continuation lines
+                break;
+        }
+    });
+
+    if (!record.name.empty()) {
+        records.push_back(std::move(record));
+    }
+}
+
+void parse_apk_installed(const char *data, const size_t size, std::vector<PackageRecord> &records) {
+    PackageRecord record;
+
+    scan_lines(data, size, [&](const char *line, const char *end) {
+        if (line == end) {
+            if (!record.name.empty()) {
+                records.push_back(std::move(record));
+            }
+            record = PackageRecord();
+            return;
+        }
+
+        // Single letter keys, "P:name"
+        if (end - line < 2 || line[1] != ':') {
+            return;
+        }
+
+        if (line[0] == 'P') {
+            record.name.assign(line + 2, end - line - 2);
+            record.status = "installed";
+        } else if (line[0] == 'V') {
+            record.version.assign(line + 2, end - line - 2);
+        }
+    });
+
+    if (!record.name.empty()) {
+        records.push_back(std::move(record));
+    }
+}
+
+void parse_rpm_query(const char *data, const size_t size, std::vector<PackageRecord> &records) {
+    scan_lines(data, size, [&](const char *line, const char *end) {
+        const void *tab = memchr(line, '\t', end - line);
+        if (tab == nullptr || tab == line) {
+            return;
+        }
+
+        const char *version = static_cast<const char *>(tab) + 1;
+        records.push_back({std::string(line, version - 1), std::string(version, end), "installed"});
+    });
+}
+
+// Calls scan with the file's contents, mapped. False if there are none.
+template <typename Scan>
+static bool scan_mapped(const std::string &path, Scan scan) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    scan(static_cast<const char *>(data), static_cast<size_t>(st.st_size));
+
+    munmap(data, st.st_size);
+    return true;
+}
+
+static std::vector<PackageRecord> read_mapped(const std::string &path, void (*parse)(const char *, size_t, std::vector<PackageRecord> &)) {
+    std::vector<PackageRecord> records;
+    scan_mapped(path, [&](const char *data, const size_t size) { parse(data, size, records); });
+    return records;
+}
+
+static std::vector<PackageRecord> read_rpm() {
+    std::vector<PackageRecord> records;
+
+    FILE *pipe = popen("rpm -qa --qf '%{NAME}\\t%{VERSION}-%{RELEASE}\\n' 2>/dev/null", "r");
+    if (pipe == nullptr) {
+        return records;
+    }
+
+    std::string output;
+    char buffer[PACKAGE_READ_BUFSIZ];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.append(buffer, n);
+    }
+    pclose(pipe);
+
+    parse_rpm_query(output.data(), output.size(), records);
+    return records;
+}
+
+std::vector<PackageRecord> read_package_database(const PackageFormat format, const std::string &path) {
+    switch (format) {
+        case PackageFormat::Dpkg:
+            return read_mapped(path, parse_dpkg_status);
+        case PackageFormat::Apk:
+            return read_mapped(path, parse_apk_installed);
+        case PackageFormat::Rpm:
+            return read_rpm();
+        default:
+            return {};
+    }
+}
+
+// dpkg keeps a list per package in info/ next to its status file, "<package>[:<arch>].list"
+static void read_dpkg_files(const std::string &path, const std::function<void(const std::string &, std::string)> &on_file) {
+    const std::string info_dir = path.substr(0, path.rfind('/')) + "/info";
+
+    DIR *dir = opendir(info_dir.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+
+    while (const dirent *entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name.size() <= 5 || name.compare(name.size() - 5, 5, ".list") != 0) {
+            continue;
+        }
+
+        const std::string package = name.substr(0, std::min(name.size() - 5, name.find(':')));
+
+        scan_mapped(info_dir + "/" + name, [&](const char *data, const size_t size) {
+            scan_lines(data, size, [&](const char *line, const char *end) {
+                // "/." stands for the root
+                if (end - line > 1 && !(end - line == 2 && line[1] == '.')) {
+                    on_file(package, std::string(line, end));
+                }
+            });
+        });
+    }
+
+    closedir(dir);
+}
+
+// apk lists each package's files in its entry, "F:" a directory and "R:" a file in it
+static void read_apk_files(const std::string &path, const std::function<void(const std::string &, std::string)> &on_file) {
+    std::string package;
+    std::string directory;
+
+    scan_mapped(path, [&](const char *data, const size_t size) {
+        scan_lines(data, size, [&](const char *line, const char *end) {
+            if (end - line < 2 || line[1] != ':') {
+                return;
+            }
+
+            if (line[0] == 'P') {
+                package.assign(line + 2, end - line - 2);
+                directory.clear();
+            } else if (line[0] == 'F') {
+                directory.assign(line + 2, end - line - 2);
+            } else if (line[0] == 'R' && !package.empty()) {
+                std::string file = "/";
+                if (!directory.empty()) {
+                    file += directory + "/";
+                }
+                file.append(line + 2, end - line - 2);
+                on_file(package, std::move(file));
+            }
+        });
+    });
+}
+
+void read_package_files(const PackageFormat format, const std::string &path, const std::function<void(const std::string &, std::string)> &on_file) {
+    switch (format) {
+        case PackageFormat::Dpkg:
+            read_dpkg_files(path, on_file);
+            break;
+        case PackageFormat::Apk:
+            read_apk_files(path, on_file);
+            break;
+        default:
+            break;
+    }
+}
+
+bool is_installed(const PackageRecord &record) {
+    // "install ok installed", "hold ok installed", but not "deinstall ok config-files"
+    const std::string &status = record.status;
+    const size_t last_space = status.rfind(' ');
+    return status.compare(last_space == std::string::npos ? 0 : last_space + 1, std::string::npos, "installed") == 0;
+}
@@ -0,0 +1,36 @@
+#include <utility>
+
+#include <package_index.hpp>
+
+PackageIndex::PackageIndex(std::vector<PackageRecord> records, const PackageFormat format, std::string database_path)
+    : records(std::move(records)), format(format), database_path(std::move(database_path)) {
+    by_name.reserve(this->records.size());
+    for (size_t i = 0; i < this->records.size(); i++) {
+        by_name.emplace(this->records[i].name, i);
+    }
+}
+
+const PackageRecord *PackageIndex::find(const std::string &name) const {
+    const auto it = by_name.find(name);
+    return it != by_name.end() ? &records[it->second] : nullptr;
+}
+
+const PackageRecord *PackageIndex::owner_of(const std::string &path) const {
+    std::call_once(files_read, &PackageIndex::read_files, this);
+
+    const auto it = by_file.find(path);
+    return it != by_file.end() ? &records[it->second] : nullptr;
+}
+
+const std::vector<PackageRecord> &PackageIndex::get_records() const {
+    return records;
+}
+
+void PackageIndex::read_files() const {
+    read_package_files(format, database_path, [this](const std::string &package, std::string file) {
+        // Lists of packages no longer installed are skipped. Directories are shared, the first owner stays.
+        if (const auto it = by_name.find(package); it != by_name.end()) {
+            by_file.emplace(std::move(file), it->second);
+        }
+    });
+}
@@ -0,0 +1,102 @@
+#include <sys/stat.h>
+#include <algorithm>
+#include <utility>
+
+#include <package_inventory.hpp>
+#include <utils.hpp>
+
+bool PackageInventory::Stamp::operator==(const Stamp &other) const {
+    return dev == other.dev && ino == other.ino && size == other.size && mtime_ns == other.mtime_ns;
+}
+
+PackageInventory::PackageInventory(const PackageFormat format, std::string database_path)
+    : format(format), database_path(std::move(database_path)) {}
+
+PackageInventory::~PackageInventory() {
+    if (loader.joinable()) {
+        loader.join();
+    }
+}
+
+PackageInventory &PackageInventory::shared() {
+    static const PackageFormat format = detect_package_format();
+    static PackageInventory inventory(format, package_database_path(format));
+    return inventory;
+}
+
+void PackageInventory::load_in_background() {
+    const Stamp current = stamp();
+
+    std::lock_guard guard(mutex);
+    if (loading || (packages != nullptr && packages_stamp == current)) {
+        return;
+    }
+    loading = true;
+
+    // Done with, or it would still be loading
+    if (loader.joinable()) {
+        loader.join();
+    }
+
+    loader = std::thread(&PackageInventory::load, this, current);
+}
+
+std::shared_ptr<const PackageIndex> PackageInventory::get() {
+    const Stamp current = stamp();
+
+    std::unique_lock lock(mutex);
+    loaded.wait(lock, [this] { return !loading; });
+
+    if (packages != nullptr && packages_stamp == current) {
+        return packages;
+    }
+
+    // Changed since, read it again on this thread, the caller needs it now
+    loading = true;
+    lock.unlock();
+    load(current);
+    lock.lock();
+
+    return packages;
+}
+
+std::vector<PackageRecord> PackageInventory::read_packages() {
+    std::vector<PackageRecord> records = read_package_database(format, database_path);
+    records.erase(std::remove_if(records.begin(), records.end(), [](const PackageRecord &record) { return !is_installed(record); }),
+                  records.end());
+    return records;
+}
+
+PackageInventory::Stamp PackageInventory::stamp() const {
+    Stamp current;
+
+    struct stat st{};
+    if (stat(database_path.c_str(), &st) == 0) {
+        current.dev = st.st_dev;
+        current.ino = st.st_ino;
+        current.size = st.st_size;
+        current.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000 * 1000 * 1000 + st.st_mtim.tv_nsec;
+    }
+
+    return current;
+}
+
+void PackageInventory::load(const Stamp &current) {
+    std::vector<PackageRecord> records = read_packages();
+    std::sort(records.begin(), records.end(), [](const PackageRecord &a, const PackageRecord &b) { return a.name < b.name; });
+
+    // Multi-arch packages are listed once per architecture
+    records.erase(std::unique(records.begin(), records.end(), [](const PackageRecord &a, const PackageRecord &b) { return a.name == b.name; }),
+                  records.end());
+
+    auto index = std::make_shared<const PackageIndex>(std::move(records), format, database_path);
+
+    {
+        std::lock_guard guard(mutex);
+        packages = std::move(index);
+        packages_stamp = current;
+        loading = false;
+    }
+
+    loaded.notify_all();
+}
@@ -0,0 +1,269 @@
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include <pane_reader.hpp>
+#include <io_ring.hpp>
+#include <trace.hpp>
+#include <utils.hpp>
+
+PaneReader::PaneReader(const int fd, const LoopBackend backend, PaneStats *stats)
+    : fd(fd), backend(backend), stats(stats), queue(PANE_QUEUE_CHUNKS) {
+    notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (notify_fd < 0 || stop_fd < 0 || space_fd < 0) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+}
+
+PaneReader::~PaneReader() {
+    stop();
+
+    close(notify_fd);
+    close(stop_fd);
+    close(space_fd);
+}
+
+void PaneReader::set_recorder(Recorder *new_recorder, const uint8_t new_stream) {
+    recorder = new_recorder;
+    stream = new_stream;
+}
+
+void PaneReader::start() {
+    if (!thread.joinable()) {
+        thread = std::thread(&PaneReader::run, this);
+    }
+}
+
+void PaneReader::stop() {
+    if (thread.joinable()) {
+        constexpr uint64_t one = 1;
+        write(stop_fd, &one, sizeof(one));
+        thread.join();
+    }
+}
+
+int PaneReader::get_notify_fd() const {
+    return notify_fd;
+}
+
+int PaneReader::get_fd() const {
+    return fd;
+}
+
+void PaneReader::clear_notification() const {
+    uint64_t count;
+    read(notify_fd, &count, sizeof(count));
+}
+
+bool PaneReader::pop(PaneChunk &chunk) {
+    if (!queue.pop(chunk)) {
+        return false;
+    }
+
+    if (producer_waiting.load()) {
+        constexpr uint64_t one = 1;
+        write(space_fd, &one, sizeof(one));
+    }
+
+    return true;
+}
+
+bool PaneReader::empty() const {
+    return queue.empty();
+}
+
+void PaneReader::run() {
+    if (backend == LoopBackend::IoUring) {
+        run_ring();
+    } else {
+        run_poll();
+    }
+}
+
+void PaneReader::run_poll() {
+    char buf[PANE_READ_BUFSIZ];
+
+    while (true) {
+        pollfd fds[2] = {{fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            perror("poll: pane");
+            exit(EXIT_FAILURE);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+
+        const ssize_t n = read(fd, buf, sizeof(buf));
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        }
+
+        if (!publish_read(buf, static_cast<int>(n))) {
+            return;
+        }
+    }
+}
+
+#define RING_TAG_READ 1
+#define RING_TAG_STOP 2
+#define RING_TAG_BUFFERS 3
+
+void PaneReader::run_ring() {
+    IoRing ring(8);
+    if (!ring.ok()) {
+        run_poll();
+        return;
+    }
+
+    // The kernel picks a free buffer for each read, and hands it back in the completion
+    std::vector<char> buffers(PANE_RING_BUFFERS * PANE_READ_BUFSIZ);
+
+    auto provide = [&](const int bid, const int count) {
+        io_uring_sqe *sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = count;
+        sqe->addr = reinterpret_cast<uint64_t>(buffers.data() + bid * PANE_READ_BUFSIZ);
+        sqe->len = PANE_READ_BUFSIZ;
+        sqe->off = bid;
+        sqe->buf_group = 0;
+        sqe->user_data = RING_TAG_BUFFERS;
+    };
+
+    // One request keeps reading until it fails or runs out of buffers
+    auto arm_read = [&]() {
+        io_uring_sqe *sqe = ring.get_sqe();
+        sqe->opcode = IO_RING_OP_READ_MULTISHOT;
+        sqe->fd = fd;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        sqe->user_data = RING_TAG_READ;
+    };
+
+    provide(0, PANE_RING_BUFFERS);
+    arm_read();
+
+    io_uring_sqe *sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = stop_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = RING_TAG_STOP;
+
+    while (true) {
+        // Returned buffers and a re-armed read go in with the wait, no extra syscalls
+        if (const int rc = ring.submit(1); rc < 0) {
+            if (rc == -EINTR) {
+                continue;
+            }
+
+            errno = -rc;
+            perror("io_uring_enter: pane");
+            exit(EXIT_FAILURE);
+        }
+
+        io_uring_cqe cqe{};
+        while (ring.peek(cqe)) {
+            if (cqe.user_data == RING_TAG_STOP) {
+                return;
+            }
+
+            if (cqe.user_data != RING_TAG_READ) {
+                continue;
+            }
+
+            if (cqe.res == -ENOBUFS || cqe.res == -EAGAIN || cqe.res == -EINTR) {
+                // Buffers come back below, before the read is armed again
+            } else if (cqe.res <= 0) {
+                // PTY closed (EIO) or failed
+                publish_read(nullptr, -1);
+                return;
+            } else {
+                const int bid = static_cast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+                if (!publish_read(buffers.data() + bid * PANE_READ_BUFSIZ, cqe.res)) {
+                    return;
+                }
+
+                provide(bid, 1);
+            }
+
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                arm_read();
+            }
+        }
+    }
+}
+
+// Returns false once the reader should stop: the stream ended, or it was asked to stop
+bool PaneReader::publish_read(const char *buf, const int n) {
+    PaneChunk chunk;
+
+    if (n <= 0) {
+        // PTY set EIO (-1) for closure, publish the end of the stream
+        chunk.n_bytes = -1;
+        publish(chunk);
+        return false;
+    }
+
+    chunk.n_bytes = n;
+
+    if (recorder != nullptr) {
+        recorder->data(stream, buf, n);
+    }
+
+    const uint64_t start = stats != nullptr ? monotonic_ns() : 0;
+
+    {
+        TRACE_SPAN("parse");
+        escape_buffer(fd, buf, n, chunk.chars);
+    }
+
+    if (stats != nullptr) {
+        stat_add(stats->parse_ns, monotonic_ns() - start);
+        stat_add(stats->bytes, n);
+    }
+
+    return publish(chunk);
+}
+
+// Returns false if asked to stop while waiting for room
+bool PaneReader::publish(PaneChunk &chunk) {
+    while (!queue.push(chunk)) {
+        producer_waiting.store(true);
+
+        // Check again, the consumer may have made room before seeing the flag
+        if (queue.full()) {
+            pollfd fds[2] = {{space_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+            poll(fds, 2, -1);
+
+            uint64_t count;
+            read(space_fd, &count, sizeof(count));
+
+            if (fds[1].revents & POLLIN) {
+                producer_waiting.store(false);
+                return false;
+            }
+        }
+
+        producer_waiting.store(false);
+    }
+
+    constexpr uint64_t one = 1;
+    write(notify_fd, &one, sizeof(one));
+
+    return true;
+}
@@ -0,0 +1,90 @@
+#include <sys/mman.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <perf_stats.hpp>
+
+SharedPerfStats *shared_perf_stats = nullptr;
+
+void LatencyHistogram::record(const uint64_t ns) {
+    // Bucket i holds [2^i, 2^(i+1))
+    const int bucket = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+    buckets[bucket]++;
+    samples++;
+}
+
+uint64_t LatencyHistogram::percentile(const double fraction) const {
+    if (samples == 0) {
+        return 0;
+    }
+
+    // Rank of the sample, counting from 1
+    auto rank = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(samples)));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+
+    for (int i = 0; i < 64; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return i == 63 ? UINT64_MAX : 2ULL << i;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+uint64_t LatencyHistogram::count() const {
+    return samples;
+}
+
+void LatencyHistogram::reset() {
+    *this = LatencyHistogram();
+}
+
+void map_shared_perf_stats() {
+    if (shared_perf_stats != nullptr) {
+        return;
+    }
+
+    void *mem = mmap(nullptr, sizeof(SharedPerfStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap: perf stats");
+        exit(EXIT_FAILURE);
+    }
+
+    shared_perf_stats = new (mem) SharedPerfStats();
+}
+
+std::string format_ns(const uint64_t ns) {
+    char buf[32];
+
+    if (ns < 1000) {
+        snprintf(buf, sizeof(buf), "%luns", ns);
+    } else if (ns < 1000 * 1000) {
+        snprintf(buf, sizeof(buf), "%.1fus", ns / 1e3);
+    } else if (ns < 1000ULL * 1000 * 1000) {
+        snprintf(buf, sizeof(buf), "%.1fms", ns / 1e6);
+    } else {
+        snprintf(buf, sizeof(buf), "%.1fs", ns / 1e9);
+    }
+
+    return buf;
+}
+
+std::string format_rate(const double per_second, const char *unit) {
+    char buf[32];
+
+    if (per_second < 1000) {
+        snprintf(buf, sizeof(buf), "%.0f%s/s", per_second, unit);
+    } else if (per_second < 1000 * 1000) {
+        snprintf(buf, sizeof(buf), "%.1fK%s/s", per_second / 1e3, unit);
+    } else {
+        snprintf(buf, sizeof(buf), "%.1fM%s/s", per_second / 1e6, unit);
+    }
+
+    return buf;
+}
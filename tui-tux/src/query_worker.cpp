@@ -0,0 +1,90 @@
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include <query_worker.hpp>
+
+QueryWorker::QueryWorker(AgencyManager *manager) : manager(manager) {
+    done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (done_fd == -1) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+}
+
+QueryWorker::~QueryWorker() {
+    if (thread.joinable()) {
+        cancel();
+        thread.join();
+    }
+
+    close(done_fd);
+}
+
+void QueryWorker::start(const std::string &endpoint, const std::string &query) {
+    // Cleared before the thread starts, so a cancel right away is not lost
+    manager->request_wrapper->cancel_requested = false;
+    finished = false;
+
+    manager->request_wrapper->on_delta = [this](const std::string &delta) {
+        {
+            std::lock_guard lock(partial_mutex);
+            partial += delta;
+        }
+
+        notify();
+    };
+
+    thread = std::thread([this, endpoint, query] {
+        result = manager->execute_query(endpoint, query);
+
+        finished = true;
+        notify();
+    });
+}
+
+void QueryWorker::notify() const {
+    constexpr uint64_t one = 1;
+    write(done_fd, &one, sizeof(one));
+}
+
+bool QueryWorker::is_finished() const {
+    return finished;
+}
+
+bool QueryWorker::take_partial(std::string &text) {
+    uint64_t count;
+    read(done_fd, &count, sizeof(count));
+
+    std::lock_guard lock(partial_mutex);
+    text = std::move(partial);
+    partial.clear();
+
+    return !text.empty();
+}
+
+void QueryWorker::cancel() {
+    manager->request_wrapper->cancel_requested = true;
+}
+
+int QueryWorker::get_fd() const {
+    return done_fd;
+}
+
+bool QueryWorker::is_busy() const {
+    return thread.joinable();
+}
+
+bool QueryWorker::finish(std::string &query_result) {
+    thread.join();
+    manager->request_wrapper->on_delta = nullptr;
+
+    uint64_t count;
+    read(done_fd, &count, sizeof(count));
+    partial.clear();
+
+    query_result = std::move(result);
+    return !manager->request_wrapper->cancel_requested;
+}
@@ -0,0 +1,172 @@
+#include <unistd.h>
+#include <cstring>
+#include <ctime>
+
+#include <escape.hpp>
+#include <recorder.hpp>
+#include <utils.hpp>
+
+// Parser state is kept per fd, replayed panes use fds no pty ever gets
+#define REPLAY_FD_BASE (-1000)
+
+Recorder::~Recorder() {
+    close();
+}
+
+bool Recorder::open(const std::string &path) {
+    std::lock_guard lock(mutex);
+
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        perror("fopen: recording");
+        return false;
+    }
+
+    fwrite(RECORDING_MAGIC, 1, strlen(RECORDING_MAGIC), file);
+    start_ns = monotonic_ns();
+
+    return true;
+}
+
+void Recorder::close() {
+    std::lock_guard lock(mutex);
+
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void Recorder::data(const uint8_t stream, const char *buf, const size_t n) {
+    std::lock_guard lock(mutex);
+    write_entry(stream, RECORD_KIND_DATA, buf, n);
+}
+
+void Recorder::resize(const uint8_t stream, const int lines, const int cols) {
+    const uint16_t dims[2] = {static_cast<uint16_t>(lines), static_cast<uint16_t>(cols)};
+
+    std::lock_guard lock(mutex);
+    write_entry(stream, RECORD_KIND_RESIZE, reinterpret_cast<const char *>(dims), sizeof(dims));
+}
+
+// Caller holds the mutex
+void Recorder::write_entry(const uint8_t stream, const uint8_t kind, const char *buf, const size_t n) {
+    if (file == nullptr) {
+        return;
+    }
+
+    const uint64_t ns = monotonic_ns() - start_ns;
+    const auto length = static_cast<uint32_t>(n);
+
+    fwrite(&ns, sizeof(ns), 1, file);
+    fwrite(&stream, sizeof(stream), 1, file);
+    fwrite(&kind, sizeof(kind), 1, file);
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(buf, 1, n, file);
+}
+
+RecordReader::~RecordReader() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+bool RecordReader::open(const std::string &path) {
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char magic[sizeof(RECORDING_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+bool RecordReader::next(RecordEntry &entry) {
+    if (file == nullptr) {
+        return false;
+    }
+
+    uint32_t length;
+    if (fread(&entry.ns, sizeof(entry.ns), 1, file) != 1 ||
+        fread(&entry.stream, sizeof(entry.stream), 1, file) != 1 ||
+        fread(&entry.kind, sizeof(entry.kind), 1, file) != 1 ||
+        fread(&length, sizeof(length), 1, file) != 1) {
+        return false;
+    }
+
+    entry.data.resize(length);
+    return fread(entry.data.data(), 1, length, file) == length;
+}
+
+ReplayResult replay_recording(RecordReader &reader, std::vector<Screen> &screens, const bool realtime) {
+    ReplayResult result;
+    RecordEntry entry;
+    std::vector<TerminalChar> chars;
+
+    const uint64_t start = monotonic_ns();
+
+    while (reader.next(entry)) {
+        result.entries++;
+
+        if (entry.stream == RECORD_STREAM_STDIN) {
+            continue;
+        }
+
+        if (realtime) {
+            const uint64_t due = start + entry.ns;
+
+            if (const uint64_t now = monotonic_ns(); now < due) {
+                const timespec wait = {static_cast<time_t>((due - now) / 1000000000ULL),
+                                       static_cast<long>((due - now) % 1000000000ULL)};
+                nanosleep(&wait, nullptr);
+            } else if (now - due > result.max_lag_ns) {
+                result.max_lag_ns = now - due;
+            }
+        }
+
+        const size_t pane = entry.stream - 1;
+        const int fd = REPLAY_FD_BASE - static_cast<int>(pane);
+
+        if (entry.kind == RECORD_KIND_RESIZE && entry.data.size() == 2 * sizeof(uint16_t)) {
+            uint16_t dims[2];
+            memcpy(dims, entry.data.data(), sizeof(dims));
+
+            if (pane >= screens.size()) {
+                screens.resize(pane + 1);
+            }
+
+            if (screens[pane].get_pad() == nullptr) {
+                screens[pane] = Screen(dims[0], dims[1], fd, -1);
+            } else if (screens[pane].get_n_cols() != dims[1]) {
+                screens[pane] = Screen(dims[0], dims[1], screens[pane]);
+            } else {
+                screens[pane].set_viewport(dims[0]);
+            }
+
+            screens[pane].set_screen_coords(0, 0, dims[0] - 1, dims[1] - 1);
+        } else if (entry.kind == RECORD_KIND_DATA && pane < screens.size() && screens[pane].get_pad() != nullptr) {
+            // Same path as the pane readers take after read()
+            escape_buffer(fd, entry.data.data(), static_cast<int>(entry.data.size()), chars);
+
+            for (const TerminalChar &tch : chars) {
+                screens[pane].handle_char(tch);
+            }
+
+            // Answers to status queries already went to the recorded application
+            screens[pane].take_replies();
+
+            // A frame per read, like the multiplexer draws
+            screens[pane].refresh_screen();
+
+            result.bytes += entry.data.size();
+        }
+    }
+
+    return result;
+}
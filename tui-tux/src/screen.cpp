@@ -1,7 +1,11 @@
 #include <ncurses.h>
+#include <algorithm>
+#include <string>
+#include <utility>
 
 #include <screen.hpp>
 #include <utils.hpp>
+#include <trace.hpp>
 
 Screen::Screen() = default;
 
@@ -9,10 +13,59 @@ Screen::Screen(const int lines, const int cols, const int pty_master, const int
     init(lines, cols, pty_master, pid);
 }
 
-Screen::Screen(const int lines, const int cols, Screen &old_screen) {
+Screen::Screen(const int lines, const int cols, const Screen &old_screen) {
     init(lines, cols, old_screen);
 }
 
+Screen::~Screen() {
+    if (pad != nullptr) {
+        delwin(pad);
+    }
+}
+
+Screen::Screen(Screen &&other) noexcept {
+    *this = std::move(other);
+}
+
+Screen &Screen::operator=(Screen &&other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+
+    if (pad != nullptr) {
+        delwin(pad);
+    }
+
+    n_lines = other.n_lines;
+    n_cols = other.n_cols;
+    pty_master = other.pty_master;
+    pid = other.pid;
+    pushing_right = other.pushing_right;
+    cursor_wrapped = other.cursor_wrapped;
+    bracketed_paste = other.bracketed_paste;
+    generation = other.generation;
+    stats = other.stats;
+    replies = std::move(other.replies);
+    lines_dropped = other.lines_dropped;
+    command_marks = std::move(other.command_marks);
+    commands_done = other.commands_done;
+    pad_start = other.pad_start;
+    manual_scrolling_start = other.manual_scrolling_start;
+    pad_lines = other.pad_lines;
+    sminx = other.sminx;
+    sminy = other.sminy;
+    smaxx = other.smaxx;
+    smaxy = other.smaxy;
+    user_placed = std::move(other.user_placed);
+    line_info = std::move(other.line_info);
+
+    // The pad has exactly one owner
+    pad = other.pad;
+    other.pad = nullptr;
+
+    return *this;
+}
+
 int Screen::get_n_lines() const {
     return n_lines;
 }
@@ -22,6 +75,12 @@ int Screen::get_n_cols() const {
 }
 
 void Screen::handle_char(const TerminalChar &tch) {
+    generation++;
+
+    if (stats != nullptr) {
+        stat_add(stats->chars, 1);
+    }
+
     // CR
     if (tch.ch == '\r') {
         cursor_return();
@@ -97,6 +156,14 @@ void Screen::handle_char(const TerminalChar &tch) {
                 num = tch.args[0];
             }
             insert_next(num);
+        } else if (tch.ch == E_KEY_BRACKETED_PASTE_ON) {
+            bracketed_paste = true;
+        } else if (tch.ch == E_KEY_BRACKETED_PASTE_OFF) {
+            bracketed_paste = false;
+        } else if (tch.ch >= E_KEY_DA1 && tch.ch <= E_KEY_XTVERSION) {
+            answer_query(tch);
+        } else if (tch.ch >= E_KEY_MARK_PROMPT && tch.ch <= E_KEY_MARK_DONE) {
+            handle_mark(tch);
         }
     } else if (tch.ch > 0 && tch.ch < 256) {
         write_char(tch.ch);
@@ -104,6 +171,8 @@ void Screen::handle_char(const TerminalChar &tch) {
 }
 
 void Screen::write_char(const chtype ch) {
+    keep_in_pad();
+
     bool inserting = false;
 
     int y = getcury(pad);
@@ -283,6 +352,8 @@ void Screen::scroll_down() {
 }
 
 void Screen::newline() {
+    keep_in_pad();
+
     if (const int y = getcury(pad); line_info[y] == LINE_INFO_UNTOUCHED) {
         line_info[y] = LINE_INFO_UNWRAPPED;
     }
@@ -307,16 +378,14 @@ int Screen::get_pad_height() const {
     return pad_lines;
 }
 
-void Screen::delete_wins() const {
-    delwin(pad);
-}
-
 // Next num characters will be inserted.
 void Screen::insert_next(int num) {
     pushing_right = num;
 }
 
 void Screen::refresh_screen() const {
+    TRACE_SPAN("render");
+
     int start = pad_start;
 
     if (manual_scrolling_start != -1) {
@@ -335,15 +404,74 @@ void Screen::set_screen_coords(int sminy, int sminx, int smaxy, int smaxx) {
     this->smaxx = smaxx;
 }
 
-void Screen::expand_pad() {
-    // Resize
-    pad_lines += INITIAL_PAD_HEIGHT;
+// Shows another number of lines of the same content, without a reflow. The bottom line stays put.
+void Screen::set_viewport(const int lines) {
+    const int bottom = pad_start + n_lines;
+
+    n_lines = lines;
+    pad_start = std::max(0, bottom - n_lines);
+
+    // Keep the cursor in view
+    if (const int y = getcury(pad); y > pad_start + n_lines - 1) {
+        pad_start = y - n_lines + 1;
+    }
+
+    if (manual_scrolling_start > pad_start) {
+        manual_scrolling_start = pad_start;
+    }
+}
+
+// Returns false once the pad is as high as ncurses allows
+bool Screen::expand_pad() {
+    // Grow geometrically, growing ncurses pads by small steps is quadratic and fragments memory
+    const int extension = std::min(std::max(INITIAL_PAD_HEIGHT, pad_lines), MAX_PAD_HEIGHT - pad_lines);
+    if (extension <= 0) {
+        return false;
+    }
+
+    pad_lines += extension;
     wresize(pad, pad_lines, n_cols);
-    std::vector<std::vector<bool>> user_placed_ext = std::vector<std::vector<bool>>(INITIAL_PAD_HEIGHT, std::vector<bool>(n_cols, false));
-    std::vector<bool> line_info_ext = std::vector<bool>(INITIAL_PAD_HEIGHT, false);
+    std::vector<std::vector<bool>> user_placed_ext = std::vector<std::vector<bool>>(extension, std::vector<bool>(n_cols, false));
+    std::vector<int> line_info_ext = std::vector<int>(extension, LINE_INFO_UNTOUCHED);
 
     user_placed.insert(user_placed.end(), user_placed_ext.begin(), user_placed_ext.end());
     line_info.insert(line_info.end(), line_info_ext.begin(), line_info_ext.end());
+
+    return true;
+}
+
+// Drops the oldest history before the cursor can reach the last line the pad can have
+void Screen::keep_in_pad() {
+    if (getcury(pad) + n_lines + 2 < MAX_PAD_HEIGHT) {
+        return;
+    }
+
+    const int n = PAD_TRIM_LINES;
+    const int y = getcury(pad);
+    const int x = getcurx(pad);
+
+    scrollok(pad, TRUE);
+    wscrl(pad, n);
+    scrollok(pad, FALSE);
+
+    user_placed.erase(user_placed.begin(), user_placed.begin() + n);
+    user_placed.insert(user_placed.end(), n, std::vector<bool>(n_cols, false));
+    line_info.erase(line_info.begin(), line_info.begin() + n);
+    line_info.insert(line_info.end(), n, LINE_INFO_UNTOUCHED);
+
+    lines_dropped += n;
+
+    // Commands whose prompt is gone are gone
+    while (!command_marks.empty() && command_marks.front().prompt.line < lines_dropped) {
+        command_marks.pop_front();
+    }
+
+    pad_start = std::max(0, pad_start - n);
+    if (manual_scrolling_start != -1) {
+        manual_scrolling_start = std::max(0, manual_scrolling_start - n);
+    }
+
+    ::wmove(pad, std::max(0, y - n), x);
 }
 
 void Screen::init(int new_lines, int new_cols, int new_pty_master, int new_pid) {
@@ -361,8 +489,10 @@ void Screen::init(int new_lines, int new_cols, int new_pty_master, int new_pid)
     line_info = std::vector<int>(pad_lines, LINE_INFO_UNTOUCHED);
 }
 
-void Screen::init(int new_lines, int new_cols, Screen &old_screen) {
+void Screen::init(int new_lines, int new_cols, const Screen &old_screen) {
     init(new_lines, new_cols, old_screen.pty_master, old_screen.pid);
+    bracketed_paste = old_screen.bracketed_paste;
+    stats = old_screen.stats;
 
     bool first = true;
 
@@ -372,6 +502,27 @@ void Screen::init(int new_lines, int new_cols, Screen &old_screen) {
     int new_y = -1;
     int new_x = -1;
 
+    // Command marks move with the cells they point at, visited in history order
+    command_marks = old_screen.command_marks;
+    commands_done = old_screen.commands_done;
+
+    std::vector<HistoryPos *> targets;
+    for (CommandMark &mark : command_marks) {
+        for (HistoryPos *pos : {&mark.prompt, &mark.command, &mark.output, &mark.done}) {
+            if (pos->line != -1) {
+                targets.push_back(pos);
+            }
+        }
+    }
+
+    std::stable_sort(targets.begin(), targets.end(), [](const HistoryPos *a, const HistoryPos *b) {
+        return a->line < b->line || (a->line == b->line && a->col < b->col);
+    });
+
+    std::vector<HistoryPos> moved(targets.size());
+    size_t next_target = 0;
+    int64_t last_line = -1;
+
     // Transfer old data
     std::vector<chtype> current;
 
@@ -381,6 +532,8 @@ void Screen::init(int new_lines, int new_cols, Screen &old_screen) {
             continue;
         }
 
+        last_line = old_screen.lines_dropped + i;
+
         // Not wrapped to previous line
         if (old_screen.line_info[i] == LINE_INFO_UNWRAPPED) {
             if (first) {
@@ -392,6 +545,12 @@ void Screen::init(int new_lines, int new_cols, Screen &old_screen) {
         }
 
         for (int j = 0; j < old_screen.n_cols; j++) {
+            const int64_t line = old_screen.lines_dropped + i;
+            while (next_target < targets.size() &&
+                   (targets[next_target]->line < line || (targets[next_target]->line == line && targets[next_target]->col <= j))) {
+                moved[next_target++] = cursor_pos();
+            }
+
             if (i == old_y && j == old_x) {
                 // Translate cursor position
                 new_y = getcury(pad);
@@ -415,6 +574,24 @@ void Screen::init(int new_lines, int new_cols, Screen &old_screen) {
     if (new_y != -1 && new_x != -1) {
         wmove(pad, new_y, new_x);
     }
+
+    // Marks past the last cell go with the cursor, those on the fresh lines after it to the next line
+    while (next_target < targets.size()) {
+        const HistoryPos end = cursor_pos();
+        moved[next_target] = targets[next_target]->line > last_line ? HistoryPos{end.line + 1, 0} : end;
+        next_target++;
+    }
+
+    for (size_t t = 0; t < targets.size(); t++) {
+        *targets[t] = moved[t];
+    }
+
+    while (!command_marks.empty() && command_marks.front().prompt.line < lines_dropped) {
+        command_marks.pop_front();
+    }
+
+    // Reading moved the old cursor, put it back in case the old layout is reused
+    ::wmove(old_screen.pad, old_y, old_x);
 }
 
 bool Screen::is_in_manual_scroll() const {
@@ -441,6 +618,215 @@ void Screen::manual_scroll_down() {
     }
 }
 
+int Screen::get_manual_scrolling_start() const {
+    return manual_scrolling_start;
+}
+
+bool Screen::is_bracketed_paste() const {
+    return bracketed_paste;
+}
+
+uint64_t Screen::get_generation() const {
+    return generation;
+}
+
+void Screen::answer_query(const TerminalChar &tch) {
+    if (tch.ch == E_KEY_DA1) {
+        replies += DA1_REPLY;
+    } else if (tch.ch == E_KEY_DA2) {
+        replies += DA2_REPLY;
+    } else if (tch.ch == E_KEY_XTVERSION) {
+        replies += XTVERSION_REPLY;
+    } else if (tch.ch == E_KEY_DSR && tch.args.size() == 1) {
+        if (tch.args[0] == 5) {
+            replies += DSR_OK_REPLY;
+        } else if (tch.args[0] == 6) {
+            // Cursor position on the visible screen, 1-based
+            const int row = getcury(pad) - pad_start + 1;
+            const int col = getcurx(pad) + 1;
+            replies += "\x1b[" + std::to_string(row) + ";" + std::to_string(col) + "R";
+        }
+    }
+}
+
+HistoryPos Screen::cursor_pos() const {
+    return {lines_dropped + getcury(pad), getcurx(pad)};
+}
+
+void Screen::handle_mark(const TerminalChar &tch) {
+    if (tch.ch == E_KEY_MARK_PROMPT) {
+        CommandMark mark;
+        mark.prompt = cursor_pos();
+        command_marks.push_back(mark);
+        return;
+    }
+
+    // Marks out of order, e.g. a command done without a prompt before it, are dropped
+    if (command_marks.empty()) {
+        return;
+    }
+
+    CommandMark &mark = command_marks.back();
+
+    if (tch.ch == E_KEY_MARK_COMMAND) {
+        mark.command = cursor_pos();
+    } else if (tch.ch == E_KEY_MARK_OUTPUT && mark.command.line != -1) {
+        mark.output = cursor_pos();
+    } else if (tch.ch == E_KEY_MARK_DONE && mark.output.line != -1 && mark.done.line == -1) {
+        mark.done = cursor_pos();
+        mark.exit_status = tch.args.empty() ? 0 : tch.args[0];
+        commands_done++;
+    }
+}
+
+const std::deque<CommandMark> &Screen::get_command_marks() const {
+    return command_marks;
+}
+
+const CommandMark *Screen::last_finished_command() const {
+    // Prompts left without a done mark, like an empty Enter, are skipped
+    for (auto it = command_marks.rbegin(); it != command_marks.rend(); ++it) {
+        if (it->done.line != -1) {
+            return &*it;
+        }
+    }
+
+    return nullptr;
+}
+
+bool Screen::last_command_output(std::string &output) const {
+    const CommandMark *mark = last_finished_command();
+    if (mark == nullptr) {
+        return false;
+    }
+
+    output = read_text(mark->output, mark->done);
+    return true;
+}
+
+uint64_t Screen::get_commands_done() const {
+    return commands_done;
+}
+
+std::string Screen::last_lines(const int n) const {
+    const HistoryPos end = cursor_pos();
+    const HistoryPos begin = {std::max(lines_dropped, end.line - n + 1), 0};
+
+    return read_text(begin, end);
+}
+
+std::string Screen::read_text(const HistoryPos from, const HistoryPos to) const {
+    std::string text;
+
+    if (from.line == -1 || to.line == -1) {
+        return text;
+    }
+
+    // Reading moves the cursor
+    const int cur_y = getcury(pad);
+    const int cur_x = getcurx(pad);
+
+    std::vector<chtype> cells(n_cols + 1);
+
+    for (int64_t line = std::max(from.line, lines_dropped); line <= to.line; line++) {
+        const int y = static_cast<int>(line - lines_dropped);
+        if (y >= pad_lines) {
+            break;
+        }
+
+        const int begin = line == from.line ? from.col : 0;
+        const int end = line == to.line ? to.col : n_cols;
+
+        std::string row;
+        ::wmove(pad, y, 0);
+        winchnstr(pad, cells.data(), n_cols);
+        for (int x = begin; x < end; x++) {
+            row += static_cast<char>(cells[x] & A_CHARTEXT);
+        }
+
+        // A line continues on the next one only if it wrapped there
+        const bool wraps = y + 1 < pad_lines && line_info[y + 1] == LINE_INFO_WRAPPED && line < to.line;
+        if (!wraps) {
+            row.erase(row.find_last_not_of(' ') + 1);
+        }
+
+        text += row;
+
+        if (!wraps && line < to.line) {
+            text += '\n';
+        }
+    }
+
+    ::wmove(pad, cur_y, cur_x);
+
+    return text;
+}
+
+bool Screen::jump_to_prompt(const bool previous) {
+    if (!is_in_manual_scroll() || command_marks.empty()) {
+        return false;
+    }
+
+    const int64_t top = lines_dropped + manual_scrolling_start;
+    const CommandMark *target = nullptr;
+
+    // Marks are in history order
+    if (previous) {
+        const auto it = std::partition_point(command_marks.begin(), command_marks.end(),
+                                             [top](const CommandMark &mark) { return mark.prompt.line < top; });
+        if (it != command_marks.begin()) {
+            target = &*(it - 1);
+        }
+    } else {
+        const auto it = std::partition_point(command_marks.begin(), command_marks.end(),
+                                             [top](const CommandMark &mark) { return mark.prompt.line <= top; });
+        if (it != command_marks.end()) {
+            target = &*it;
+        }
+    }
+
+    if (target == nullptr) {
+        return false;
+    }
+
+    manual_scrolling_start = static_cast<int>(std::clamp<int64_t>(target->prompt.line - lines_dropped, 0, pad_start));
+    return true;
+}
+
+bool Screen::has_replies() const {
+    return !replies.empty();
+}
+
+std::string Screen::take_replies() {
+    std::string taken;
+    taken.swap(replies);
+    return taken;
+}
+
+void Screen::set_stats(PaneStats *new_stats) {
+    stats = new_stats;
+}
+
+PaneStats *Screen::get_stats() const {
+    return stats;
+}
+
+void LayoutCache::relayout(Screen &screen, const int lines, const int cols) {
+    TRACE_SPAN("reflow");
+
+    if (cached.get_pad() != nullptr && cached.get_n_cols() == cols && screen.get_generation() == generation) {
+        // Back to the previous width with nothing written since
+        std::swap(screen, cached);
+        screen.set_viewport(lines);
+    } else {
+        Screen reflowed(lines, cols, screen);
+        cached = std::move(screen);
+        screen = std::move(reflowed);
+    }
+
+    generation = screen.get_generation();
+}
+
 // Wrappers
 int Screen::waddch(WINDOW *window, const chtype ch) {
     // Mark line as touched
@@ -454,10 +840,9 @@ int Screen::waddch(WINDOW *window, const chtype ch) {
 
     while (true) {
         rc = ::waddch(window, ch);
-        if (rc != ERR) {
+        if (rc != ERR || !expand_pad()) {
             break;
         }
-        expand_pad();
     }
 
     return rc;
@@ -475,10 +860,9 @@ int Screen::winsch(WINDOW *window, const chtype ch) {
 
     while (true) {
         rc = ::winsch(window, ch);
-        if (rc != ERR) {
+        if (rc != ERR || !expand_pad()) {
             break;
         }
-        expand_pad();
     }
 
     return rc;
@@ -490,10 +874,9 @@ int Screen::wmove(WINDOW *window, int y, int x) {
 
     while (true) {
         rc = ::wmove(window, y, x);
-        if (rc != ERR) {
+        if (rc != ERR || !expand_pad()) {
             break;
         }
-        expand_pad();
     }
 
     return rc;
@@ -0,0 +1,141 @@
+#include <algorithm>
+
+#include <session_history.hpp>
+#include <utils.hpp>
+
+#define QUERY_PREFIX "Query: "
+#define RESULT_PREFIX "\nAnswer: "
+
+SessionHistory::SessionHistory(const size_t token_budget)
+    : token_budget(token_budget != 0 ? token_budget : SESSION_HISTORY_TOKENS) {
+}
+
+void SessionHistory::append(const std::string &query, const std::string &result, const bool pinned) {
+    Turn turn{encoded.size(), query.size(), result.size(), 0, pinned};
+
+    encoded.append(QUERY_PREFIX).append(query).append(RESULT_PREFIX).append(result).append("\n");
+    turn.tokens = estimate_tokens(encoded.data() + turn.offset, encoded.size() - turn.offset);
+
+    if (pinned) {
+        pinned_turns.push_back(turns.size());
+    }
+    turns.push_back(turn);
+}
+
+void SessionHistory::pin(const size_t index) {
+    if (index < turns.size() && !turns[index].pinned) {
+        turns[index].pinned = true;
+        pinned_turns.insert(std::lower_bound(pinned_turns.begin(), pinned_turns.end(), index), index);
+    }
+}
+
+void SessionHistory::unpin(const size_t index) {
+    if (index < turns.size() && turns[index].pinned) {
+        turns[index].pinned = false;
+        pinned_turns.erase(std::lower_bound(pinned_turns.begin(), pinned_turns.end(), index));
+    }
+}
+
+bool SessionHistory::is_pinned(const size_t index) const {
+    return index < turns.size() && turns[index].pinned;
+}
+
+void SessionHistory::clear() {
+    encoded.clear();
+    turns.clear();
+    pinned_turns.clear();
+}
+
+size_t SessionHistory::size() const {
+    return turns.size();
+}
+
+bool SessionHistory::empty() const {
+    return turns.empty();
+}
+
+std::pair<std::string, std::string> SessionHistory::operator[](const size_t index) const {
+    const Turn &turn = turns[index];
+    const size_t query_offset = turn.offset + sizeof(QUERY_PREFIX) - 1;
+    const size_t result_offset = query_offset + turn.query_size + sizeof(RESULT_PREFIX) - 1;
+
+    return {encoded.substr(query_offset, turn.query_size), encoded.substr(result_offset, turn.result_size)};
+}
+
+size_t SessionHistory::encoded_size(const Turn &turn) const {
+    return sizeof(QUERY_PREFIX) - 1 + turn.query_size + sizeof(RESULT_PREFIX) - 1 + turn.result_size + 1;
+}
+
+std::string SessionHistory::window() const {
+    size_t remaining = token_budget;
+
+    // Pinned turns first, the most recent of them if not all fit. Newest first.
+    std::vector<size_t> chosen;
+    for (auto it = pinned_turns.rbegin(); it != pinned_turns.rend(); ++it) {
+        if (turns[*it].tokens <= remaining) {
+            chosen.push_back(*it);
+            remaining -= turns[*it].tokens;
+        }
+    }
+
+    // Recent turns back to the first that does not fit, one contiguous stretch of the buffer
+    size_t start = turns.size();
+    size_t next_chosen = 0;
+    while (start > 0) {
+        const size_t index = start - 1;
+        while (next_chosen < chosen.size() && chosen[next_chosen] > index) {
+            next_chosen++;
+        }
+
+        if (next_chosen == chosen.size() || chosen[next_chosen] != index) {
+            if (turns[index].tokens > remaining) {
+                break;
+            }
+            remaining -= turns[index].tokens;
+        }
+        start--;
+    }
+
+    std::string window;
+    for (auto it = chosen.rbegin(); it != chosen.rend() && *it < start; ++it) {
+        window.append(encoded, turns[*it].offset, encoded_size(turns[*it]));
+    }
+    if (start < turns.size()) {
+        window.append(encoded, turns[start].offset, std::string::npos);
+    }
+
+    return window;
+}
+
+size_t SessionHistory::get_token_budget() const {
+    return token_budget;
+}
+
+void SessionHistory::set_token_budget(const size_t token_budget) {
+    this->token_budget = token_budget;
+}
+
+size_t SessionHistory::estimate_tokens(const char *data, const size_t size) {
+    size_t tokens = 0;
+    size_t word = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        const auto c = static_cast<unsigned char>(data[i]);
+
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') {
+            word++;
+            continue;
+        }
+
+        tokens += (word + 3) / 4;
+        word = 0;
+
+        // Whitespace mostly merges into the next token, UTF-8 continuation bytes into their character
+        if (c > ' ' && (c & 0xc0) != 0x80) {
+            tokens++;
+        }
+    }
+    tokens += (word + 3) / 4;
+
+    return std::max(tokens, (size + 7) / 8);
+}
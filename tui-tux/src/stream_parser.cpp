@@ -0,0 +1,189 @@
+#include <cstring>
+#include <utility>
+#include "../nlohmann/json.hpp"
+
+#include <stream_parser.hpp>
+#include <terminal_context.hpp>
+#include <utils.hpp>
+
+using json = nlohmann::json;
+
+StreamParser::StreamParser(const StreamFormat format, std::function<void(const std::string &)> on_delta)
+    : format(format), on_delta(std::move(on_delta)) {
+}
+
+bool StreamParser::detect(const std::string &content_type, StreamFormat &format) {
+    // Parameters like "; charset=utf-8" may follow
+    const std::string type = content_type.substr(0, content_type.find(';'));
+
+    if (type == "text/event-stream") {
+        format = StreamFormat::SSE;
+        return true;
+    }
+
+    if (type == "application/x-ndjson" || type == "application/jsonl") {
+        format = StreamFormat::NDJSON;
+        return true;
+    }
+
+    return false;
+}
+
+void StreamParser::feed(const char *data, const size_t n) {
+    const char *end = data + n;
+
+    while (data < end) {
+        const void *newline = memchr(data, '\n', end - data);
+        const char *line_end = newline != nullptr ? static_cast<const char *>(newline) : end;
+
+        if (!line_dropped) {
+            if (static_cast<size_t>(line_end - data) > STREAM_LINE_MAX - line.size()) {
+                drop("line");
+            } else {
+                line.append(data, line_end);
+            }
+        }
+
+        if (newline == nullptr) {
+            return;
+        }
+
+        if (!line_dropped) {
+            handle_line();
+        }
+        line.clear();
+        line_dropped = false;
+        data = line_end + 1;
+    }
+}
+
+void StreamParser::finish() {
+    if (!line.empty() && !line_dropped) {
+        handle_line();
+    }
+    line.clear();
+    line_dropped = false;
+
+    // An SSE event cut off before its blank line still counts
+    if (has_event_data) {
+        handle_event(event_data);
+        event_data.clear();
+        has_event_data = false;
+    }
+}
+
+const std::string &StreamParser::get_text() const {
+    return text;
+}
+
+const std::string &StreamParser::get_error() const {
+    return error;
+}
+
+bool StreamParser::is_done() const {
+    return done;
+}
+
+void StreamParser::handle_line() {
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+
+    if (format == StreamFormat::NDJSON) {
+        if (!line.empty()) {
+            handle_event(line);
+        }
+        return;
+    }
+
+    // A blank line dispatches the event
+    if (line.empty()) {
+        if (has_event_data) {
+            handle_event(event_data);
+            event_data.clear();
+            has_event_data = false;
+        }
+        return;
+    }
+
+    // Only data fields matter, event names, ids and comments are skipped
+    if (line.rfind("data:", 0) != 0) {
+        return;
+    }
+
+    size_t start = 5;
+    if (start < line.size() && line[start] == ' ') {
+        start++;
+    }
+
+    if (event_data.size() + line.size() - start >= STREAM_LINE_MAX) {
+        drop("event");
+        event_data.clear();
+        has_event_data = false;
+        return;
+    }
+
+    if (has_event_data) {
+        event_data += '\n';
+    }
+
+    event_data += line.substr(start);
+    has_event_data = true;
+}
+
+void StreamParser::drop(const char *what) {
+    line.clear();
+    line_dropped = true;
+
+    if (error.empty()) {
+        error = std::string("stream ") + what + " longer than " + std::to_string(STREAM_LINE_MAX) + " bytes dropped";
+    }
+}
+
+void StreamParser::handle_event(const std::string &payload) {
+    if (done) {
+        return;
+    }
+
+    if (payload == "[DONE]") {
+        done = true;
+        return;
+    }
+
+    std::string delta;
+
+    try {
+        const json event = json::parse(payload);
+
+        if (event.is_object()) {
+            if (event.contains("error")) {
+                error = event["error"].is_string() ? event["error"].get<std::string>() : event["error"].dump(-1, ' ', false, json::error_handler_t::replace);
+            }
+
+            if (event.contains("delta") && event["delta"].is_string()) {
+                delta = event["delta"].get<std::string>();
+            } else if (event.contains("content") && event["content"].is_string()) {
+                delta = event["content"].get<std::string>();
+            }
+
+            // Only a real true ends the stream, value() would throw on "done": 1
+            if (event.contains("done") && event["done"].is_boolean() && event["done"].get<bool>()) {
+                done = true;
+            }
+        } else if (event.is_string()) {
+            delta = event.get<std::string>();
+        }
+    } catch (json::parse_error &) {
+        // Plain text events carry the delta as is, but it ends up in JSON bodies, which must be UTF-8
+        if (format == StreamFormat::SSE) {
+            delta = sanitize_utf8(payload);
+        }
+    }
+
+    if (!delta.empty()) {
+        text += delta;
+        if (on_delta) {
+            on_delta(delta);
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <terminal_context.hpp>
+
+SharedTerminalContext *shared_terminal_context = nullptr;
+
+void map_shared_terminal_context() {
+    if (shared_terminal_context != nullptr) {
+        return;
+    }
+
+    void *mem = mmap(nullptr, sizeof(SharedTerminalContext), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap: terminal context");
+        exit(EXIT_FAILURE);
+    }
+
+    shared_terminal_context = new (mem) SharedTerminalContext();
+}
+
+std::string tail_within_budget(const std::string &text, const size_t budget) {
+    if (text.size() <= budget) {
+        return text;
+    }
+
+    size_t start = text.size() - budget;
+
+    // Skip continuation bytes of a character cut in half
+    while (start < text.size() && (static_cast<unsigned char>(text[start]) & 0xC0) == 0x80) {
+        start++;
+    }
+
+    return text.substr(start);
+}
+
+// Length of the well-formed UTF-8 sequence at data (RFC 3629), 0 if there is none. C0, C1 and F5
+// to FF never lead, and the second byte's range rules out overlong forms, surrogates and code
+// points past U+10FFFF.
+static size_t utf8_sequence_length(const unsigned char *data, const size_t available) {
+    const unsigned char lead = data[0];
+    size_t length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+
+    if (lead < 0x80) {
+        return 1;
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        low = lead == 0xE0 ? 0xA0 : 0x80;
+        high = lead == 0xED ? 0x9F : 0xBF;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        low = lead == 0xF0 ? 0x90 : 0x80;
+        high = lead == 0xF4 ? 0x8F : 0xBF;
+    } else {
+        return 0;
+    }
+
+    if (available < length || data[1] < low || data[1] > high) {
+        return 0;
+    }
+    for (size_t j = 2; j < length; j++) {
+        if ((data[j] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+std::string sanitize_utf8(const std::string &text) {
+    std::string clean = text;
+
+    for (size_t i = 0; i < clean.size();) {
+        const size_t length = utf8_sequence_length(reinterpret_cast<const unsigned char *>(clean.data()) + i, clean.size() - i);
+
+        if (length == 0) {
+            clean[i++] = '?';
+        } else {
+            i += length;
+        }
+    }
+
+    return clean;
+}
+
+void publish_terminal_context(const int source, const int exit_status, const std::string &output) {
+    SharedTerminalContext *shared = shared_terminal_context;
+    if (shared == nullptr) {
+        return;
+    }
+
+    const std::string tail = sanitize_utf8(tail_within_budget(output, TERMINAL_CONTEXT_BUDGET));
+    const uint64_t sequence = shared->sequence.load(std::memory_order_relaxed);
+
+    shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    shared->source = source;
+    shared->exit_status = exit_status;
+    shared->truncated = tail.size() < output.size();
+    shared->length = static_cast<uint32_t>(tail.size());
+    memcpy(shared->output, tail.data(), tail.size());
+
+    shared->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+TerminalContext read_terminal_context() {
+    TerminalContext context;
+
+    const SharedTerminalContext *shared = shared_terminal_context;
+    if (shared == nullptr) {
+        return context;
+    }
+
+    while (true) {
+        const uint64_t before = shared->sequence.load(std::memory_order_acquire);
+        if (before % 2 == 1) {
+            continue;
+        }
+
+        context.source = shared->source;
+        context.exit_status = shared->exit_status;
+        context.truncated = shared->truncated;
+        context.output.assign(shared->output, std::min<uint32_t>(shared->length, TERMINAL_CONTEXT_BUDGET));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared->sequence.load(std::memory_order_relaxed) == before) {
+            return context;
+        }
+    }
+}
@@ -1,6 +1,8 @@
 #include <ncurses.h>
 #include <sys/epoll.h>
 #include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
 #include <csignal>
 #include <pty.h>
 #include <cstdlib>
@@ -8,11 +10,15 @@
 #include <cstring>
 #include <cerrno>
 #include <string>
+#include <memory>
+#include <algorithm>
 
 #include <screen.hpp>
 #include <utils.hpp>
 #include <agent.hpp>
 #include <escape.hpp>
+#include <trace.hpp>
+#include <terminal_context.hpp>
 
 #include <terminal_multiplexer.hpp>
 
@@ -32,7 +38,44 @@ void TerminalMultiplexer::run() {
     run_terminal();
 }
 
+// Startup file for bash that sources the usual ~/.bashrc, then emits the OSC 133 marks:
+// prompt start and end around PS1, output start from PS0, and the exit status before each prompt.
+// Written to a memfd the shell reads and closes. -1 if the shell is not bash or it cannot be written.
+int TerminalMultiplexer::bash_integration_rc() const {
+    if (strcmp(basename(shell), "bash") != 0) {
+        return -1;
+    }
+
+    const int fd = memfd_create("ishell-bashrc", 0);
+    if (fd == -1) {
+        perror("memfd_create: bashrc");
+        return -1;
+    }
+
+    const std::string rc =
+        "[ -f ~/.bashrc ] && . ~/.bashrc\n"
+        "__ishell_prompt() { local status=$?; printf '\\e]133;D;%d\\a' \"$status\"; return $status; }\n"
+        "PROMPT_COMMAND=\"__ishell_prompt${PROMPT_COMMAND:+;$PROMPT_COMMAND}\"\n"
+        "PS1=\"\\[\\e]133;A\\a\\]$PS1\\[\\e]133;B\\a\\]\"\n"
+        "PS0=\"$PS0\\e]133;C\\a\"\n"
+        "exec " + std::to_string(fd) + "<&-\n";
+
+    if (write(fd, rc.data(), rc.size()) != static_cast<ssize_t>(rc.size()) || lseek(fd, 0, SEEK_SET) == -1) {
+        perror("write: bashrc");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
 void TerminalMultiplexer::init() {
+    // Shared with the children, so the HUD sees agent requests in flight
+    map_shared_perf_stats();
+
+    // Likewise, so agent queries can include what the bash window shows
+    map_shared_terminal_context();
+
     // Create a new PTY
     int pty_bash_master, pty_bash_slave;
 
@@ -71,7 +114,12 @@ void TerminalMultiplexer::init() {
         // Set TERM type
         setenv("TERM", "ishell-m", 1);
 
-        // Execute the shell
+        // Execute the shell, with the shell integration marks if it is bash
+        if (const int rc_fd = bash_integration_rc(); rc_fd != -1) {
+            const std::string rc_path = "/dev/fd/" + std::to_string(rc_fd);
+            execl(shell, shell, "--rcfile", rc_path.c_str(), NULL);
+        }
+
         execl(shell, shell, NULL);
 
         // If execl fails
@@ -149,6 +197,16 @@ void TerminalMultiplexer::init() {
     screens.emplace_back(0, 0, pty_agent_master, agent_pid);
     screens.emplace_back(0, 0, pty_bash_master, bash_pid);
 
+    layout_caches = std::vector<LayoutCache>(screens.size());
+
+    pane_stats = std::vector<PaneStats>(screens.size());
+    for (size_t i = 0; i < screens.size(); i++) {
+        screens[i].set_stats(&pane_stats[i]);
+    }
+
+    outbound = std::vector<OutboundQueue>(screens.size());
+    watching_output = std::vector<bool>(screens.size(), false);
+
     init_nc();
 }
 
@@ -165,6 +223,10 @@ void TerminalMultiplexer::init_nc() {
     init_pair(WHITE_ON_MAGENTA, COLOR_WHITE, COLOR_MAGENTA); // White foreground, Magenta background
     noecho();
 
+    // Have the outer terminal mark pastes, so they bypass key bindings
+    printf(BRACKETED_PASTE_ENABLE);
+    fflush(stdout);
+
     create_wins_draw();
 }
 
@@ -206,6 +268,20 @@ void TerminalMultiplexer::draw_focus() const {
     refresh_cursor();
 }
 
+void TerminalMultiplexer::draw_bottom_bar() const {
+    wbkgd(bottom_bar, COLOR_PAIR(WHITE_ON_MAGENTA));
+    werase(bottom_bar);
+
+    if (hud_visible) {
+        // Cut off at the edge of the window
+        waddnstr(bottom_bar, hud_text.c_str(), getmaxx(bottom_bar));
+    } else {
+        wprintw(bottom_bar, "ishell");
+    }
+
+    wrefresh(bottom_bar);
+}
+
 void TerminalMultiplexer::switch_focus() {
     // Toggle the focus state
 
@@ -223,7 +299,7 @@ void TerminalMultiplexer::switch_focus() {
     draw_focus();
 }
 
-void TerminalMultiplexer::create_wins_draw() {
+void TerminalMultiplexer::create_wins_draw(const bool reflow) {
     int rows, cols;
     getmaxyx(stdscr, rows, cols);
 
@@ -237,21 +313,11 @@ void TerminalMultiplexer::create_wins_draw() {
     int agent_y = 0, agent_x = 0;
     int bash_y = middle_row + 1, bash_x = 0;
 
-    // Create windows for bottom bar and middle divider
-    if (bottom_bar != nullptr) {
-        delwin(bottom_bar);
-    }
-
-    if (middle_divider != nullptr) {
-        delwin(middle_divider);
-    }
+    // Reuse the bottom bar and middle divider, only their geometry changes
+    place_window(bottom_bar, 1, cols, rows - 1, 0);
+    place_window(middle_divider, 1, cols, middle_row, 0);
 
-    bottom_bar = newwin(1, cols, rows - 1, 0);
-    middle_divider = newwin(1, cols, middle_row, 0);
-
-    wbkgd(bottom_bar, COLOR_PAIR(WHITE_ON_MAGENTA));
-    wprintw(bottom_bar, "ishell");
-    wrefresh(bottom_bar);
+    draw_bottom_bar();
 
     if (zoomed_in) {
         if (focus == FOCUS_AGENT) {
@@ -266,24 +332,27 @@ void TerminalMultiplexer::create_wins_draw() {
         }
     }
 
-    // Resize old screens
-    std::vector<Screen> new_screens;
-    
-    // Agent
-    Screen screen = Screen(agent_lines, agent_cols, screens[0]);
-    screen.set_screen_coords(agent_y, agent_x, agent_y + agent_lines - 1, agent_x + agent_cols - 1);
+    const int lines[] = {agent_lines, bash_lines};
+    const int widths[] = {agent_cols, bash_cols};
+    const int ys[] = {agent_y, bash_y};
+    const int xs[] = {agent_x, bash_x};
 
-    new_screens.push_back(screen);
-
-    // Bash
-    screen = Screen(bash_lines, bash_cols, screens[1]);
-    screen.set_screen_coords(bash_y, bash_x, bash_y + bash_lines - 1, bash_x + bash_cols - 1);
-
-    new_screens.push_back(screen);
+    // Relayout the screens in place
+    for (size_t i = 0; i < screens.size(); i++) {
+        if (reflow && screens[i].get_n_cols() != widths[i]) {
+            // Wrapping changes, the history is laid out again unless the layout for that width is cached
+            layout_caches[i].relayout(screens[i], lines[i], widths[i]);
+        } else {
+            // Same content, another number of lines shown. Until the reflow a changed width is clipped.
+            screens[i].set_viewport(lines[i]);
+        }
 
-    delete_windows();
+        screens[i].set_screen_coords(ys[i], xs[i], ys[i] + lines[i] - 1, xs[i] + widths[i] - 1);
+    }
 
-    screens = new_screens;
+    for (const Screen &screen : screens) {
+        screen.refresh_screen();
+    }
 
     if (focus == FOCUS_NULL) {
         switch_focus();
@@ -292,25 +361,56 @@ void TerminalMultiplexer::create_wins_draw() {
     }
 }
 
-void TerminalMultiplexer::delete_windows() {
-    for (Screen &screen : screens) {
-        screen.delete_wins();
-    }
+void TerminalMultiplexer::place_window(WINDOW *&window, const int lines, const int cols, const int y, const int x) {
+    if (window != nullptr) {
+        // Resize first, so the window fits where it moves to
+        if (wresize(window, lines, cols) != ERR && mvwin(window, y, x) != ERR) {
+            return;
+        }
 
-    for (WINDOW *window : windows) {
         delwin(window);
     }
 
-    windows.clear();
+    window = newwin(lines, cols, y, x);
+}
+
+void TerminalMultiplexer::delete_windows() {
+    // Screens release their own pads
+    screens.clear();
+    layout_caches.clear();
+
+    if (bottom_bar != nullptr) {
+        delwin(bottom_bar);
+        bottom_bar = nullptr;
+    }
+
+    if (middle_divider != nullptr) {
+        delwin(middle_divider);
+        middle_divider = nullptr;
+    }
 }
 
 void TerminalMultiplexer::cleanup() {
+    // Stop the pane threads, which record until then
+    readers.clear();
+    recorder.reset();
+
     delete_windows();
+
+    printf(BRACKETED_PASTE_DISABLE);
+    fflush(stdout);
+
     endwin();
 }
 
 void TerminalMultiplexer::send_dims() {
-    for (Screen &screen : screens) {
+    for (size_t i = 0; i < screens.size(); i++) {
+        Screen &screen = screens[i];
+
+        if (recorder != nullptr) {
+            recorder->resize(static_cast<uint8_t>(RECORD_STREAM_STDIN + 1 + i), screen.get_n_lines(), screen.get_n_cols());
+        }
+
         winsize w{};
         memset(&w, 0, sizeof(w));
         w.ws_row = screen.get_n_lines();
@@ -329,42 +429,60 @@ void TerminalMultiplexer::send_dims() {
 }
 
 void TerminalMultiplexer::resize() {
+    TRACE_SPAN("resize");
+
     clear();
     refresh();
     create_wins_draw();
     send_dims();
 }
 
-void TerminalMultiplexer::run_terminal() {
-    send_dims();
+void TerminalMultiplexer::schedule_resize() {
+    TRACE_SPAN("resize_layout");
 
-    // Create an epoll instance
-    const int epoll_fd = epoll_create1(0);
-    if (epoll_fd == -1) {
-        perror("epoll_create1");
-        exit(EXIT_FAILURE);
+    // Lay out the windows for the new size right away, without reflowing any history
+    clear();
+    refresh();
+    create_wins_draw(false);
+
+    // The reflow and the children's SIGWINCH follow once the size stops changing for a while
+    const uint64_t now = monotonic_ns();
+    if (resize_pending_since == 0) {
+        resize_pending_since = now;
     }
 
-    // Add stdin to the epoll instance
-    epoll_event event{};
-    event.events = EPOLLIN;
-    event.data.fd = STDIN_FILENO;
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == -1) {
-        perror("epoll_ctl: stdin");
+    const uint64_t deadline = std::min(now + RESIZE_DEBOUNCE_NS, resize_pending_since + RESIZE_MAX_DELAY_NS);
+
+    itimerspec spec{};
+    spec.it_value.tv_sec = static_cast<time_t>(deadline / 1000000000ULL);
+    spec.it_value.tv_nsec = static_cast<long>(deadline % 1000000000ULL);
+
+    if (timerfd_settime(resize_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        perror("timerfd_settime");
         exit(EXIT_FAILURE);
     }
+}
 
-    // Add ptys to epoll instance
-    for (const auto & screen : screens) {
-        epoll_event event1{};
-        event1.events = EPOLLIN;
-        event1.data.fd = screen.get_pty_master();
-        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event1.data.fd, &event1) == -1) {
-            perror("epoll_ctl: pty");
-            exit(EXIT_FAILURE);
+void TerminalMultiplexer::run_terminal() {
+    // Spans go to $ISHELL_TRACE, if set
+    trace_start_from_env();
+
+    // Stdin and pane output go to $ISHELL_RECORD, if set
+    if (const char *record_path = getenv("ISHELL_RECORD"); record_path != nullptr && *record_path != '\0') {
+        recorder = std::make_unique<Recorder>();
+        if (!recorder->open(record_path)) {
+            recorder.reset();
         }
     }
 
+    send_dims();
+
+    // epoll, or io_uring if asked for and supported
+    event_loop = make_event_loop(loop_backend_from_env());
+
+    // Add stdin to the event loop
+    event_loop->add(STDIN_FILENO, EPOLLIN);
+
     struct sigaction sa_old{};
     sigset_t mask;
 
@@ -404,38 +522,127 @@ void TerminalMultiplexer::run_terminal() {
         exit(EXIT_FAILURE);
     }
 
-    event.events = EPOLLIN;
-    event.data.fd = sigfd;
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sigfd, &event) == -1) {
-        perror("epoll_ctl: sigfd");
+    event_loop->add(sigfd, EPOLLIN);
+
+    // Fires once a burst of resizes is over
+    resize_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (resize_timer_fd < 0) {
+        perror("timerfd_create");
+        exit(EXIT_FAILURE);
+    }
+
+    event_loop->add(resize_timer_fd, EPOLLIN);
+
+    // Refreshes the HUD, armed only while it is shown
+    hud_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (hud_timer_fd < 0) {
+        perror("timerfd_create");
+        exit(EXIT_FAILURE);
+    }
+
+    event_loop->add(hud_timer_fd, EPOLLIN);
+
+    // Hands the bash window's last lines over once a throttled burst of output is over
+    context_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (context_timer_fd < 0) {
+        perror("timerfd_create");
+        exit(EXIT_FAILURE);
+    }
+
+    event_loop->add(context_timer_fd, EPOLLIN);
+
+    // Resumes stdin once a paste has waited too long for its pane
+    paste_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (paste_timer_fd < 0) {
+        perror("timerfd_create");
         exit(EXIT_FAILURE);
     }
 
+    event_loop->add(paste_timer_fd, EPOLLIN);
+
+    // Pty output is read and parsed on a thread per pane, which wakes us up through an eventfd.
+    // Started after blocking SIGWINCH, so the threads inherit the mask and signalfd sees every resize.
+    for (const auto & screen : screens) {
+        readers.push_back(std::make_unique<PaneReader>(screen.get_pty_master(), event_loop->get_backend(), screen.get_stats()));
+    }
+
+    pane_pending = std::vector<bool>(readers.size(), false);
+
+    for (size_t i = 0; i < readers.size(); i++) {
+        event_loop->add(readers[i]->get_notify_fd(), EPOLLIN);
+        readers[i]->set_recorder(recorder.get(), static_cast<uint8_t>(RECORD_STREAM_STDIN + 1 + i));
+        readers[i]->start();
+    }
+
     bool epolling = true;
 
+    // Last moment stdin was known to be empty, used to measure input latency
+    uint64_t stdin_idle_since = monotonic_ns();
+
     while (epolling) {
-        epoll_event events[MAX_EVENTS];
-        const int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        LoopEvent events[MAX_EVENTS];
+
+        // Poll without blocking first. Events found here queued up during the previous turn,
+        // while events after a blocking wait arrived just now. Never block with pane output left over.
+        bool woke_up = false;
+        int n = event_loop->wait(events, MAX_EVENTS, 0);
+
+        if (n == 0 && std::find(pane_pending.begin(), pane_pending.end(), true) == pane_pending.end()) {
+            TRACE_SPAN("event_loop_wait");
+            n = event_loop->wait(events, MAX_EVENTS, -1);
+            woke_up = true;
+        }
 
         if (n < 0) {
-            if (errno == EINTR) {
+            if (n == -EINTR) {
                 // this happens sometimes
                 continue;
             }
 
-            perror("epoll_wait");
+            errno = -n;
+            perror("event loop wait");
             exit(EXIT_FAILURE);
         }
 
+        const uint64_t turn_start = monotonic_ns();
+        loop_stats.turns++;
+
+        if (woke_up) {
+            stdin_idle_since = turn_start;
+        }
+
+        // User input goes first, so a flooding pane cannot delay keystrokes
+        bool stdin_ready = false;
+
         for (int i = 0; i < n; i++) {
-            if (events[i].data.fd == STDIN_FILENO) {
-                // User input
-                int n_in = handle_input();
-                if (n_in == 0) {
-                    epolling = false;
-                    break;
-                }    
-            } else if (events[i].data.fd == sigfd) {
+            if (events[i].fd == STDIN_FILENO) {
+                stdin_ready = true;
+            }
+        }
+
+        if (stdin_ready) {
+            TRACE_SPAN("input");
+            int n_in = handle_input();
+            if (n_in == 0) {
+                break;
+            }
+
+            const uint64_t now = monotonic_ns();
+            if (now - stdin_idle_since > loop_stats.max_input_latency_ns) {
+                loop_stats.max_input_latency_ns = now - stdin_idle_since;
+            }
+            stdin_idle_since = now;
+        } else {
+            stdin_idle_since = turn_start;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].fd == STDIN_FILENO) {
+                // Already handled
+                continue;
+            }
+
+            if (events[i].fd == sigfd) {
                 // Read the signal
                 signalfd_siginfo sigfd_info{};
 
@@ -454,67 +661,195 @@ void TerminalMultiplexer::run_terminal() {
                 }
 
                 // Resize
+                schedule_resize();
+            } else if (events[i].fd == resize_timer_fd) {
+                uint64_t expirations;
+                if (read(resize_timer_fd, &expirations, sizeof(expirations)) < 0) {
+                    // Spurious wake-up, ignore
+                    continue;
+                }
+
+                resize_pending_since = 0;
                 resize();
+            } else if (events[i].fd == hud_timer_fd) {
+                uint64_t expirations;
+                if (read(hud_timer_fd, &expirations, sizeof(expirations)) < 0) {
+                    // Spurious wake-up, ignore
+                    continue;
+                }
+
+                update_hud();
+            } else if (events[i].fd == context_timer_fd) {
+                uint64_t expirations;
+                if (read(context_timer_fd, &expirations, sizeof(expirations)) < 0) {
+                    // Spurious wake-up, ignore
+                    continue;
+                }
+
+                context_timer_armed = false;
+                publish_last_lines();
+            } else if (events[i].fd == paste_timer_fd) {
+                uint64_t expirations;
+                if (read(paste_timer_fd, &expirations, sizeof(expirations)) < 0) {
+                    // Spurious wake-up, ignore
+                    continue;
+                }
+
+                // The pane is not reading, the rest of the paste overflows its queue
+                paste_stalled = true;
+                pause_input(false);
             } else {
-                // A PTY
-                for (Screen &screen : screens) {
-                    if (screen.get_pty_master() == events[i].data.fd) {
-                        if (const int n_pty = handle_screen_output(screen, events[i].data.fd); n_pty <= 0) {
-                            epolling = false;
-                            break;
-                        }
+                for (size_t j = 0; j < readers.size(); j++) {
+                    if (readers[j]->get_notify_fd() == events[i].fd) {
+                        // Parsed pane output is waiting
+                        pane_pending[j] = true;
+                        break;
+                    }
 
+                    if (readers[j]->get_fd() == events[i].fd) {
+                        // The pty takes input again
+                        flush_pty_input(static_cast<int>(j));
                         break;
                     }
                 }
             }
         }
+
+        // Each pane gets one budget per turn. Output left over stays pending for the next turn.
+        for (size_t j = 0; j < readers.size() && epolling; j++) {
+            if (pane_pending[j]) {
+                bool more = false;
+
+                if (handle_screen_output(static_cast<int>(j), more) < 0) {
+                    epolling = false;
+                }
+
+                pane_pending[j] = more;
+            }
+        }
+
+        loop_stats.turn_latency.record(monotonic_ns() - turn_start);
     }
 
-    close(epoll_fd);
+    event_loop.reset();
+
+    close(resize_timer_fd);
+    resize_timer_fd = -1;
+
+    close(hud_timer_fd);
+    hud_timer_fd = -1;
+
+    close(context_timer_fd);
+    context_timer_fd = -1;
+    context_timer_armed = false;
+
+    close(paste_timer_fd);
+    paste_timer_fd = -1;
+
+    trace_stop();
 }
 
-int TerminalMultiplexer::handle_screen_output(Screen &screen, const int fd) const {
-    int bytes_read = 0;
+int TerminalMultiplexer::handle_screen_output(const int index, bool &more) {
+    TRACE_SPAN("pane_drain");
 
-    while (true) {
-        std::vector<TerminalChar> chars;
-        const int n = read_and_escape(fd, chars);
+    Screen &screen = screens[index];
+    PaneReader &reader = *readers[index];
 
-        if (n < 0) {
-            if (errno == EIO) {
-                // PTY set EIO (-1) for closure for some reason...
-                return -1;
-            }
+    int bytes_read = 0;
+    const uint64_t start = monotonic_ns();
+    const uint64_t deadline = start + PTY_READ_BUDGET_NS;
 
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Done reading. Do not return a 0 if spurious
-                if (bytes_read == 0) {
-                    bytes_read = 1;
-                }
-                break;
-            }
+    // Anything published from now on wakes us up again
+    reader.clear_notification();
 
-            perror("read");
-            exit(EXIT_FAILURE);
+    // Apply parsed output until drained or out of budget for this turn
+    PaneChunk chunk;
+
+    while (bytes_read < PTY_READ_BUDGET_BYTES && monotonic_ns() < deadline && reader.pop(chunk)) {
+        if (chunk.n_bytes < 0) {
+            // PTY closed
+            return -1;
         }
 
-        if (n > 0) {
-            bytes_read += n;
-            for (TerminalChar &tch : chars) {
-                screen.handle_char(tch);
-            }
+        bytes_read += chunk.n_bytes;
+        for (TerminalChar &tch : chunk.chars) {
+            screen.handle_char(tch);
         }
     }
 
+    more = !reader.empty();
+
+    // The application waits for these, answer before drawing
+    if (screen.has_replies()) {
+        handle_pty_input(index, screen.take_replies());
+        flush_pty_input(index);
+    }
+
     if (bytes_read > 0) {
         screen.refresh_screen();
         refresh_cursor();
+
+        if (index == FOCUS_BASH) {
+            update_terminal_context();
+        }
+
+        if (PaneStats *stats = screen.get_stats(); stats != nullptr) {
+            stat_add(stats->frames, 1);
+            stat_set(stats->last_frame_ns, monotonic_ns() - start);
+        }
     }
 
     return bytes_read;
 }
 
+// Hands the output of the last bash command to the agent once it finished. Without shell
+// integration marks, the last lines are handed over at most every TERMINAL_CONTEXT_REFRESH_NS,
+// and once more after the output stops.
+void TerminalMultiplexer::update_terminal_context() {
+    const Screen &screen = screens[FOCUS_BASH];
+
+    if (screen.get_commands_done() == 0) {
+        const uint64_t due = context_published_at + TERMINAL_CONTEXT_REFRESH_NS;
+
+        if (context_timer_fd < 0 || monotonic_ns() >= due) {
+            publish_last_lines();
+        } else if (!context_timer_armed) {
+            itimerspec spec{};
+            spec.it_value.tv_sec = static_cast<time_t>(due / 1000000000ULL);
+            spec.it_value.tv_nsec = static_cast<long>(due % 1000000000ULL);
+
+            if (timerfd_settime(context_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+                perror("timerfd_settime");
+                exit(EXIT_FAILURE);
+            }
+            context_timer_armed = true;
+        }
+        return;
+    }
+
+    if (screen.get_commands_done() == context_commands_done) {
+        return;
+    }
+
+    context_commands_done = screen.get_commands_done();
+
+    if (const CommandMark *mark = screen.last_finished_command(); mark != nullptr) {
+        publish_terminal_context(TERMINAL_CONTEXT_LAST_COMMAND, mark->exit_status, screen.read_text(mark->output, mark->done));
+    }
+}
+
+void TerminalMultiplexer::publish_last_lines() {
+    const Screen &screen = screens[FOCUS_BASH];
+
+    // Marks showed up meanwhile, the finished command is handed over instead
+    if (screen.get_commands_done() != 0) {
+        return;
+    }
+
+    context_published_at = monotonic_ns();
+    publish_terminal_context(TERMINAL_CONTEXT_LAST_LINES, -1, screen.last_lines(TERMINAL_CONTEXT_LINES));
+}
+
 int TerminalMultiplexer::handle_input() {
     /*
     problem when using wgetch: KEY_RESIZE does not wake up the epoll event.
@@ -524,64 +859,197 @@ int TerminalMultiplexer::handle_input() {
     therefore, read straight from stdin; do not use wgetch.
     */
 
-    std::vector<TerminalChar> chars;
-    const int n = read_and_escape(STDIN_FILENO, chars);
+    char buf[INPUT_READ_BUFSIZ];
+    const int n = static_cast<int>(read(STDIN_FILENO, buf, sizeof(buf)));
 
     if (n < 0) {
         perror("read");
         exit(EXIT_FAILURE);
     }
 
-    for (auto const &tch : chars) {
-        int const ch = toupper(tch.ch);
-        if (ch == 0x02) {
-            // Pressed ^B
-            waiting_for_command = true;
-        } else if (waiting_for_command) {
-            waiting_for_command = false;
-            if (ch == '\t') {
-                switch_focus();
-            } else if (ch == 'Z') {
-                if (!zoomed_in) {
-                    zoom_in();
-                } else {
-                    zoom_out();
-                }
-            } else if (ch == '[') {
-                toggle_manual_scroll();
+    if (recorder != nullptr) {
+        recorder->data(RECORD_STREAM_STDIN, buf, n);
+    }
+
+    int offset = 0;
+
+    while (offset < n) {
+        if (paste.active) {
+            // Paste payload is not interpreted, it streams to the target pane as is
+            std::string payload;
+            offset += scan_paste(paste, buf + offset, n - offset, payload);
+            handle_paste(payload);
+            continue;
+        }
+
+        std::vector<TerminalChar> chars;
+        offset += escape_buffer(STDIN_FILENO, buf + offset, n - offset, chars, true);
+
+        for (auto const &tch : chars) {
+            handle_key(tch);
+        }
+    }
+
+    // Everything typed in this read goes out in one write per pty
+    for (size_t i = 0; i < outbound.size(); i++) {
+        if (!outbound[i].empty()) {
+            flush_pty_input(static_cast<int>(i));
+        }
+    }
+
+    return n;
+}
+
+void TerminalMultiplexer::handle_key(const TerminalChar &tch) {
+    int const ch = toupper(tch.ch);
+
+    if (ch == E_KEY_PASTE_BEGIN) {
+        begin_paste();
+    } else if (ch == 0x02) {
+        // Pressed ^B
+        waiting_for_command = true;
+    } else if (waiting_for_command) {
+        waiting_for_command = false;
+        if (ch == '\t') {
+            switch_focus();
+        } else if (ch == 'Z') {
+            if (!zoomed_in) {
+                zoom_in();
+            } else {
+                zoom_out();
             }
-        } else if (focus != FOCUS_NULL) {
-            if (screens[focus].is_in_manual_scroll()) {
-                if (ch == E_KEY_CUU) {
-                    screens[focus].manual_scroll_up();
-                    refresh_cursor();
-                } else if (ch == E_KEY_CUD) {
-                    screens[focus].manual_scroll_down();
+        } else if (ch == '[') {
+            toggle_manual_scroll();
+        } else if (ch == 'H') {
+            toggle_hud();
+        }
+    } else if (focus != FOCUS_NULL) {
+        if (screens[focus].is_in_manual_scroll()) {
+            if (ch == E_KEY_CUU) {
+                screens[focus].manual_scroll_up();
+                refresh_cursor();
+            } else if (ch == E_KEY_CUD) {
+                screens[focus].manual_scroll_down();
+                refresh_cursor();
+            } else if (ch == 'P' || ch == 'N') {
+                // Previous or next command, from the shell integration marks
+                if (screens[focus].jump_to_prompt(ch == 'P')) {
                     refresh_cursor();
                 }
-            } else {
-                for (const char ch1 : tch.sequence) {
-                    handle_pty_input(screens[focus].get_pty_master(), ch1);
-                }
             }
+        } else {
+            handle_pty_input(focus, tch.sequence);
         }
     }
+}
 
-    return n;
+void TerminalMultiplexer::begin_paste() {
+    paste.active = true;
+    paste.matched = 0;
+    paste_stalled = false;
+    waiting_for_command = false;
+
+    // Pastes into a pane in manual scroll mode are dropped, like keys
+    paste_target = -1;
+    if (focus != FOCUS_NULL && !screens[focus].is_in_manual_scroll()) {
+        paste_target = focus;
+    }
+
+    // Only wrap the payload if the application asked for it
+    paste_wrapped = paste_target != -1 && screens[paste_target].is_bracketed_paste();
+    if (paste_wrapped) {
+        handle_pty_input(paste_target, PASTE_BEGIN_MARKER);
+    }
 }
 
-void TerminalMultiplexer::handle_pty_input(const int fd, const char ch) {
-    write(fd, &ch, 1);
+void TerminalMultiplexer::handle_paste(const std::string &payload) {
+    if (paste_target != -1) {
+        handle_pty_input(paste_target, payload);
+
+        if (!paste.active && paste_wrapped) {
+            handle_pty_input(paste_target, PASTE_END_MARKER);
+        }
+
+        // Stop reading the paste while the pane is not taking it
+        flush_pty_input(paste_target);
+        if (paste.active && !paste_stalled && !outbound[paste_target].empty()) {
+            pause_input(true);
+        }
+    }
+}
+
+void TerminalMultiplexer::pause_input(const bool paused) {
+    if (paused == input_paused || event_loop == nullptr) {
+        return;
+    }
+
+    event_loop->modify(STDIN_FILENO, paused ? 0 : EPOLLIN);
+    input_paused = paused;
+
+    // Armed while paused, disarmed (all zero) once reading again
+    itimerspec spec{};
+    if (paused) {
+        const uint64_t deadline = monotonic_ns() + PASTE_STALL_NS;
+        spec.it_value.tv_sec = static_cast<time_t>(deadline / 1000000000ULL);
+        spec.it_value.tv_nsec = static_cast<long>(deadline % 1000000000ULL);
+    }
+
+    if (timerfd_settime(paste_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        perror("timerfd_settime");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void TerminalMultiplexer::handle_pty_input(const int index, const std::string &data) {
+    if (!outbound[index].push(data)) {
+        // The pty has not been accepting input for a while, the queue is full
+        beep();
+    }
+}
+
+void TerminalMultiplexer::flush_pty_input(const int index) {
+    const int fd = screens[index].get_pty_master();
+
+    // Errors are left to the read side, which sees the pty closing
+    const bool pending = outbound[index].flush(fd) > 0;
+
+    if (!pending && index == paste_target) {
+        // The pane took everything, continue reading the paste
+        pause_input(false);
+    }
+
+    if (pending == watching_output[index] || event_loop == nullptr) {
+        return;
+    }
+
+    // Wait for the kernel buffer to drain only while something is queued
+    if (pending) {
+        event_loop->add(fd, EPOLLOUT);
+    } else {
+        event_loop->remove(fd);
+    }
+
+    watching_output[index] = pending;
 }
 
 void TerminalMultiplexer::zoom_in() {
     zoomed_in = true;
-    resize();
+    relayout();
 }
 
 void TerminalMultiplexer::zoom_out() {
     zoomed_in = false;
-    resize();
+    relayout();
+}
+
+// Only pane heights change, so the panes keep their layout and just show more or fewer lines
+void TerminalMultiplexer::relayout() {
+    TRACE_SPAN("relayout");
+
+    clear();
+    refresh();
+    create_wins_draw(false);
+    send_dims();
 }
 
 void TerminalMultiplexer::toggle_manual_scroll() {
@@ -594,4 +1062,87 @@ void TerminalMultiplexer::toggle_manual_scroll() {
             refresh_cursor();
         }
     }
-}
\ No newline at end of file
+}
+
+void TerminalMultiplexer::toggle_hud() {
+    if (hud_timer_fd < 0) {
+        return;
+    }
+
+    hud_visible = !hud_visible;
+
+    itimerspec spec{};
+    if (hud_visible) {
+        spec.it_value.tv_sec = HUD_REFRESH_NS / 1000000000ULL;
+        spec.it_value.tv_nsec = HUD_REFRESH_NS % 1000000000ULL;
+        spec.it_interval = spec.it_value;
+
+        // Rates start from now
+        hud_samples.clear();
+        update_hud();
+    }
+
+    // A zero value disarms the timer, a hidden HUD costs nothing
+    if (timerfd_settime(hud_timer_fd, 0, &spec, nullptr) == -1) {
+        perror("timerfd_settime");
+        exit(EXIT_FAILURE);
+    }
+
+    draw_bottom_bar();
+    refresh_cursor();
+}
+
+void TerminalMultiplexer::update_hud() {
+    const char *names[] = {"agent", "bash"};
+
+    const uint64_t now = monotonic_ns();
+    const double seconds = static_cast<double>(now - hud_sampled_at) / 1e9;
+    const bool first = hud_samples.empty();
+
+    hud_samples.resize(pane_stats.size());
+    hud_text = "ishell";
+
+    for (size_t i = 0; i < pane_stats.size(); i++) {
+        const PaneStats &stats = pane_stats[i];
+        PaneSample sample = {stat_get(stats.bytes), stat_get(stats.parse_ns), stat_get(stats.chars), stat_get(stats.frames)};
+        const PaneSample &last = hud_samples[i];
+
+        double bytes = 0, chars = 0, frames = 0, parse_per_byte = 0;
+        if (!first && seconds > 0) {
+            bytes = static_cast<double>(sample.bytes - last.bytes) / seconds;
+            chars = static_cast<double>(sample.chars - last.chars) / seconds;
+            frames = static_cast<double>(sample.frames - last.frames) / seconds;
+        }
+
+        if (!first && sample.bytes > last.bytes) {
+            parse_per_byte = static_cast<double>(sample.parse_ns - last.parse_ns) / static_cast<double>(sample.bytes - last.bytes);
+        }
+
+        char parse[32];
+        snprintf(parse, sizeof(parse), "%.1fns/B", parse_per_byte);
+
+        hud_text += std::string(" | ") + (i < 2 ? names[i] : "pane") + " " + format_rate(bytes, "B") + " " +
+                    format_rate(chars, "ch") + " " + parse + " " + format_rate(frames, "f") + " last " +
+                    format_ns(stat_get(stats.last_frame_ns));
+
+        hud_samples[i] = sample;
+    }
+
+    hud_text += " | loop p99 " + format_ns(loop_stats.turn_latency.percentile(0.99));
+    loop_stats.turn_latency.reset();
+
+    hud_text += " | input max " + format_ns(loop_stats.max_input_latency_ns);
+    loop_stats.max_input_latency_ns = 0;
+
+    hud_text += " | request ";
+    if (const uint64_t start = shared_perf_stats != nullptr ? stat_get(shared_perf_stats->agent_request_start_ns) : 0; start != 0) {
+        hud_text += format_ns(now - std::min(now, start));
+    } else {
+        hud_text += "-";
+    }
+
+    hud_sampled_at = now;
+
+    draw_bottom_bar();
+    refresh_cursor();
+}
@@ -0,0 +1,146 @@
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <spsc_queue.hpp>
+#include <trace.hpp>
+
+std::atomic<bool> trace_enabled{false};
+
+namespace {
+
+// Events of one thread, drained by the flusher
+struct ThreadBuffer {
+    SpscQueue<TraceEvent> events{TRACE_BUFFER_EVENTS};
+    pid_t tid = 0;
+
+    // Events lost to a full buffer
+    std::atomic<uint64_t> dropped{0};
+};
+
+std::mutex registry_mutex;
+
+// Kept for the life of the process, threads may still hold on to theirs after a stop
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+thread_local ThreadBuffer *local_buffer = nullptr;
+
+FILE *trace_file = nullptr;
+std::thread flusher;
+std::mutex flusher_mutex;
+std::condition_variable flusher_wake;
+bool flusher_stopping = false;
+
+ThreadBuffer *register_thread() {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+    std::lock_guard lock(registry_mutex);
+    buffers.push_back(std::move(buffer));
+    return buffers.back().get();
+}
+
+// Flusher only, or after it stopped
+void drain() {
+    std::lock_guard lock(registry_mutex);
+    const pid_t pid = getpid();
+
+    for (const auto &buffer : buffers) {
+        TraceEvent event;
+        while (buffer->events.pop(event)) {
+            fprintf(trace_file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f},\n",
+                    event.name, pid, buffer->tid, event.start_ns / 1e3, (event.end_ns - event.start_ns) / 1e3);
+        }
+    }
+
+    fflush(trace_file);
+}
+
+void run_flusher() {
+    std::unique_lock lock(flusher_mutex);
+
+    while (!flusher_stopping) {
+        flusher_wake.wait_for(lock, std::chrono::nanoseconds(TRACE_FLUSH_NS));
+
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+}
+
+void trace_record(const char *name, const uint64_t start_ns, const uint64_t end_ns) {
+    if (local_buffer == nullptr) {
+        local_buffer = register_thread();
+    }
+
+    TraceEvent event = {name, start_ns, end_ns};
+    if (!local_buffer->events.push(event)) {
+        local_buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool trace_start(const std::string &path) {
+    if (trace_file != nullptr) {
+        return true;
+    }
+
+    trace_file = fopen(path.c_str(), "w");
+    if (trace_file == nullptr) {
+        perror("fopen: trace");
+        return false;
+    }
+
+    // The array format tolerates a missing "]", so a process killed before trace_stop() still leaves a usable trace
+    fprintf(trace_file, "[\n");
+
+    flusher_stopping = false;
+    flusher = std::thread(run_flusher);
+    trace_enabled = true;
+
+    return true;
+}
+
+void trace_start_from_env(const std::string &suffix) {
+    if (const char *path = getenv("ISHELL_TRACE"); path != nullptr && *path != '\0') {
+        trace_start(path + suffix);
+    }
+}
+
+void trace_stop() {
+    if (trace_file == nullptr) {
+        return;
+    }
+
+    trace_enabled = false;
+
+    {
+        std::lock_guard lock(flusher_mutex);
+        flusher_stopping = true;
+    }
+
+    flusher_wake.notify_one();
+    flusher.join();
+
+    drain();
+
+    uint64_t dropped = 0;
+    for (const auto &buffer : buffers) {
+        dropped += buffer->dropped.exchange(0);
+    }
+
+    // Ends the array without a trailing comma
+    fprintf(trace_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"ishell\",\"dropped_events\":%lu}}\n]\n",
+            getpid(), dropped);
+
+    fclose(trace_file);
+    trace_file = nullptr;
+}
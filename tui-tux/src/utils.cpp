@@ -1,3 +1,5 @@
+#include <ctime>
+
 #include <utils.hpp>
 
 std::vector<std::string> split(std::string &str, char delim, bool ignore_empty) {
@@ -38,3 +40,9 @@ std::string join(std::vector<std::string> &words, const char delim) {
 
     return str;
 }
+
+uint64_t monotonic_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
@@ -0,0 +1,154 @@
+#ifndef ISHELL_TEST_LOOPBACK_SERVER
+#define ISHELL_TEST_LOOPBACK_SERVER
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Listens on a loopback port for the tests and runs the handler on a thread of its own for each
+// connection it accepts. The connection is closed once the handler returns. Without a handler
+// connections are left in the backlog (the kernel accepts them) and never answered.
+class LoopbackServer {
+public:
+    using Handler = std::function<void(int client)>;
+
+    // One request read off a connection
+    struct Request {
+        std::string head;
+        std::string body;
+    };
+
+    explicit LoopbackServer(Handler handler = nullptr, const std::string &path = "/") : handler(std::move(handler)) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        listen(fd, 16);
+
+        socklen_t len = sizeof(addr);
+        getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+        url = "http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)) + path;
+
+        if (this->handler) {
+            thread = std::thread(&LoopbackServer::run, this);
+        }
+    }
+
+    ~LoopbackServer() {
+        stopping = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+
+        // Handlers blocked on a read of their connection return
+        {
+            std::lock_guard guard(mutex);
+            for (const int client : open_clients) {
+                shutdown(client, SHUT_RDWR);
+            }
+        }
+
+        for (std::thread &client : clients) {
+            client.join();
+        }
+        close(fd);
+    }
+
+    LoopbackServer(const LoopbackServer &) = delete;
+    LoopbackServer &operator=(const LoopbackServer &) = delete;
+
+    // Reads the next request on the connection, its body as long as Content-Length says. What
+    // came after it stays in buffer. False once the connection is closed before a whole request.
+    static bool read_request(const int client, std::string &buffer, Request &request) {
+        while (true) {
+            if (const size_t head_end = buffer.find("\r\n\r\n"); head_end != std::string::npos) {
+                size_t length = 0;
+                if (const size_t pos = buffer.find("Content-Length: "); pos != std::string::npos && pos < head_end) {
+                    length = std::strtoul(buffer.c_str() + pos + 16, nullptr, 10);
+                }
+
+                if (buffer.size() >= head_end + 4 + length) {
+                    request.head = buffer.substr(0, head_end + 4);
+                    request.body = buffer.substr(head_end + 4, length);
+                    buffer.erase(0, head_end + 4 + length);
+                    return true;
+                }
+            }
+
+            char buf[4096];
+            const ssize_t n = read(client, buf, sizeof(buf));
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(buf, n);
+        }
+    }
+
+    // Without SIGPIPE, the client may have gone already
+    static void send_all(const int client, const std::string &data) {
+        for (size_t sent = 0; sent < data.size();) {
+            const ssize_t n = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            sent += n;
+        }
+    }
+
+    std::string url;
+    std::atomic<int> accepted{0};
+
+private:
+    int fd;
+    Handler handler;
+
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+    std::vector<std::thread> clients;
+
+    std::mutex mutex;
+    std::set<int> open_clients;
+
+    void run() {
+        while (!stopping) {
+            pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 20) <= 0) {
+                continue;
+            }
+
+            const int client = accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+
+            {
+                std::lock_guard guard(mutex);
+                open_clients.insert(client);
+            }
+            accepted++;
+
+            clients.emplace_back([this, client] {
+                handler(client);
+
+                std::lock_guard guard(mutex);
+                open_clients.erase(client);
+                close(client);
+            });
+        }
+    }
+};
+
+#endif
@@ -10,7 +10,8 @@
 
 class MockAgencyRequestWrapper final : public AgencyRequestWrapper {
 public:
-    MOCK_METHOD(std::string, ask_agent, (const std::string& url, const std::string& query, (std::vector<std::pair<std::string, std::string>> &session_history)), (override));
+    MOCK_METHOD(std::string, ask_agent, (const std::string& url, const std::string& query, (const SessionHistory &session_history)), (override));
+    MOCK_METHOD(void, prewarm, (const std::string& url), (override));
 };
 
 class AgencyManagerTest : public ::testing::Test {
@@ -64,7 +65,7 @@ TEST_F(AgencyManagerTest, ExecuteQuery_SuccessfullyCallsAgent) {
     // arrange
     setenv("ISHELL_AGENCY_URL", "http://localhost:5000", 1);
     const std::string url = agency_manager.get_agency_url();
-    EXPECT_CALL(mock_request_wrapper, ask_agent("http://localhost:5000/assistant", "test query", agency_manager.session_history))
+    EXPECT_CALL(mock_request_wrapper, ask_agent("http://localhost:5000/assistant", "test query", ::testing::Ref(agency_manager.session_history)))
         .WillOnce(::testing::Return("agent response"));
     // act
     const std::string result = agency_manager.execute_query(url + "/assistant", "test query");
@@ -77,7 +78,7 @@ TEST_F(AgencyManagerTest, ExecuteQuery_AddsToSessionHistory) {
     // arrange
     setenv("ISHELL_AGENCY_URL", "http://localhost:5000", 1);
     const std::string url = agency_manager.get_agency_url();
-    EXPECT_CALL(mock_request_wrapper, ask_agent("http://localhost:5000/assistant", "test query", agency_manager.session_history))
+    EXPECT_CALL(mock_request_wrapper, ask_agent("http://localhost:5000/assistant", "test query", ::testing::Ref(agency_manager.session_history)))
         .WillOnce(::testing::Return("agent response"));
     // act
     std::string result = agency_manager.execute_query(url + "/assistant", "test query");
@@ -92,7 +93,7 @@ TEST_F(AgencyManagerTest, ExecuteQuery_AskAgentFails) {
     // arrange
     setenv("ISHELL_AGENCY_URL", "http://localhost:5000", 1);
     const std::string url = agency_manager.get_agency_url();
-    EXPECT_CALL(mock_request_wrapper, ask_agent("http://localhost:5000/assistant", "test query", agency_manager.session_history))
+    EXPECT_CALL(mock_request_wrapper, ask_agent("http://localhost:5000/assistant", "test query", ::testing::Ref(agency_manager.session_history)))
         .WillOnce(::testing::Return(""));
     // act
     const std::string result = agency_manager.execute_query(url + "/assistant", "test query");
@@ -102,3 +103,13 @@ TEST_F(AgencyManagerTest, ExecuteQuery_AskAgentFails) {
     EXPECT_EQ(agency_manager.session_history[0].first, "test query");
     EXPECT_EQ(agency_manager.session_history[0].second, "");
 }
+
+// Test case: Prewarming connects to the endpoint of the current agent.
+TEST_F(AgencyManagerTest, Prewarm_UsesAgentEndpoint) {
+    setenv("ISHELL_AGENCY_URL", "https://agency.test", 1);
+    agency_manager.set_agent_name("inspector");
+
+    EXPECT_CALL(mock_request_wrapper, prewarm("https://agency.test/inspector"));
+
+    agency_manager.prewarm();
+}
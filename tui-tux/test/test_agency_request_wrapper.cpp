@@ -1,8 +1,12 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <iostream>
+#include <sstream>
+
 #include <agency_request_wrapper.hpp>
 #include <https_client.hpp>
+#include <utils.hpp>
 
 using namespace testing;
 
@@ -13,10 +17,11 @@ public:
                        const json& body,
                        (const std::map<std::string, std::string>&) headers), (override));
     MOCK_METHOD(std::string, get_linux_distro, (), (override));
-    MOCK_METHOD(std::vector<std::string>, get_installed_packages, (), (override));
+    MOCK_METHOD(std::shared_ptr<const PackageIndex>, get_package_index, (), (override));
     MOCK_METHOD(std::string, get_ssh_ip, (), (override));
     MOCK_METHOD(int, get_ssh_port, (), (override));
     MOCK_METHOD(std::string, get_ssh_user, (), (override));
+    MOCK_METHOD(TerminalContext, get_terminal_context, (), (override));
 };
 
 class MockAgencyRequestWrapper2 : public AgencyRequestWrapper {
@@ -28,13 +33,23 @@ public:
     MOCK_METHOD(char *, getenv, (const char *), (override));
 };
 
+class MockAgencyRequestWrapper3 : public AgencyRequestWrapper {
+public:
+    MOCK_METHOD(json, make_http_request, (HttpRequestType request_type, const std::string& url,
+                       (const std::map<std::string, std::string>&) query_params,
+                       const json& body,
+                       (const std::map<std::string, std::string>&) headers), (override));
+    MOCK_METHOD(std::shared_ptr<const PackageIndex>, get_package_index, (), (override));
+    MOCK_METHOD(TerminalContext, get_terminal_context, (), (override));
+};
+
 class AgencyRequestWrapperTest : public Test {
 protected:
     MockAgencyRequestWrapper1 mock_agency_request_wrapper1;
     MockAgencyRequestWrapper2 mock_agency_request_wrapper2;
+    MockAgencyRequestWrapper3 mock_agency_request_wrapper3;
 
     std::string distro = "Test Distro";
-    std::vector<std::string> packages = {"Test Package"};
     std::string ssh_ip = "0.0.0.0";
     int ssh_port = 0;
     std::string ssh_user = "test_user";
@@ -42,15 +57,13 @@ protected:
     std::string url = "0.0.0.1";
     std::string query = "Test Query";
 
-    std::vector<std::pair<std::string, std::string>> session_history;
+    SessionHistory session_history;
 };
 
-// Test case: Successfully creates a request with the correct data fields (distro, installed_packages, query, ssh_ip, ssh_port, ssh_user).
+// Test case: Successfully creates a request with the correct data fields (distro, query, ssh_ip, ssh_port, ssh_user).
 TEST_F(AgencyRequestWrapperTest, CorrectRequestData) {
     EXPECT_CALL(mock_agency_request_wrapper1, get_linux_distro())
         .WillOnce(Return(distro));
-    EXPECT_CALL(mock_agency_request_wrapper1, get_installed_packages())
-        .WillOnce(Return(packages));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_ip())
         .WillOnce(Return(ssh_ip));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_port())
@@ -58,14 +71,27 @@ TEST_F(AgencyRequestWrapperTest, CorrectRequestData) {
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_user())
         .WillOnce(Return(ssh_user));
 
+    // Nothing shown in the bash window, no terminal_context field
+    EXPECT_CALL(mock_agency_request_wrapper1, get_terminal_context())
+        .WillOnce(Return(TerminalContext()));
+
+    // Nothing acknowledged yet, the context goes in full along with its hash
+    json context = {
+        {"distro", distro},
+        {"ssh_ip", ssh_ip},
+        {"ssh_port", ssh_port},
+        {"ssh_user", ssh_user}
+    };
+
     json request_body = {
         {"distro", distro},
-        {"installed_packages", packages},
         {"query", query},
         {"ssh_ip", ssh_ip},
         {"ssh_port", ssh_port},
         {"ssh_user", ssh_user},
-        {"session_history", ""}
+        {"session_history", ""},
+        {"tools", {"package_installed", "package_version", "package_owner"}},
+        {"context_hash", ContextHandshake::fingerprint(context)}
     };
 
     json body = {
@@ -131,8 +157,6 @@ TEST_F(AgencyRequestWrapperTest, EmptyFields) {
 TEST_F(AgencyRequestWrapperTest, CorrectHeaders) {
     EXPECT_CALL(mock_agency_request_wrapper1, get_linux_distro())
         .WillOnce(Return(distro));
-    EXPECT_CALL(mock_agency_request_wrapper1, get_installed_packages())
-        .WillOnce(Return(packages));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_ip())
         .WillOnce(Return(ssh_ip));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_port())
@@ -141,7 +165,8 @@ TEST_F(AgencyRequestWrapperTest, CorrectHeaders) {
         .WillOnce(Return(ssh_user));
 
     std::map<std::string, std::string> headers = {
-        {"Content-Type", "application/json"}
+        {"Content-Type", "application/json"},
+        {"Accept", "text/event-stream, application/x-ndjson, application/json"}
     };
 
     json body = {
@@ -165,8 +190,6 @@ TEST_F(AgencyRequestWrapperTest, CorrectHeaders) {
 TEST_F(AgencyRequestWrapperTest, SuccessfulRequest) {
     EXPECT_CALL(mock_agency_request_wrapper1, get_linux_distro())
         .WillOnce(Return(distro));
-    EXPECT_CALL(mock_agency_request_wrapper1, get_installed_packages())
-        .WillOnce(Return(packages));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_ip())
         .WillOnce(Return(ssh_ip));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_port())
@@ -200,8 +223,6 @@ TEST_F(AgencyRequestWrapperTest, SuccessfulRequest) {
 TEST_F(AgencyRequestWrapperTest, ResponseError) {
     EXPECT_CALL(mock_agency_request_wrapper1, get_linux_distro())
         .WillOnce(Return(distro));
-    EXPECT_CALL(mock_agency_request_wrapper1, get_installed_packages())
-        .WillOnce(Return(packages));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_ip())
         .WillOnce(Return(ssh_ip));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_port())
@@ -240,8 +261,6 @@ TEST_F(AgencyRequestWrapperTest, ResponseError) {
 TEST_F(AgencyRequestWrapperTest, ResponseNoContent) {
     EXPECT_CALL(mock_agency_request_wrapper1, get_linux_distro())
         .WillOnce(Return(distro));
-    EXPECT_CALL(mock_agency_request_wrapper1, get_installed_packages())
-        .WillOnce(Return(packages));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_ip())
         .WillOnce(Return(ssh_ip));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_port())
@@ -277,8 +296,6 @@ TEST_F(AgencyRequestWrapperTest, ResponseNoContent) {
 TEST_F(AgencyRequestWrapperTest, ValidJSON) {
     EXPECT_CALL(mock_agency_request_wrapper1, get_linux_distro())
         .WillOnce(Return(distro));
-    EXPECT_CALL(mock_agency_request_wrapper1, get_installed_packages())
-        .WillOnce(Return(packages));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_ip())
         .WillOnce(Return(ssh_ip));
     EXPECT_CALL(mock_agency_request_wrapper1, get_ssh_port())
@@ -303,4 +320,151 @@ TEST_F(AgencyRequestWrapperTest, ValidJSON) {
     json result = mock_agency_request_wrapper1.send_request_to_agent_server(url, query, session_history);
 
     EXPECT_TRUE(result.contains("body") && result["body"].contains("content") && result["body"]["content"] == "Test JSON");
-};
\ No newline at end of file
+};
+
+// Test case: The bash window's last command output goes along as a structured field.
+TEST_F(AgencyRequestWrapperTest, AttachesTerminalContext) {
+    TerminalContext context;
+    context.source = TERMINAL_CONTEXT_LAST_COMMAND;
+    context.exit_status = 1;
+    context.output = "make: *** No targets specified\n";
+
+    EXPECT_CALL(mock_agency_request_wrapper3, get_terminal_context())
+        .WillOnce(Return(context));
+
+    json terminal_context = {
+        {"source", "last_command"},
+        {"output", context.output},
+        {"truncated", false},
+        {"exit_status", 1}
+    };
+
+    json request;
+
+    EXPECT_CALL(mock_agency_request_wrapper3, make_http_request(HttpRequestType::POST, url, _, _, _))
+        .WillOnce(DoAll(SaveArg<3>(&request), Return(json{{"body", {{"content", "Run make with a target"}}}})));
+
+    EXPECT_EQ(mock_agency_request_wrapper3.ask_agent(url, query, session_history), "Run make with a target");
+    EXPECT_EQ(request["terminal_context"], terminal_context);
+};
+
+// Test case: The agency's package lookups are answered and the request sent again with the results.
+TEST_F(AgencyRequestWrapperTest, AnswersToolCalls) {
+    const auto index = std::make_shared<PackageIndex>(
+        std::vector<PackageRecord>{{"curl", "8.5.0", "installed"}}, PackageFormat::None, "");
+
+    EXPECT_CALL(mock_agency_request_wrapper3, get_package_index())
+        .WillRepeatedly(Return(index));
+    EXPECT_CALL(mock_agency_request_wrapper3, get_terminal_context())
+        .WillOnce(Return(TerminalContext()));
+
+    const json tool_calls = json::parse(R"([
+        {"id": "a", "name": "package_version", "arguments": {"package": "curl"}},
+        {"id": "b", "name": "package_installed", "arguments": {"package": "nano"}},
+        {"id": "c", "name": "package_owner", "arguments": {"path": "/usr/bin/curl"}},
+        {"id": "d", "name": "reboot", "arguments": {}}
+    ])");
+
+    json second_request;
+
+    EXPECT_CALL(mock_agency_request_wrapper3, make_http_request(HttpRequestType::POST, url, _, _, _))
+        .WillOnce(Return(json{{"body", {{"tool_calls", tool_calls}}}}))
+        .WillOnce(DoAll(SaveArg<3>(&second_request), Return(json{{"body", {{"content", "curl 8.5.0 is installed"}}}})));
+
+    EXPECT_EQ(mock_agency_request_wrapper3.ask_agent(url, query, session_history), "curl 8.5.0 is installed");
+
+    const json expected = json::parse(R"([
+        {"id": "a", "result": {"installed": true, "version": "8.5.0"}},
+        {"id": "b", "result": {"installed": false}},
+        {"id": "c", "result": {"package": null}},
+        {"id": "d", "error": "unknown tool: reboot"}
+    ])");
+    EXPECT_EQ(second_request["tool_results"], expected);
+    EXPECT_EQ(second_request["query"], query);
+};
+
+// Test case: An agency that keeps asking gets an error naming the tool-round limit, not a missing content field.
+TEST_F(AgencyRequestWrapperTest, BoundsToolRounds) {
+    EXPECT_CALL(mock_agency_request_wrapper3, get_terminal_context())
+        .WillOnce(Return(TerminalContext()));
+
+    const json asking = {{"body", {{"tool_calls", json::parse(R"([{"id": "1", "name": "package_installed", "arguments": {"package": "vim"}}])")}}}};
+
+    EXPECT_CALL(mock_agency_request_wrapper3, make_http_request(HttpRequestType::POST, url, _, _, _))
+        .Times(AGENT_TOOL_ROUNDS + 1)
+        .WillRepeatedly(Return(asking));
+
+    std::stringstream error_stream;
+    std::streambuf *original_cerr = std::cerr.rdbuf(error_stream.rdbuf());
+    EXPECT_EQ(mock_agency_request_wrapper3.ask_agent(url, query, session_history), "");
+    std::cerr.rdbuf(original_cerr);
+    const std::string errors = error_stream.str();
+
+    EXPECT_NE(errors.find("tool calls after " + std::to_string(AGENT_TOOL_ROUNDS) + " rounds"), std::string::npos) << errors;
+    EXPECT_EQ(errors.find("\"content\" field not found"), std::string::npos) << errors;
+};
+
+// Test case: A tool call that is not an object is answered with an error.
+TEST_F(AgencyRequestWrapperTest, ToolCallNotAnObject) {
+    json result;
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call("package_installed"));
+    EXPECT_EQ(result, json::parse(R"({"id": null, "error": "tool call is not an object"})"));
+
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call(json::array({1, 2})));
+    EXPECT_TRUE(result.contains("error"));
+};
+
+// Test case: A tool call whose name is missing or not a string is answered with an error.
+TEST_F(AgencyRequestWrapperTest, ToolCallNameNotAString) {
+    json result;
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call(json::parse(R"({"id": "1", "name": 7})")));
+    EXPECT_EQ(result, json::parse(R"({"id": "1", "error": "tool call without a name"})"));
+
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call(json::parse(R"({"id": "2"})")));
+    EXPECT_EQ(result["error"], "tool call without a name");
+};
+
+// Test case: Tool call arguments that are not an object are answered with an error.
+TEST_F(AgencyRequestWrapperTest, ToolCallArgumentsNotAnObject) {
+    json result;
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call(
+        json::parse(R"({"id": "1", "name": "package_installed", "arguments": "curl"})")));
+    EXPECT_EQ(result, json::parse(R"({"id": "1", "error": "tool call arguments are not an object"})"));
+};
+
+// Test case: A package argument that is missing or not a string is answered with an error.
+TEST_F(AgencyRequestWrapperTest, ToolCallPackageNotAString) {
+    json result;
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call(
+        json::parse(R"({"id": "1", "name": "package_version", "arguments": {"package": ["curl"]}})")));
+    EXPECT_EQ(result, json::parse(R"({"id": "1", "error": "package must be a string"})"));
+
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call(json::parse(R"({"id": "2", "name": "package_installed"})")));
+    EXPECT_EQ(result["error"], "package must be a string");
+};
+
+// Test case: A path argument that is not a string is answered with an error.
+TEST_F(AgencyRequestWrapperTest, ToolCallPathNotAString) {
+    json result;
+    EXPECT_NO_THROW(result = mock_agency_request_wrapper3.run_tool_call(
+        json::parse(R"({"id": "1", "name": "package_owner", "arguments": {"path": null}})")));
+    EXPECT_EQ(result, json::parse(R"({"id": "1", "error": "path must be a string"})"));
+};
+
+// Test case: Malformed entries among the tool calls do not stop the others from being answered.
+TEST_F(AgencyRequestWrapperTest, MalformedToolCallsAnswered) {
+    EXPECT_CALL(mock_agency_request_wrapper3, get_terminal_context())
+        .WillOnce(Return(TerminalContext()));
+
+    const json tool_calls = json::parse(R"([5, {"id": "b", "name": "package_installed", "arguments": {"package": "vim"}}])");
+    json second_request;
+
+    EXPECT_CALL(mock_agency_request_wrapper3, make_http_request(HttpRequestType::POST, url, _, _, _))
+        .WillOnce(Return(json{{"body", {{"tool_calls", tool_calls}}}}))
+        .WillOnce(DoAll(SaveArg<3>(&second_request), Return(json{{"body", {{"content", "done"}}}})));
+
+    EXPECT_EQ(mock_agency_request_wrapper3.ask_agent(url, query, session_history), "done");
+    ASSERT_EQ(second_request["tool_results"].size(), 2);
+    EXPECT_EQ(second_request["tool_results"][0]["error"], "tool call is not an object");
+    EXPECT_EQ(second_request["tool_results"][1]["result"]["installed"], false);
+};
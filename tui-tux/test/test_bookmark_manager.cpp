@@ -49,8 +49,8 @@ protected:
         mock_base_bookmark_manager.bookmarks.clear();
         mock_base_bookmark_manager.bookmarks["alias1"] = {"query1", "result1"};
         mock_agency_manager.session_history.clear();
-        mock_agency_manager.session_history.emplace_back("query1", "result1");
-        mock_agency_manager.session_history.emplace_back("query2", "result2");
+        mock_agency_manager.session_history.append("query1", "result1");
+        mock_agency_manager.session_history.append("query2", "result2");
     }
 
     void TearDown() override {
@@ -99,6 +99,22 @@ TEST_F(BookmarkTest, RemoveBookmark_SuccessfullyRemovesExistingBookmark) {
     ASSERT_EQ(mock_base_bookmark_manager.bookmarks.size(), MOCK_BOOKMARS_SIZE - 1);
 }
 
+// Test case: A removed bookmark stops pinning its turn, unless another bookmark saved it too.
+TEST_F(BookmarkTest, RemoveBookmark_UnpinsTurn) {
+    SessionHistory &session_history = mock_agency_manager.session_history;
+
+    mock_base_bookmark_manager.bookmark(1, "first");
+    mock_base_bookmark_manager.bookmark(1, "second");
+    ASSERT_TRUE(session_history.is_pinned(1));
+
+    mock_base_bookmark_manager.remove_bookmark("first");
+    EXPECT_TRUE(session_history.is_pinned(1));
+
+    mock_base_bookmark_manager.remove_bookmark("second");
+    EXPECT_FALSE(session_history.is_pinned(1));
+    EXPECT_TRUE(mock_base_bookmark_manager.pinned_turns.empty());
+}
+
 // Test case: Displays error if the alias does not exist.
 TEST_F(BookmarkTest, RemoveBookmark_ErrorWhenAliasNotFound) {
     // act
@@ -9,11 +9,11 @@
 
 using namespace testing;
 
-class MockAgencyManager final : public AgencyManager {
+class MockAgencyManager2 final : public AgencyManager {
 public:
-    explicit MockAgencyManager(AgencyRequestWrapper *agency_request_wrapper) : AgencyManager(agency_request_wrapper) {}
+    explicit MockAgencyManager2(AgencyRequestWrapper *agency_request_wrapper) : AgencyManager(agency_request_wrapper) {}
 
-    MOCK_METHOD(void, set_agent_name, (const std::string &agent_name), (override));
+    MOCK_METHOD(void, prewarm, (), (override));
 };
 
 class MockBookmarkManager final : public BookmarkManager {
@@ -39,7 +39,7 @@ public:
     BookmarkManager bookmark_manager;
     CommandManager command_manager;
 
-    MockAgencyManager mock_agency_manager;
+    MockAgencyManager2 mock_agency_manager;
     MockBookmarkManager mock_bookmark_manager;
     MockCommandManager mock_command_manager;
 
@@ -128,6 +128,26 @@ TEST_F(CommandManagerTest, Bookmark_DetectAlias) {
     EXPECT_TRUE(output_stream.str().find("result1") != std::string::npos);
 }
 
+// Test case: Running an alias again moves its pin to the latest run instead of pinning another copy.
+TEST_F(CommandManagerTest, Bookmark_AliasPinnedOnce) {
+    std::string alias = "alias1";
+    bookmark_manager.bookmarks[alias] = {"query1", "result1"};
+
+    for (int i = 0; i < 3; i++) {
+        command_manager.run_command(alias);
+    }
+
+    const SessionHistory &session_history = agency_manager.session_history;
+    ASSERT_EQ(session_history.size(), 3);
+    EXPECT_FALSE(session_history.is_pinned(0));
+    EXPECT_FALSE(session_history.is_pinned(1));
+    EXPECT_TRUE(session_history.is_pinned(2));
+
+    std::string command = "clear";
+    command_manager.run_command(command);
+    EXPECT_TRUE(bookmark_manager.pinned_turns.empty());
+}
+
 // Test case: Displays error for invalid bookmark command format.
 TEST_F(CommandManagerTest, Bookmark_DisplaysErrorForInvalidCommand) {
     std::string command = "bookmark";
@@ -137,7 +157,7 @@ TEST_F(CommandManagerTest, Bookmark_DisplaysErrorForInvalidCommand) {
 
 // Test case: Correctly parses clear command
 TEST_F(CommandManagerTest, Clear) {
-    mock_agency_manager.session_history.emplace_back("query", "result");
+    mock_agency_manager.session_history.append("query", "result");
     std::string command = "clear";
 
     mock_command_manager.run_command(command);
@@ -194,6 +214,9 @@ TEST_F(CommandManagerTest, HelpError) {
 TEST_F(CommandManagerTest, Switch) {
     setenv("ISHELL_AGENCY_URL", "localhost", 1);
 
+    // The new agent's connection is opened ahead of its first query
+    EXPECT_CALL(mock_agency_manager, prewarm());
+
     std::string command = "switch inspector";
     mock_command_manager.run_command(command);
 
@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <agency_request_wrapper.hpp>
+#include <context_handshake.hpp>
+#include <utils.hpp>
+
+#include "loopback_server.hpp"
+
+// Agency that keeps contexts by hash, as the handshake expects of a real one
+class StandInAgency {
+public:
+    StandInAgency() {
+        url = server.url;
+    }
+
+    // As after a restart
+    void forget() {
+        std::lock_guard guard(mutex);
+        contexts.clear();
+    }
+
+    std::string url;
+
+    // Request bodies in the order they came
+    std::vector<json> requests;
+
+private:
+    std::mutex mutex;
+    std::set<std::string> contexts;
+
+    // Last, so connections are done with before the rest goes
+    LoopbackServer server{[this](const int client) { serve(client); }, "/assistant"};
+
+    // Answers requests until the client closes the connection
+    void serve(const int client) {
+        std::string buffer;
+        LoopbackServer::Request request;
+
+        while (LoopbackServer::read_request(client, buffer, request)) {
+            const json body = json::parse(request.body);
+
+            {
+                std::lock_guard guard(mutex);
+                requests.push_back(body);
+            }
+            respond(client, body);
+        }
+    }
+
+    void respond(const int client, const json &body) {
+        const std::string hash = body["context_hash"];
+        bool known = true;
+
+        {
+            std::lock_guard guard(mutex);
+
+            if (body.contains("distro")) {
+                contexts.insert(hash);
+            } else {
+                known = contexts.find(hash) != contexts.end();
+            }
+        }
+
+        // Asks whether the package in the query is installed, and answers with what it was told
+        json answer = {{"content", "ok"}};
+        const std::string query = body["query"];
+        if (query.rfind("installed ", 0) == 0) {
+            if (!body.contains("tool_results")) {
+                answer = {{"tool_calls", {{{"id", "1"}, {"name", "package_installed"}, {"arguments", {{"package", query.substr(10)}}}}}}};
+            } else {
+                answer = {{"content", body["tool_results"][0]["result"]["installed"].get<bool>() ? "yes" : "no"}};
+            }
+        } else if (query == "keep asking") {
+            // Never satisfied with the answers
+            answer = {{"tool_calls", {{{"id", "1"}, {"name", "package_installed"}, {"arguments", {{"package", "vim"}}}}}}};
+        }
+
+        std::string response;
+        if (known) {
+            const std::string content = answer.dump();
+            response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\ncontext-hash: " + hash +
+                       "\r\nContent-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+        } else {
+            const std::string content = json({{"error", "unknown_context"}}).dump();
+            response = "HTTP/1.1 409 Conflict\r\nContent-Type: application/json\r\n"
+                       "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+        }
+
+        LoopbackServer::send_all(client, response);
+    }
+};
+
+// Fixed context, no environment or package database involved
+class FixedContextWrapper final : public AgencyRequestWrapper {
+public:
+    std::vector<PackageRecord> packages = {{"bash", "5.2", "installed"}, {"curl", "8.5.0", "installed"}};
+
+    std::string get_linux_distro() override { return "Linux 6.1"; }
+    std::shared_ptr<const PackageIndex> get_package_index() override {
+        return std::make_shared<PackageIndex>(packages, PackageFormat::None, "");
+    }
+    std::string get_ssh_ip() override { return "10.0.0.1"; }
+    int get_ssh_port() override { return 22; }
+    std::string get_ssh_user() override { return "user"; }
+    TerminalContext get_terminal_context() override { return {}; }
+};
+
+class ContextHandshakeTest : public testing::Test {
+public:
+    ContextHandshake handshake;
+    json context = {{"distro", "Linux 6.1"}, {"ssh_ip", "10.0.0.1"}, {"ssh_port", 22}, {"ssh_user", "user"}};
+
+    // Response acknowledging the hash of the last request
+    static json ack(const json &body) {
+        return {{"status_code", 200}, {"headers", {{"context-hash", body["context_hash"]}}}, {"body", {{"content", "ok"}}}};
+    }
+};
+
+// Test case: The hash does not depend on the order fields were added in.
+TEST_F(ContextHandshakeTest, FingerprintIsStable) {
+    json reordered;
+    reordered["ssh_user"] = "user";
+    reordered["ssh_port"] = 22;
+    reordered["ssh_ip"] = "10.0.0.1";
+    reordered["distro"] = "Linux 6.1";
+
+    EXPECT_EQ(ContextHandshake::fingerprint(context), ContextHandshake::fingerprint(reordered));
+    reordered["ssh_port"] = 2222;
+    EXPECT_NE(ContextHandshake::fingerprint(context), ContextHandshake::fingerprint(reordered));
+    EXPECT_EQ(ContextHandshake::fingerprint(context).size(), 16);
+}
+
+// Test case: Sent in full until acknowledged, then only by hash.
+TEST_F(ContextHandshakeTest, HashOnlyOnceAcknowledged) {
+    json first;
+    handshake.attach(first, context);
+    EXPECT_EQ(first["distro"], "Linux 6.1");
+    EXPECT_FALSE(first.contains("installed_packages"));
+
+    // Not acknowledged, an agency that does not know the handshake
+    EXPECT_FALSE(handshake.on_response({{"status_code", 200}, {"headers", json::object()}, {"body", {{"content", "ok"}}}}));
+
+    json second;
+    handshake.attach(second, context);
+    EXPECT_TRUE(second.contains("distro"));
+    EXPECT_FALSE(handshake.on_response(ack(second)));
+
+    json third;
+    handshake.attach(third, context);
+    EXPECT_EQ(third, json({{"context_hash", second["context_hash"]}}));
+}
+
+// Test case: A changed context is sent in full.
+TEST_F(ContextHandshakeTest, ContextChangeSendsFull) {
+    json first;
+    handshake.attach(first, context);
+    handshake.on_response(ack(first));
+
+    context["ssh_user"] = "root";
+
+    json second;
+    handshake.attach(second, context);
+    EXPECT_EQ(second["ssh_user"], "root");
+    EXPECT_NE(second["context_hash"], first["context_hash"]);
+}
+
+// Test case: An agency that lost the context asks for it again, but never in a loop.
+TEST_F(ContextHandshakeTest, UnknownContext) {
+    const json unknown = {{"status_code", 409}, {"body", {{"error", "unknown_context"}}}};
+
+    json first;
+    handshake.attach(first, context);
+    handshake.on_response(ack(first));
+
+    json second;
+    handshake.attach(second, context);
+    EXPECT_TRUE(handshake.on_response(unknown));
+
+    json third;
+    handshake.attach(third, context);
+    EXPECT_TRUE(third.contains("distro"));
+
+    // Refused in full too, sending it again would not help
+    EXPECT_FALSE(handshake.on_response(unknown));
+}
+
+// Test case: Against a stand-in agency, the context goes over once and packages are asked about.
+TEST_F(ContextHandshakeTest, StandInAgency) {
+    StandInAgency agency;
+    FixedContextWrapper wrapper;
+    SessionHistory history;
+
+    EXPECT_EQ(wrapper.ask_agent(agency.url, "first", history), "ok");
+    EXPECT_EQ(wrapper.ask_agent(agency.url, "installed curl", history), "yes");
+    EXPECT_EQ(wrapper.ask_agent(agency.url, "installed nano", history), "no");
+
+    // Lost after a restart, sent once more in full
+    agency.forget();
+    EXPECT_EQ(wrapper.ask_agent(agency.url, "fourth", history), "ok");
+
+    ASSERT_EQ(agency.requests.size(), 7);
+    for (const json &request : agency.requests) {
+        EXPECT_FALSE(request.contains("installed_packages"));
+    }
+    EXPECT_TRUE(agency.requests[0].contains("distro"));
+    EXPECT_FALSE(agency.requests[1].contains("distro"));
+
+    // The lookup and its answer, still by hash
+    EXPECT_EQ(agency.requests[2]["tool_results"], json::parse(R"([{"id": "1", "result": {"installed": true}}])"));
+    EXPECT_FALSE(agency.requests[2].contains("distro"));
+    EXPECT_EQ(agency.requests[4]["tool_results"][0]["result"]["installed"], false);
+
+    EXPECT_FALSE(agency.requests[5].contains("distro"));
+    EXPECT_TRUE(agency.requests[6].contains("distro"));
+    EXPECT_EQ(agency.requests[6]["query"], "fourth");
+}
+
+// Test case: A stand-in agency that never stops asking gets cut off at the tool-round limit, and says so.
+TEST_F(ContextHandshakeTest, StandInAgencyKeepsAsking) {
+    StandInAgency agency;
+    FixedContextWrapper wrapper;
+    SessionHistory history;
+
+    std::stringstream error_stream;
+    std::streambuf *original_cerr = std::cerr.rdbuf(error_stream.rdbuf());
+    EXPECT_EQ(wrapper.ask_agent(agency.url, "keep asking", history), "");
+    std::cerr.rdbuf(original_cerr);
+    const std::string errors = error_stream.str();
+
+    EXPECT_EQ(agency.requests.size(), AGENT_TOOL_ROUNDS + 1);
+    EXPECT_EQ(agency.requests.back()["tool_results"].size(), AGENT_TOOL_ROUNDS);
+    EXPECT_NE(errors.find("tool calls after " + std::to_string(AGENT_TOOL_ROUNDS) + " rounds"), std::string::npos) << errors;
+    EXPECT_EQ(errors.find("\"content\" field not found"), std::string::npos) << errors;
+}
@@ -120,3 +120,102 @@ TEST_F(EscapeTest, ReadAndEscape) {
     );
 
 };
+
+// Test case: Bracketed paste markers and mode changes.
+TEST_F(EscapeTest, BracketedPaste) {
+    std::string s = "\x1b[200~"; EXPECT_EQ(escape(s).ch, E_KEY_PASTE_BEGIN);
+    s = "\x1b[201~"; EXPECT_EQ(escape(s).ch, E_KEY_PASTE_END);
+    s = "\x1b[?2004h"; EXPECT_EQ(escape(s).ch, E_KEY_BRACKETED_PASTE_ON);
+    s = "\x1b[?2004l"; EXPECT_EQ(escape(s).ch, E_KEY_BRACKETED_PASTE_OFF);
+    s = "\x1b[202~"; EXPECT_EQ(escape(s).ch, 0);
+};
+
+// Test case: Status queries that applications wait on.
+TEST_F(EscapeTest, StatusQueries) {
+    std::string s = "\x1b[c"; EXPECT_EQ(escape(s).ch, E_KEY_DA1);
+    s = "\x1b[0c"; EXPECT_EQ(escape(s).ch, E_KEY_DA1);
+    s = "\x1b[>c"; EXPECT_EQ(escape(s).ch, E_KEY_DA2);
+    s = "\x1b[>0q"; EXPECT_EQ(escape(s).ch, E_KEY_XTVERSION);
+    s = "\x1b[6n"; TerminalChar tch = escape(s); EXPECT_EQ(tch.ch, E_KEY_DSR); EXPECT_TRUE(tch.args.size() == 1 && tch.args[0] == 6);
+    s = "\x1b[5n"; tch = escape(s); EXPECT_EQ(tch.ch, E_KEY_DSR); EXPECT_TRUE(tch.args.size() == 1 && tch.args[0] == 5);
+    s = "\x1b[7n"; EXPECT_EQ(escape(s).ch, 0);
+};
+
+// Test case: Parameters that do not fit an int or are not numbers.
+TEST_F(EscapeTest, MalformedParameters) {
+    std::string s = "\x1b[99999999999D"; TerminalChar tch = escape(s); EXPECT_EQ(tch.ch, E_KEY_CUB); EXPECT_EQ(tch.args.size(), 0);
+    s = "\x1b[1;2;3H"; tch = escape(s); EXPECT_EQ(tch.ch, 0); EXPECT_EQ(tch.args.size(), 0);
+    s = "\x1b[1;xH"; tch = escape(s); EXPECT_EQ(tch.ch, 0); EXPECT_EQ(tch.args.size(), 0);
+    s = "\x1b[?5A"; EXPECT_EQ(escape(s).ch, 0);
+    s = "\x1b["; EXPECT_EQ(escape(s).ch, 0);
+};
+
+// Test case: Shell integration marks end at BEL or ST, even when split across reads.
+TEST_F(EscapeTest, ShellIntegrationMarks) {
+    std::vector<TerminalChar> vec;
+
+    std::string s = "\x1b]133;A\x07$ \x1b]133;B\x1b\\";
+    escape_buffer(-3, s.c_str(), static_cast<int>(s.size()), vec);
+    EXPECT_TRUE(vec.size() == 4 && vec[0].ch == E_KEY_MARK_PROMPT && vec[1].ch == '$' && vec[3].ch == E_KEY_MARK_COMMAND);
+
+    s = "\x1b]133;C\x07\x1b]13";
+    escape_buffer(-3, s.c_str(), static_cast<int>(s.size()), vec);
+    EXPECT_TRUE(vec.size() == 1 && vec[0].ch == E_KEY_MARK_OUTPUT);
+
+    s = "3;D;127\x07x";
+    escape_buffer(-3, s.c_str(), static_cast<int>(s.size()), vec);
+    ASSERT_EQ(vec.size(), 2);
+    EXPECT_EQ(vec[0].ch, E_KEY_MARK_DONE);
+    EXPECT_TRUE(vec[0].args.size() == 1 && vec[0].args[0] == 127);
+    EXPECT_EQ(vec[1].ch, 'x');
+
+    s = "\x1b]133;D;0;aid=1\x1b\\\x1b]133;D\x07\x1b]133;E\x07";
+    escape_buffer(-3, s.c_str(), static_cast<int>(s.size()), vec);
+    ASSERT_EQ(vec.size(), 3);
+    EXPECT_TRUE(vec[0].ch == E_KEY_MARK_DONE && vec[0].args.size() == 1 && vec[0].args[0] == 0);
+    EXPECT_TRUE(vec[1].ch == E_KEY_MARK_DONE && vec[1].args.empty());
+    EXPECT_EQ(vec[2].ch, 0);
+
+    // Other OSC strings, like window titles, are swallowed whole
+    s = "\x1b]0;title [x]\x07y";
+    escape_buffer(-3, s.c_str(), static_cast<int>(s.size()), vec);
+    EXPECT_TRUE(vec.size() == 2 && vec[0].ch == 0 && vec[1].ch == 'y');
+};
+
+// Test case: Parsing stops right after a paste start.
+TEST_F(EscapeTest, EscapeBufferStopsAtPaste) {
+    const std::string s = "ab\x1b[200~\x02" "cd";
+    std::vector<TerminalChar> vec;
+
+    // The fd only keys the parser state
+    const int n = escape_buffer(-2, s.c_str(), static_cast<int>(s.size()), vec, true);
+
+    EXPECT_EQ(n, 8);
+    EXPECT_TRUE(vec.size() == 3 && vec[0].ch == 'a' && vec[1].ch == 'b' && vec[2].ch == E_KEY_PASTE_BEGIN);
+};
+
+// Test case: Paste payload is collected up to the end marker, even when it is split across reads.
+TEST_F(EscapeTest, ScanPaste) {
+    PasteState state;
+    state.active = true;
+
+    std::string payload;
+    const std::string first = "line\x02\x1b[A\x1b[20";
+    const std::string second = "1~rest";
+
+    EXPECT_EQ(scan_paste(state, first.c_str(), static_cast<int>(first.size()), payload), static_cast<int>(first.size()));
+    EXPECT_TRUE(state.active);
+
+    EXPECT_EQ(scan_paste(state, second.c_str(), static_cast<int>(second.size()), payload), 2);
+    EXPECT_FALSE(state.active);
+    EXPECT_EQ(payload, "line\x02\x1b[A");
+
+    // A marker prefix that turns out to be payload is kept
+    state.active = true;
+    payload.clear();
+    const std::string third = "\x1b[20x\x1b[201~";
+
+    EXPECT_EQ(scan_paste(state, third.c_str(), static_cast<int>(third.size()), payload), static_cast<int>(third.size()));
+    EXPECT_FALSE(state.active);
+    EXPECT_EQ(payload, "\x1b[20x");
+};
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <memory>
+#include <vector>
+
+#include <event_loop.hpp>
+#include <utils.hpp>
+
+class EventLoopTest : public ::testing::Test {
+public:
+    int fd[2]{};
+
+    void SetUp() override {
+        pipe(fd);
+        fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    void TearDown() override {
+        close(fd[0]);
+        close(fd[1]);
+    }
+
+    // Every backend the running kernel supports
+    static std::vector<std::unique_ptr<EventLoop>> loops() {
+        std::vector<std::unique_ptr<EventLoop>> result;
+        result.push_back(std::make_unique<EpollEventLoop>());
+
+        auto ring = std::make_unique<IoUringEventLoop>();
+        if (ring->ok()) {
+            result.push_back(std::move(ring));
+        }
+
+        return result;
+    }
+};
+
+// Test case: Readable fds are reported, and keep being reported until drained.
+TEST_F(EventLoopTest, LevelTriggered) {
+    for (const auto &loop : loops()) {
+        loop->add(fd[0], EPOLLIN);
+
+        LoopEvent events[MAX_EVENTS];
+        EXPECT_EQ(loop->wait(events, MAX_EVENTS, 0), 0);
+
+        write(fd[1], "x", 1);
+
+        ASSERT_EQ(loop->wait(events, MAX_EVENTS, -1), 1);
+        EXPECT_EQ(events[0].fd, fd[0]);
+        EXPECT_TRUE(events[0].events & EPOLLIN);
+
+        // Not read yet
+        ASSERT_EQ(loop->wait(events, MAX_EVENTS, 0), 1);
+        EXPECT_EQ(events[0].fd, fd[0]);
+
+        char ch;
+        read(fd[0], &ch, 1);
+        EXPECT_EQ(loop->wait(events, MAX_EVENTS, 0), 0);
+
+        loop->remove(fd[0]);
+    }
+};
+
+// Test case: Watching no events pauses an fd, until it is modified again.
+TEST_F(EventLoopTest, ModifyPauses) {
+    for (const auto &loop : loops()) {
+        loop->add(fd[0], EPOLLIN);
+        write(fd[1], "x", 1);
+
+        loop->modify(fd[0], 0);
+
+        LoopEvent events[MAX_EVENTS];
+        EXPECT_EQ(loop->wait(events, MAX_EVENTS, 0), 0);
+
+        loop->modify(fd[0], EPOLLIN);
+        ASSERT_EQ(loop->wait(events, MAX_EVENTS, -1), 1);
+        EXPECT_EQ(events[0].fd, fd[0]);
+
+        char ch;
+        read(fd[0], &ch, 1);
+        loop->remove(fd[0]);
+    }
+};
+
+// Test case: Removed fds are no longer reported.
+TEST_F(EventLoopTest, Remove) {
+    for (const auto &loop : loops()) {
+        loop->add(fd[1], EPOLLOUT);
+
+        LoopEvent events[MAX_EVENTS];
+        ASSERT_EQ(loop->wait(events, MAX_EVENTS, -1), 1);
+        EXPECT_EQ(events[0].fd, fd[1]);
+        EXPECT_TRUE(events[0].events & EPOLLOUT);
+
+        loop->remove(fd[1]);
+        EXPECT_EQ(loop->wait(events, MAX_EVENTS, 0), 0);
+    }
+};
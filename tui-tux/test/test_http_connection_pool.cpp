@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <http_connection_pool.hpp>
+#include <https_client.hpp>
+#include <utils.hpp>
+
+#include "loopback_server.hpp"
+
+// Plain HTTP/1.1 that keeps the connection open, the server counts the connections
+static void keep_alive(const int client) {
+    std::string buffer;
+    LoopbackServer::Request request;
+
+    while (LoopbackServer::read_request(client, buffer, request)) {
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 12\r\n\r\n";
+        if (request.head.rfind("HEAD", 0) != 0) {
+            response += "{\"ok\": true}";
+        }
+        LoopbackServer::send_all(client, response);
+    }
+}
+
+// Test case: Requests through the pool reuse one connection, fresh handles open one each.
+TEST(HttpConnectionPoolTest, ReusesConnections) {
+    LoopbackServer server(keep_alive);
+    HttpConnectionPool pool;
+
+    HttpsClient pooled;
+    pooled.set_pool(&pool);
+
+    for (int i = 0; i < 5; i++) {
+        json response = pooled.make_http_request(HttpRequestType::GET, server.url, {}, {}, {});
+        EXPECT_EQ(response["body"]["ok"], true);
+    }
+
+    EXPECT_EQ(server.accepted, 1);
+    EXPECT_EQ(pool.idle_handles(), 1);
+
+    HttpsClient fresh;
+    fresh.set_pool(nullptr);
+
+    for (int i = 0; i < 3; i++) {
+        fresh.make_http_request(HttpRequestType::GET, server.url, {}, {}, {});
+    }
+
+    EXPECT_EQ(server.accepted, 4);
+};
+
+// Test case: A released handle is the next one out, with its connection.
+TEST(HttpConnectionPoolTest, ReleasedHandleKeepsItsConnection) {
+    LoopbackServer server(keep_alive);
+    HttpConnectionPool pool;
+
+    CURL *first = pool.acquire();
+    curl_easy_setopt(first, CURLOPT_URL, server.url.c_str());
+    curl_easy_setopt(first, CURLOPT_NOBODY, 1L);
+    EXPECT_EQ(curl_easy_perform(first), CURLE_OK);
+
+    // Held on to, so it cannot lend its connection to the request below
+    CURL *second = pool.acquire();
+    EXPECT_NE(first, second);
+    curl_easy_setopt(second, CURLOPT_URL, server.url.c_str());
+    curl_easy_setopt(second, CURLOPT_NOBODY, 1L);
+    EXPECT_EQ(curl_easy_perform(second), CURLE_OK);
+
+    EXPECT_EQ(server.accepted, 2);
+
+    pool.release(first);
+
+    HttpsClient client;
+    client.set_pool(&pool);
+    client.make_http_request(HttpRequestType::GET, server.url, {}, {}, {});
+
+    EXPECT_EQ(server.accepted, 2);
+
+    pool.release(second);
+};
+
+// Test case: Idle handles are capped.
+TEST(HttpConnectionPoolTest, KeepsFewIdleHandles) {
+    HttpConnectionPool pool;
+
+    std::vector<CURL *> handles;
+    for (int i = 0; i < HTTP_POOL_HANDLES + 2; i++) {
+        handles.push_back(pool.acquire());
+    }
+
+    for (CURL *curl : handles) {
+        pool.release(curl);
+    }
+
+    EXPECT_EQ(pool.idle_handles(), HTTP_POOL_HANDLES);
+};
+
+// Test case: The request after a prewarm goes over the prewarmed connection.
+TEST(HttpConnectionPoolTest, PrewarmedConnectionIsReused) {
+    LoopbackServer server(keep_alive);
+    HttpConnectionPool pool;
+
+    pool.prewarm(server.url);
+
+    // Done once the handle is back
+    const uint64_t start = monotonic_ns();
+    while (pool.idle_handles() == 0 && monotonic_ns() - start < 5000ULL * 1000 * 1000) {
+        usleep(1000);
+    }
+
+    EXPECT_EQ(server.accepted, 1);
+
+    HttpsClient client;
+    client.set_pool(&pool);
+    json response = client.make_http_request(HttpRequestType::POST, server.url, {}, {{"query", "?"}}, {});
+
+    EXPECT_EQ(response["body"]["ok"], true);
+    EXPECT_EQ(server.accepted, 1);
+};
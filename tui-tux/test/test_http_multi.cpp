@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <event_loop.hpp>
+#include <http_multi.hpp>
+#include <https_client.hpp>
+
+#include "loopback_server.hpp"
+
+using namespace testing;
+
+class MockHttpsClient4 final : public HttpsClient {
+public:
+    MOCK_METHOD(CURL *, curl_easy_init, (), (override));
+    MOCK_METHOD(void, curl_multi_add_handle, (HttpMulti &multi, CURL *curl, std::function<void(CURLcode)> on_done), (override));
+};
+
+// Answers with the requested path after a delay, and closes the connection
+static LoopbackServer::Handler answer_after(const int delay_ms) {
+    return [delay_ms](const int client) {
+        std::string buffer;
+        LoopbackServer::Request request;
+        if (!LoopbackServer::read_request(client, buffer, request)) {
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+
+        // The request line is "GET /<path> HTTP/1.1"
+        const size_t start = request.head.find('/') + 1;
+        const std::string path = request.head.substr(start, request.head.find(' ', start) - start);
+        const std::string body = "{\"path\": \"" + path + "\"}";
+
+        LoopbackServer::send_all(client, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n"
+                                         "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+    };
+}
+
+class HttpMultiTest : public Test {
+public:
+    EpollEventLoop loop;
+    HttpsClient client;
+};
+
+// Test case: Requests run side by side on one thread, not one after another.
+TEST_F(HttpMultiTest, ManyRequestsInFlightOnOneThread) {
+    LoopbackServer server(answer_after(200));
+    HttpMulti multi(&loop);
+
+    std::vector<json> responses(8);
+    for (size_t i = 0; i < responses.size(); i++) {
+        client.make_http_request_async(multi, HttpRequestType::GET, server.url + std::to_string(i), {}, {}, {},
+                                       [&responses, i](json response) { responses[i] = std::move(response); });
+    }
+    EXPECT_EQ(multi.in_flight(), responses.size());
+
+    const auto start = std::chrono::steady_clock::now();
+    multi.run();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    for (size_t i = 0; i < responses.size(); i++) {
+        ASSERT_FALSE(responses[i].contains("error")) << responses[i].dump();
+        EXPECT_EQ(responses[i]["status_code"], 200);
+        EXPECT_EQ(responses[i]["body"]["path"], std::to_string(i));
+    }
+
+    // One at a time would take 8 * 200 ms
+    EXPECT_LT(elapsed, std::chrono::milliseconds(800));
+    EXPECT_EQ(multi.in_flight(), 0);
+}
+
+// Test case: The future is ready once the multi has run the request.
+TEST_F(HttpMultiTest, FutureResolves) {
+    LoopbackServer server(answer_after(0));
+    HttpMulti multi(&loop);
+
+    std::future<json> future = client.make_http_request_async(multi, HttpRequestType::GET, server.url + "f", {}, {}, {});
+    multi.run();
+
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(future.get()["body"]["path"], "f");
+}
+
+// Test case: Events for fds the multi does not watch are left to the caller.
+TEST_F(HttpMultiTest, IgnoresForeignFds) {
+    HttpMulti multi(&loop);
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    EXPECT_FALSE(multi.handle({fds[0], EPOLLIN}));
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Test case: Transfers still in flight are aborted with the multi.
+TEST_F(HttpMultiTest, AbortsInFlightOnDestruction) {
+    LoopbackServer server(answer_after(200));
+    json response;
+
+    {
+        HttpMulti multi(&loop);
+        client.make_http_request_async(multi, HttpRequestType::GET, server.url, {}, {}, {},
+                                       [&response](json r) { response = std::move(r); });
+    }
+
+    ASSERT_TRUE(response.contains("error"));
+    EXPECT_EQ(response["error"], curl_easy_strerror(CURLE_ABORTED_BY_CALLBACK));
+}
+
+// Test case: The multi seam can be mocked like curl_easy_perform.
+TEST_F(HttpMultiTest, MockedMultiSeam) {
+    MockHttpsClient4 mock_client;
+    HttpMulti multi(&loop);
+
+    EXPECT_CALL(mock_client, curl_easy_init)
+        .WillOnce(Return(::curl_easy_init()));
+    EXPECT_CALL(mock_client, curl_multi_add_handle(_, _, _))
+        .WillOnce(Invoke([](HttpMulti &, CURL *, const std::function<void(CURLcode)> &on_done) {
+            on_done(CURLE_AGAIN);
+        }));
+
+    json response;
+    mock_client.make_http_request_async(multi, HttpRequestType::GET, "http://127.0.0.1:1/", {}, {}, {},
+                                        [&response](json r) { response = std::move(r); });
+
+    EXPECT_TRUE(response.contains("error") && response["error"] == "Socket not ready for send/recv");
+}
+
+// Test case: A handle that cannot be made is reported through the callback.
+TEST_F(HttpMultiTest, InitFail) {
+    MockHttpsClient4 mock_client;
+    HttpMulti multi(&loop);
+
+    EXPECT_CALL(mock_client, curl_easy_init)
+        .WillOnce(Return(nullptr));
+    EXPECT_CALL(mock_client, curl_multi_add_handle(_, _, _)).Times(0);
+
+    json response;
+    mock_client.make_http_request_async(multi, HttpRequestType::GET, "http://127.0.0.1:1/", {}, {}, {},
+                                        [&response](json r) { response = std::move(r); });
+
+    EXPECT_TRUE(response.contains("error"));
+}
@@ -2,8 +2,15 @@
 #include <gmock/gmock.h>
 
 #include <https_client.hpp>
+#include <utils.hpp>
 
+#include "loopback_server.hpp"
+
+#include <unistd.h>
+#include <cstdlib>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 using namespace testing;
 
@@ -23,6 +30,21 @@ public:
     MOCK_METHOD(CURLcode, curl_easy_perform, (CURL *curl), (override));
 };
 
+// Answers one request with a body sent in pieces, a delay before each
+static LoopbackServer::Handler slow_stream(std::string head, std::vector<std::string> pieces, const int delay_ms) {
+    return [head = std::move(head), pieces = std::move(pieces), delay_ms](const int client) {
+        std::string buffer;
+        LoopbackServer::Request request;
+        LoopbackServer::read_request(client, buffer, request);
+
+        LoopbackServer::send_all(client, head);
+        for (const std::string &piece : pieces) {
+            usleep(delay_ms * 1000);
+            LoopbackServer::send_all(client, piece);
+        }
+    };
+}
+
 class HttpsClientTest : public Test {
 public:
     HttpsClient https_client;
@@ -154,4 +176,110 @@ TEST_F(HttpsClientTest, HeadersAndStatusCode2) {
 
     EXPECT_TRUE(response.contains("status_code") && response["status_code"] == 404);
     EXPECT_TRUE(response.contains("headers") && response["headers"].contains("content-type") && response["headers"]["content-type"].dump().find("application/json") != std::string::npos);
-}
\ No newline at end of file
+}
+
+// Test case: Setting the cancel flag aborts a request the server never answers.
+TEST_F(HttpsClientTest, CancelAbortsRequest) {
+    // Accepted by the kernel, from the backlog, and never answered
+    LoopbackServer server;
+    std::atomic<bool> cancel{false};
+    https_client.set_cancel_flag(&cancel);
+
+    std::thread canceller([&cancel] {
+        usleep(200 * 1000);
+        cancel = true;
+    });
+
+    const uint64_t start = monotonic_ns();
+    json response = https_client.make_http_request(HttpRequestType::GET, server.url, {}, {}, headers);
+    const uint64_t elapsed = monotonic_ns() - start;
+    canceller.join();
+
+    EXPECT_TRUE(response.contains("error"));
+    EXPECT_LT(elapsed, 3000ULL * 1000 * 1000);
+};
+
+// Test case: A request the server never answers times out after ISHELL_TIMEOUT seconds.
+TEST_F(HttpsClientTest, TimesOut) {
+    // Accepted by the kernel, from the backlog, and never answered
+    LoopbackServer server;
+    setenv("ISHELL_TIMEOUT", "0.3", 1);
+
+    const uint64_t start = monotonic_ns();
+    json response = https_client.make_http_request(HttpRequestType::GET, server.url, {}, {}, headers);
+    const uint64_t elapsed = monotonic_ns() - start;
+
+    unsetenv("ISHELL_TIMEOUT");
+
+    EXPECT_TRUE(response.contains("error"));
+    EXPECT_GE(elapsed, 250ULL * 1000 * 1000);
+    EXPECT_LT(elapsed, 3000ULL * 1000 * 1000);
+};
+
+// Test case: A slow SSE stream hands over the first delta long before the answer is complete.
+TEST_F(HttpsClientTest, StreamsServerSentEvents) {
+    const std::vector<std::string> chunks = {
+        "data: {\"delta\": \"The \"}\n\n",
+        "data: {\"delta\": \"answer \"}\n\n",
+        "data: {\"delta\": \"is 42\"}\n\n",
+        "data: [DONE]\n\n"
+    };
+
+    // Chunked, like a server that does not know the length up front
+    std::vector<std::string> pieces;
+    for (const std::string &chunk : chunks) {
+        char size[16];
+        snprintf(size, sizeof(size), "%zx\r\n", chunk.size());
+        pieces.push_back(size + chunk + "\r\n");
+    }
+    pieces.emplace_back("0\r\n\r\n");
+
+    LoopbackServer server(slow_stream("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nTransfer-Encoding: chunked\r\n\r\n",
+                                      pieces, 100));
+
+    std::vector<std::string> deltas;
+    uint64_t first_delta_ns = 0;
+    https_client.set_stream_callback([&](const std::string &delta) {
+        if (deltas.empty()) {
+            first_delta_ns = monotonic_ns();
+        }
+        deltas.push_back(delta);
+    });
+
+    const uint64_t start = monotonic_ns();
+    json response = https_client.make_http_request(HttpRequestType::POST, server.url, {}, {{"query", "?"}}, headers);
+    const uint64_t total_ns = monotonic_ns() - start;
+
+    EXPECT_EQ(deltas, (std::vector<std::string>{"The ", "answer ", "is 42"}));
+    EXPECT_EQ(response["body"]["content"], "The answer is 42");
+    EXPECT_GE(total_ns, 400ULL * 1000 * 1000);
+    EXPECT_LT(first_delta_ns - start, total_ns / 2);
+};
+
+// Test case: NDJSON streams work the same, errors in the stream end up in the body.
+TEST_F(HttpsClientTest, StreamsNdjsonError) {
+    LoopbackServer server(slow_stream("HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\nConnection: close\r\n\r\n",
+                                      {"{\"delta\": \"partial\"}\n", "{\"error\": \"model overloaded\"}\n"}, 20));
+
+    std::string seen;
+    https_client.set_stream_callback([&seen](const std::string &delta) { seen += delta; });
+
+    json response = https_client.make_http_request(HttpRequestType::POST, server.url, {}, {{"query", "?"}}, headers);
+
+    EXPECT_EQ(seen, "partial");
+    EXPECT_EQ(response["body"]["error"], "model overloaded");
+};
+
+// Test case: Answers that are not streamed are parsed as before, even with a stream callback.
+TEST_F(HttpsClientTest, NotStreamedWithCallback) {
+    LoopbackServer server(slow_stream("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n",
+                                      {"{\"content\": ", "\"whole\"}"}, 20));
+
+    bool called = false;
+    https_client.set_stream_callback([&called](const std::string &) { called = true; });
+
+    json response = https_client.make_http_request(HttpRequestType::POST, server.url, {}, {{"query", "?"}}, headers);
+
+    EXPECT_FALSE(called);
+    EXPECT_EQ(response["body"]["content"], "whole");
+};
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+
+#include <outbound_queue.hpp>
+
+class OutboundQueueTest : public ::testing::Test {
+public:
+    int fd[2]{};
+
+    void SetUp() override {
+        pipe(fd);
+
+        // Non-blocking like a pty master
+        fcntl(fd[1], F_SETFL, fcntl(fd[1], F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    void TearDown() override {
+        close(fd[0]);
+        close(fd[1]);
+    }
+};
+
+// Test case: Queued chunks go out together in one flush.
+TEST_F(OutboundQueueTest, Coalesces) {
+    OutboundQueue queue;
+
+    EXPECT_TRUE(queue.push("ab"));
+    EXPECT_TRUE(queue.push("cd"));
+    EXPECT_EQ(queue.size(), 4);
+
+    EXPECT_EQ(queue.flush(fd[1]), 0);
+    EXPECT_TRUE(queue.empty());
+
+    char buf[16] = {0};
+    EXPECT_EQ(read(fd[0], buf, sizeof(buf)), 4);
+    EXPECT_STREQ(buf, "abcd");
+}
+
+// Test case: Data the fd does not accept stays queued and is written once the fd drains.
+TEST_F(OutboundQueueTest, KeepsDataOnFullFd) {
+    fcntl(fd[1], F_SETPIPE_SZ, 4096);
+
+    std::string data;
+    for (int i = 0; i < 20000; i++) {
+        data += static_cast<char>('a' + i % 26);
+    }
+
+    OutboundQueue queue;
+    EXPECT_TRUE(queue.push(data));
+
+    ssize_t left = queue.flush(fd[1]);
+    EXPECT_GT(left, 0);
+
+    std::string received;
+    char buf[4096];
+
+    while (left > 0) {
+        const ssize_t n = read(fd[0], buf, sizeof(buf));
+        ASSERT_GT(n, 0);
+        received.append(buf, n);
+        left = queue.flush(fd[1]);
+    }
+
+    // Whatever is still in the pipe
+    while (received.size() < data.size()) {
+        const ssize_t n = read(fd[0], buf, sizeof(buf));
+        ASSERT_GT(n, 0);
+        received.append(buf, n);
+    }
+
+    EXPECT_EQ(received, data);
+    EXPECT_EQ(queue.get_dropped(), 0);
+}
+
+// Test case: Data that does not fit is dropped as a whole and counted.
+TEST_F(OutboundQueueTest, Overflow) {
+    OutboundQueue queue(8);
+
+    EXPECT_TRUE(queue.push("12345"));
+    EXPECT_FALSE(queue.push("67890"));
+    EXPECT_EQ(queue.size(), 5);
+    EXPECT_EQ(queue.get_dropped(), 5);
+
+    EXPECT_EQ(queue.flush(fd[1]), 0);
+
+    char buf[16] = {0};
+    EXPECT_EQ(read(fd[0], buf, sizeof(buf)), 5);
+    EXPECT_STREQ(buf, "12345");
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <package_database.hpp>
+#include <utils.hpp>
+
+static std::vector<std::string> installed_names(const std::vector<PackageRecord> &records) {
+    std::vector<std::string> names;
+    for (const PackageRecord &record : records) {
+        if (is_installed(record)) {
+            names.push_back(record.name);
+        }
+    }
+    return names;
+}
+
+// Test case: Reads name, version and status of each stanza, skipping other fields and continuation lines.
+TEST(PackageDatabaseTest, ReadsDpkgStatus) {
+    const std::vector<PackageRecord> records = read_package_database(PackageFormat::Dpkg, "test/data/dpkg_status");
+
+    ASSERT_EQ(records.size(), 5);
+    EXPECT_EQ(records[0].name, "bash");
+    EXPECT_EQ(records[0].version, "5.2.15-2+b7");
+    EXPECT_EQ(records[0].status, "install ok installed");
+    EXPECT_EQ(records[1].name, "nano");
+    EXPECT_EQ(records[1].status, "deinstall ok config-files");
+    EXPECT_EQ(records[4].name, "curl");
+    EXPECT_EQ(records[4].version, "7.88.1-10+deb12u5");
+
+    // nano only left its config files
+    EXPECT_EQ(installed_names(records), std::vector<std::string>({"bash", "libc6", "libc6", "curl"}));
+}
+
+// Test case: Reads apk's installed database, the last entry has no blank line after it.
+TEST(PackageDatabaseTest, ReadsApkInstalled) {
+    const std::vector<PackageRecord> records = read_package_database(PackageFormat::Apk, "test/data/apk_installed");
+
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[0].name, "musl");
+    EXPECT_EQ(records[0].version, "1.2.4-r2");
+    EXPECT_EQ(records[2].name, "alpine-baselayout");
+    EXPECT_EQ(installed_names(records), std::vector<std::string>({"musl", "busybox", "alpine-baselayout"}));
+}
+
+// Test case: Parses rpm's query output, ignoring malformed lines.
+TEST(PackageDatabaseTest, ParsesRpmQuery) {
+    const std::string output = "bash\t5.1.8-6.el9\nno tab here\nglibc\t2.34-60.el9\n";
+
+    std::vector<PackageRecord> records;
+    parse_rpm_query(output.data(), output.size(), records);
+
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].name, "bash");
+    EXPECT_EQ(records[0].version, "5.1.8-6.el9");
+    EXPECT_EQ(records[1].name, "glibc");
+    EXPECT_TRUE(is_installed(records[1]));
+}
+
+// Test case: A database that is missing or empty has no packages.
+TEST(PackageDatabaseTest, MissingOrEmpty) {
+    EXPECT_TRUE(read_package_database(PackageFormat::Dpkg, "test/data/missing").empty());
+    EXPECT_TRUE(read_package_database(PackageFormat::None, "").empty());
+
+    std::vector<PackageRecord> records;
+    parse_dpkg_status("", 0, records);
+    parse_apk_installed("\n\n", 2, records);
+    EXPECT_TRUE(records.empty());
+}
+
+// Test case: The format is picked from the database found under the root.
+TEST(PackageDatabaseTest, DetectsFormat) {
+    char root[] = "/tmp/ishell_root_XXXXXX";
+    ASSERT_NE(mkdtemp(root), nullptr);
+    const std::string root_str = root;
+
+    EXPECT_EQ(detect_package_format(root_str), PackageFormat::None);
+
+    ASSERT_EQ(system(("mkdir -p " + root_str + "/lib/apk/db").c_str()), 0);
+    std::ofstream(root_str + APK_INSTALLED_PATH) << "P:musl\n";
+    EXPECT_EQ(detect_package_format(root_str), PackageFormat::Apk);
+    EXPECT_EQ(package_database_path(PackageFormat::Apk, root_str), root_str + APK_INSTALLED_PATH);
+
+    ASSERT_EQ(system(("rm -rf " + root_str).c_str()), 0);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <package_index.hpp>
+
+class PackageIndexTest : public testing::Test {
+public:
+    // As PackageInventory builds it, installed packages only
+    static PackageIndex index_of(const PackageFormat format, const std::string &path) {
+        std::vector<PackageRecord> records;
+        for (PackageRecord &record : read_package_database(format, path)) {
+            if (is_installed(record)) {
+                records.push_back(std::move(record));
+            }
+        }
+        return {std::move(records), format, path};
+    }
+};
+
+// Test case: Packages are found by name, with their version.
+TEST_F(PackageIndexTest, FindsByName) {
+    const PackageIndex index = index_of(PackageFormat::Dpkg, "test/data/dpkg_status");
+
+    ASSERT_NE(index.find("curl"), nullptr);
+    EXPECT_EQ(index.find("curl")->name, "curl");
+    EXPECT_FALSE(index.find("curl")->version.empty());
+
+    // Removed with its config files left
+    EXPECT_EQ(index.find("nano"), nullptr);
+    EXPECT_EQ(index.find("vim"), nullptr);
+    EXPECT_EQ(index.find(""), nullptr);
+}
+
+// Test case: dpkg's file lists give the owner of a file, architecture qualified or not.
+TEST_F(PackageIndexTest, DpkgOwner) {
+    const PackageIndex index = index_of(PackageFormat::Dpkg, "test/data/dpkg_status");
+
+    ASSERT_NE(index.owner_of("/bin/bash"), nullptr);
+    EXPECT_EQ(index.owner_of("/bin/bash")->name, "bash");
+    ASSERT_NE(index.owner_of("/lib/x86_64-linux-gnu/libc.so.6"), nullptr);
+    EXPECT_EQ(index.owner_of("/lib/x86_64-linux-gnu/libc.so.6")->name, "libc6");
+    ASSERT_NE(index.owner_of("/usr/bin/curl"), nullptr);
+    EXPECT_EQ(index.owner_of("/usr/bin/curl")->name, "curl");
+
+    // Listed, but the package is no longer installed
+    EXPECT_EQ(index.owner_of("/usr/bin/nano"), nullptr);
+    EXPECT_EQ(index.owner_of("/"), nullptr);
+    EXPECT_EQ(index.owner_of("/usr/bin/vim"), nullptr);
+}
+
+// Test case: apk's database gives the owner of a file from its directory and file lines.
+TEST_F(PackageIndexTest, ApkOwner) {
+    const PackageIndex index = index_of(PackageFormat::Apk, "test/data/apk_installed");
+
+    ASSERT_NE(index.owner_of("/lib/ld-musl-x86_64.so.1"), nullptr);
+    EXPECT_EQ(index.owner_of("/lib/ld-musl-x86_64.so.1")->name, "musl");
+    ASSERT_NE(index.owner_of("/bin/busybox"), nullptr);
+    EXPECT_EQ(index.owner_of("/bin/busybox")->name, "busybox");
+    EXPECT_EQ(index.owner_of("/bin/sh"), nullptr);
+}
+
+// Test case: Without file lists there is no owner, but lookups by name still work.
+TEST_F(PackageIndexTest, NoFileLists) {
+    const PackageIndex index({{"bash", "5.2", "installed"}}, PackageFormat::Rpm, "test/data/missing");
+
+    EXPECT_EQ(index.owner_of("/bin/bash"), nullptr);
+    EXPECT_NE(index.find("bash"), nullptr);
+}
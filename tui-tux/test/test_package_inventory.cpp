@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <package_inventory.hpp>
+
+// Counts its reads instead of running dpkg
+class CountingInventory final : public PackageInventory {
+public:
+    explicit CountingInventory(const std::string &database_path) : PackageInventory(PackageFormat::Dpkg, database_path) {}
+
+    std::atomic<int> reads{0};
+    std::vector<std::string> names = {"zsh", "bash", "coreutils", "bash"};
+
+protected:
+    std::vector<PackageRecord> read_packages() override {
+        reads++;
+
+        std::vector<PackageRecord> records;
+        for (const std::string &name : names) {
+            records.push_back({name, "1.0", "installed"});
+        }
+        return records;
+    }
+};
+
+class PackageInventoryTest : public testing::Test {
+public:
+    std::string database_path;
+
+    void SetUp() override {
+        char path[] = "/tmp/ishell_dpkg_status_XXXXXX";
+        close(mkstemp(path));
+        database_path = path;
+
+        write_database("Package: bash\n");
+    }
+
+    void TearDown() override {
+        unlink(database_path.c_str());
+    }
+
+    void write_database(const std::string &contents) const {
+        std::ofstream file(database_path, std::ios::trunc);
+        file << contents;
+    }
+};
+
+// Test case: The list is read once while the database stays the same, and comes back sorted without duplicates.
+TEST_F(PackageInventoryTest, ReadsOnceAndSorts) {
+    CountingInventory inventory(database_path);
+
+    const auto first = inventory.get();
+    const auto second = inventory.get();
+
+    EXPECT_EQ(inventory.reads, 1);
+    EXPECT_EQ(first, second);
+    std::vector<std::string> names;
+    for (const PackageRecord &record : first->get_records()) {
+        names.push_back(record.name);
+    }
+    EXPECT_EQ(names, std::vector<std::string>({"bash", "coreutils", "zsh"}));
+}
+
+// Test case: A change to the database makes the next get() read the list again.
+TEST_F(PackageInventoryTest, ReadsAgainWhenDatabaseChanges) {
+    CountingInventory inventory(database_path);
+    inventory.get();
+
+    inventory.names.emplace_back("nano");
+    write_database("Package: bash\n\nPackage: nano\n");
+
+    const auto packages = inventory.get();
+
+    EXPECT_EQ(inventory.reads, 2);
+    EXPECT_NE(packages->find("nano"), nullptr);
+}
+
+// Test case: A list loaded in the background is what get() returns, without a read of its own.
+TEST_F(PackageInventoryTest, LoadsInBackground) {
+    CountingInventory inventory(database_path);
+
+    inventory.load_in_background();
+    inventory.load_in_background();
+    const auto packages = inventory.get();
+
+    EXPECT_EQ(inventory.reads, 1);
+    EXPECT_EQ(packages->get_records().size(), 3);
+}
+
+// Test case: Without a database the list is still read only once.
+TEST_F(PackageInventoryTest, MissingDatabase) {
+    CountingInventory inventory(database_path + ".missing");
+
+    inventory.get();
+    inventory.get();
+
+    EXPECT_EQ(inventory.reads, 1);
+}
+
+// Test case: Names from dpkg carry no trailing newline.
+TEST_F(PackageInventoryTest, NoTrailingNewlines) {
+    for (const PackageRecord &record : PackageInventory::shared().get()->get_records()) {
+        ASSERT_FALSE(record.name.empty());
+        ASSERT_EQ(record.name.find('\n'), std::string::npos) << record.name;
+    }
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+
+#include <pane_reader.hpp>
+#include <io_ring.hpp>
+#include <utils.hpp>
+
+class PaneReaderTest : public ::testing::Test {
+public:
+    int fd[2]{};
+
+    void SetUp() override {
+        pipe(fd);
+
+        // Non-blocking like a pty master
+        fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    void TearDown() override {
+        close(fd[0]);
+        if (fd[1] != -1) {
+            close(fd[1]);
+        }
+    }
+
+    // Waits for the reader to publish, then pops one chunk
+    static bool wait_and_pop(PaneReader &reader, PaneChunk &chunk) {
+        for (int i = 0; i < 100; i++) {
+            pollfd pfd = {reader.get_notify_fd(), POLLIN, 0};
+            poll(&pfd, 1, 20);
+
+            reader.clear_notification();
+            if (reader.pop(chunk)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+// Test case: Output is parsed on the reader thread and handed over as chunks.
+TEST_F(PaneReaderTest, PublishesParsedChunks) {
+    PaneReader reader(fd[0]);
+    reader.start();
+
+    const std::string s = "ab\x1b[2;3Hc";
+    write(fd[1], s.c_str(), s.size());
+
+    PaneChunk chunk;
+    ASSERT_TRUE(wait_and_pop(reader, chunk));
+
+    EXPECT_EQ(chunk.n_bytes, static_cast<int>(s.size()));
+    ASSERT_EQ(chunk.chars.size(), 4);
+    EXPECT_EQ(chunk.chars[0].ch, 'a');
+    EXPECT_EQ(chunk.chars[2].ch, E_KEY_CUP);
+    EXPECT_EQ(chunk.chars[3].ch, 'c');
+};
+
+// Test case: Closing the other end publishes the end of the stream.
+TEST_F(PaneReaderTest, PublishesEnd) {
+    PaneReader reader(fd[0]);
+    reader.start();
+
+    close(fd[1]);
+    fd[1] = -1;
+
+    PaneChunk chunk;
+    ASSERT_TRUE(wait_and_pop(reader, chunk));
+    EXPECT_EQ(chunk.n_bytes, -1);
+};
+
+// Test case: The io_uring backend reads with a multishot read, up to the end of the stream.
+TEST_F(PaneReaderTest, RingReads) {
+    const int opcodes[] = {IORING_OP_POLL_ADD, IORING_OP_PROVIDE_BUFFERS, IO_RING_OP_READ_MULTISHOT};
+    if (!IoRing::supports(opcodes, 3)) {
+        GTEST_SKIP() << "io_uring multishot reads not supported";
+    }
+
+    PaneReader reader(fd[0], LoopBackend::IoUring);
+    reader.start();
+
+    // More reads than buffers, so they have to be handed back
+    std::string received;
+    PaneChunk chunk;
+
+    for (int i = 0; i < PANE_RING_BUFFERS * 2; i++) {
+        write(fd[1], "ab", 2);
+
+        while (received.size() < 2 * static_cast<size_t>(i + 1)) {
+            ASSERT_TRUE(wait_and_pop(reader, chunk));
+            for (const TerminalChar &tch : chunk.chars) {
+                received += static_cast<char>(tch.ch);
+            }
+        }
+    }
+
+    EXPECT_EQ(received.size(), 4 * PANE_RING_BUFFERS);
+
+    close(fd[1]);
+    fd[1] = -1;
+
+    ASSERT_TRUE(wait_and_pop(reader, chunk));
+    EXPECT_EQ(chunk.n_bytes, -1);
+};
+
+// Test case: A reader waiting for room can still be stopped.
+TEST_F(PaneReaderTest, StopsWhileFull) {
+    PaneReader reader(fd[0]);
+    reader.start();
+
+    // Many small writes fill the queue, nobody pops
+    for (int i = 0; i < PANE_QUEUE_CHUNKS * 4; i++) {
+        write(fd[1], "x", 1);
+        usleep(100);
+    }
+
+    reader.stop();
+    SUCCEED();
+};
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <perf_stats.hpp>
+
+class PerfStatsTest : public ::testing::Test {};
+
+// Test case: Percentiles report the upper bound of the bucket holding that sample.
+TEST_F(PerfStatsTest, HistogramPercentile) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.percentile(0.99), 0);
+
+    for (int i = 0; i < 99; i++) {
+        histogram.record(1000);
+    }
+    histogram.record(1000 * 1000);
+
+    EXPECT_EQ(histogram.count(), 100);
+    EXPECT_EQ(histogram.percentile(0.5), 1024);
+    EXPECT_EQ(histogram.percentile(0.99), 1024);
+    EXPECT_EQ(histogram.percentile(1.0), 1024 * 1024);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0);
+};
+
+// Test case: Shared counters survive a fork, so the agent can report its requests.
+TEST_F(PerfStatsTest, SharedAcrossFork) {
+    map_shared_perf_stats();
+    ASSERT_NE(shared_perf_stats, nullptr);
+
+    stat_set(shared_perf_stats->agent_request_start_ns, 0);
+
+    if (const pid_t pid = fork(); pid == 0) {
+        stat_set(shared_perf_stats->agent_request_start_ns, 42);
+        _exit(0);
+    } else {
+        waitpid(pid, nullptr, 0);
+    }
+
+    EXPECT_EQ(stat_get(shared_perf_stats->agent_request_start_ns), 42);
+};
+
+// Test case: HUD values stay short.
+TEST_F(PerfStatsTest, Formatting) {
+    EXPECT_EQ(format_ns(512), "512ns");
+    EXPECT_EQ(format_ns(2500000), "2.5ms");
+    EXPECT_EQ(format_rate(1500, "B"), "1.5KB/s");
+};
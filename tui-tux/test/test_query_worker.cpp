@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <query_worker.hpp>
+
+// Answers right away, or only once cancelled for a query that hangs
+class FakeAgencyManager final : public AgencyManager {
+public:
+    explicit FakeAgencyManager(AgencyRequestWrapper *request_wrapper) : AgencyManager(request_wrapper) {}
+
+    std::string execute_query(const std::string &endpoint, const std::string &query) override {
+        if (query == "hang") {
+            while (!request_wrapper->cancel_requested) {
+                usleep(1000);
+            }
+
+            return "";
+        }
+
+        if (query == "stream") {
+            for (const char *delta : {"one ", "two"}) {
+                request_wrapper->on_delta(delta);
+                usleep(20 * 1000);
+            }
+
+            return "one two";
+        }
+
+        return endpoint + ": " + query;
+    }
+};
+
+class QueryWorkerTest : public ::testing::Test {
+public:
+    AgencyRequestWrapper request_wrapper;
+    FakeAgencyManager manager{&request_wrapper};
+    QueryWorker worker{&manager};
+
+    bool wait_done(const int timeout_ms) const {
+        pollfd pfd = {worker.get_fd(), POLLIN, 0};
+        return poll(&pfd, 1, timeout_ms) == 1;
+    }
+};
+
+// Test case: The answer is ready once the fd is readable.
+TEST_F(QueryWorkerTest, Answers) {
+    EXPECT_FALSE(worker.is_busy());
+
+    worker.start("assistant", "hello");
+    EXPECT_TRUE(worker.is_busy());
+    ASSERT_TRUE(wait_done(5000));
+
+    std::string result;
+    EXPECT_TRUE(worker.finish(result));
+    EXPECT_EQ(result, "assistant: hello");
+    EXPECT_FALSE(worker.is_busy());
+
+    // Nothing left to read for the next query
+    EXPECT_FALSE(wait_done(0));
+};
+
+// Test case: A hanging query finishes as cancelled, and the next one runs normally.
+TEST_F(QueryWorkerTest, CancelsHangingQuery) {
+    worker.start("assistant", "hang");
+    EXPECT_FALSE(wait_done(50));
+
+    worker.cancel();
+    ASSERT_TRUE(wait_done(5000));
+
+    std::string result;
+    EXPECT_FALSE(worker.finish(result));
+
+    worker.start("assistant", "again");
+    ASSERT_TRUE(wait_done(5000));
+    EXPECT_TRUE(worker.finish(result));
+    EXPECT_EQ(result, "assistant: again");
+};
+
+// Test case: Streamed text can be taken while the query still runs.
+TEST_F(QueryWorkerTest, HandsOverStreamedText) {
+    worker.start("assistant", "stream");
+
+    std::string streamed;
+    while (wait_done(5000)) {
+        const bool finished = worker.is_finished();
+
+        if (std::string text; worker.take_partial(text)) {
+            streamed += text;
+        }
+
+        if (finished) {
+            break;
+        }
+    }
+
+    std::string result;
+    EXPECT_TRUE(worker.finish(result));
+    EXPECT_EQ(streamed, "one two");
+    EXPECT_EQ(result, "one two");
+};
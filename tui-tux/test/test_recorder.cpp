@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+#include <recorder.hpp>
+
+#define RECORDING_TEST_FILE "/tmp/ishell-testing-recording"
+
+class RecorderTest : public ::testing::Test {
+public:
+    SCREEN *term = nullptr;
+    FILE *out = nullptr, *in = nullptr;
+
+    void SetUp() override {
+        // Replay draws into pads, which need ncurses but no real terminal
+        out = fopen("/dev/null", "w");
+        in = fopen("/dev/null", "r");
+        term = newterm("xterm", out, in);
+        set_term(term);
+    }
+
+    void TearDown() override {
+        endwin();
+        delscreen(term);
+        fclose(out);
+        fclose(in);
+        unlink(RECORDING_TEST_FILE);
+    }
+};
+
+// Test case: Entries come back in order, with their streams, kinds and bytes.
+TEST_F(RecorderTest, RoundTrip) {
+    Recorder recorder;
+    ASSERT_TRUE(recorder.open(RECORDING_TEST_FILE));
+    recorder.resize(1, 24, 80);
+    recorder.data(RECORD_STREAM_STDIN, "ls\r", 3);
+    recorder.data(1, "a\0b", 3);
+    recorder.close();
+
+    RecordReader reader;
+    ASSERT_TRUE(reader.open(RECORDING_TEST_FILE));
+
+    RecordEntry entry;
+    ASSERT_TRUE(reader.next(entry));
+    EXPECT_EQ(entry.stream, 1);
+    EXPECT_EQ(entry.kind, RECORD_KIND_RESIZE);
+
+    ASSERT_TRUE(reader.next(entry));
+    EXPECT_EQ(entry.stream, RECORD_STREAM_STDIN);
+    EXPECT_EQ(entry.data, "ls\r");
+
+    const uint64_t ns = entry.ns;
+    ASSERT_TRUE(reader.next(entry));
+    EXPECT_EQ(entry.kind, RECORD_KIND_DATA);
+    EXPECT_EQ(entry.data, std::string("a\0b", 3));
+    EXPECT_GE(entry.ns, ns);
+
+    EXPECT_FALSE(reader.next(entry));
+};
+
+// Test case: Files that are not recordings are rejected.
+TEST_F(RecorderTest, RejectsOtherFiles) {
+    FILE *file = fopen(RECORDING_TEST_FILE, "w");
+    fputs("{\"version\": 2}\n", file);
+    fclose(file);
+
+    RecordReader reader;
+    EXPECT_FALSE(reader.open(RECORDING_TEST_FILE));
+};
+
+// Test case: Replaying pane output draws it into a screen of the recorded size.
+TEST_F(RecorderTest, ReplayIntoScreen) {
+    Recorder recorder;
+    ASSERT_TRUE(recorder.open(RECORDING_TEST_FILE));
+    recorder.resize(1, 10, 40);
+
+    const std::string output = "hello\r\n\x1b[1;1Hworld";
+    recorder.data(1, output.data(), output.size());
+    recorder.close();
+
+    RecordReader reader;
+    ASSERT_TRUE(reader.open(RECORDING_TEST_FILE));
+
+    std::vector<Screen> screens;
+    const ReplayResult result = replay_recording(reader, screens, false);
+
+    EXPECT_EQ(result.entries, 2);
+    EXPECT_EQ(result.bytes, output.size());
+    ASSERT_EQ(screens.size(), 1);
+    EXPECT_EQ(screens[0].get_n_lines(), 10);
+    EXPECT_EQ(screens[0].get_n_cols(), 40);
+
+    char line[8] = {0};
+    mvwinnstr(screens[0].get_pad(), 0, 0, line, 5);
+    EXPECT_STREQ(line, "world");
+};
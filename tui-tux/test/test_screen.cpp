@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <escape.hpp>
+#include <screen.hpp>
+#include <utils.hpp>
+
+// Enough to fill a pad, history past MAX_PAD_HEIGHT lines is dropped
+#define FULL_PAD_LINES MAX_PAD_HEIGHT
+
+class ScreenTest : public ::testing::Test {
+public:
+    SCREEN *term = nullptr;
+    FILE *out = nullptr, *in = nullptr;
+
+    void SetUp() override {
+        // Screens draw into pads, which need ncurses but no real terminal
+        out = fopen("/dev/null", "w");
+        in = fopen("/dev/null", "r");
+        term = newterm("xterm", out, in);
+        set_term(term);
+    }
+
+    void TearDown() override {
+        endwin();
+        delscreen(term);
+        fclose(out);
+        fclose(in);
+    }
+
+    static void feed(Screen &screen, const std::string &s) {
+        std::vector<TerminalChar> chars;
+        escape_buffer(-4, s.c_str(), static_cast<int>(s.size()), chars);
+
+        for (const TerminalChar &tch : chars) {
+            screen.handle_char(tch);
+        }
+    }
+
+    // What bash prints for one command with the shell integration marks
+    static void run_command(Screen &screen, const std::string &command, const std::string &output, const int status) {
+        feed(screen, "\x1b]133;A\x07$ \x1b]133;B\x07" + command + "\r\n\x1b]133;C\x07" + output +
+                     "\x1b]133;D;" + std::to_string(status) + "\x07");
+    }
+
+    static void write_lines(Screen &screen, const int n) {
+        for (int i = 0; i < n; i++) {
+            const std::string line = "line " + std::to_string(i) + "\r\n";
+            for (const char ch : line) {
+                TerminalChar tch;
+                tch.ch = ch;
+                screen.handle_char(tch);
+            }
+        }
+    }
+};
+
+// Test case: Changing how many lines are shown, what a zoom does to each pane, is cheap with a full pad.
+TEST_F(ScreenTest, ViewportToggleWithFullPad) {
+    Screen screen(23, 80, 0, 0);
+    write_lines(screen, FULL_PAD_LINES);
+
+    WINDOW *pad = screen.get_pad();
+
+    constexpr int toggles = 100;
+    const uint64_t start = monotonic_ns();
+
+    for (int i = 0; i < toggles; i++) {
+        screen.set_viewport(47);
+        screen.set_viewport(23);
+    }
+
+    const uint64_t toggle_ns = (monotonic_ns() - start) / toggles;
+    RecordProperty("viewport_toggle_ns", std::to_string(toggle_ns));
+
+    // No new pad, nothing laid out again
+    EXPECT_EQ(screen.get_pad(), pad);
+    EXPECT_EQ(screen.get_n_lines(), 23);
+    EXPECT_LT(toggle_ns, 1000 * 1000);
+};
+
+// Test case: Going back to the previous width reuses its layout instead of reflowing.
+TEST_F(ScreenTest, WidthToggleUsesCachedLayout) {
+    Screen screen(23, 80, 0, 0);
+    write_lines(screen, FULL_PAD_LINES);
+
+    WINDOW *pad = screen.get_pad();
+    LayoutCache cache;
+
+    uint64_t start = monotonic_ns();
+    cache.relayout(screen, 23, 100);
+    const uint64_t reflow_ns = monotonic_ns() - start;
+
+    EXPECT_EQ(screen.get_n_cols(), 100);
+    EXPECT_NE(screen.get_pad(), pad);
+
+    start = monotonic_ns();
+    cache.relayout(screen, 23, 80);
+    const uint64_t cached_ns = monotonic_ns() - start;
+
+    RecordProperty("reflow_ns", std::to_string(reflow_ns));
+    RecordProperty("cached_ns", std::to_string(cached_ns));
+
+    EXPECT_EQ(screen.get_n_cols(), 80);
+    EXPECT_EQ(screen.get_pad(), pad);
+    EXPECT_LT(cached_ns, reflow_ns);
+};
+
+// Test case: Output after a reflow makes the cached layout stale.
+TEST_F(ScreenTest, CachedLayoutStaleAfterOutput) {
+    Screen screen(23, 80, 0, 0);
+    write_lines(screen, 10);
+
+    LayoutCache cache;
+
+    cache.relayout(screen, 23, 100);
+    write_lines(screen, 11);
+
+    cache.relayout(screen, 23, 80);
+
+    // Laid out again, so the new output is there
+    bool found = false;
+    for (int i = 0; i < screen.get_pad_height() && !found; i++) {
+        char line[16] = {0};
+        mvwinnstr(screen.get_pad(), i, 0, line, sizeof(line) - 1);
+        found = std::string(line).rfind("line 10 ", 0) == 0;
+    }
+
+    EXPECT_TRUE(found);
+};
+
+// Test case: Moving a screen hands over its pad, which is released exactly once.
+TEST_F(ScreenTest, MoveTransfersPad) {
+    Screen screen(23, 80, 0, 0);
+    WINDOW *pad = screen.get_pad();
+
+    Screen moved(std::move(screen));
+    EXPECT_EQ(moved.get_pad(), pad);
+    EXPECT_EQ(screen.get_pad(), nullptr);
+
+    screen = std::move(moved);
+    EXPECT_EQ(screen.get_pad(), pad);
+    EXPECT_EQ(moved.get_pad(), nullptr);
+};
+
+// Test case: The pad grows geometrically as the history gets longer.
+TEST_F(ScreenTest, PadGrowsGeometrically) {
+    Screen screen(23, 80, 0, 0);
+    write_lines(screen, 1000);
+
+    EXPECT_GE(screen.get_pad_height(), 1000);
+    EXPECT_LT(screen.get_pad_height(), 2000);
+};
+
+// Test case: Status queries are answered, the cursor position relative to the visible lines.
+TEST_F(ScreenTest, AnswersStatusQueries) {
+    Screen screen(10, 80, 0, 0);
+    write_lines(screen, 30);
+
+    for (const char ch : std::string("abc")) {
+        TerminalChar tch;
+        tch.ch = ch;
+        screen.handle_char(tch);
+    }
+
+    EXPECT_FALSE(screen.has_replies());
+
+    screen.handle_char(escape("\x1b[6n"));
+    screen.handle_char(escape("\x1b[c"));
+    screen.handle_char(escape("\x1b[5n"));
+
+    EXPECT_EQ(screen.take_replies(), "\x1b[10;4R" DA1_REPLY DSR_OK_REPLY);
+    EXPECT_FALSE(screen.has_replies());
+};
+
+// Test case: Shell integration marks index each command, the last output is read back from them.
+TEST_F(ScreenTest, IndexesCommandMarks) {
+    Screen screen(10, 80, 0, 0);
+
+    run_command(screen, "true", "", 0);
+    run_command(screen, "ls", "a\r\nb  \r\n", 0);
+    feed(screen, "\x1b]133;A\x07$ \x1b]133;B\x07");
+
+    const std::deque<CommandMark> &marks = screen.get_command_marks();
+    ASSERT_EQ(marks.size(), 3);
+    EXPECT_EQ(marks[1].prompt.line, 1);
+    EXPECT_EQ(marks[1].command.col, 2);
+    EXPECT_EQ(marks[1].output.line, 2);
+    EXPECT_EQ(marks[1].done.line, 4);
+    EXPECT_EQ(marks[1].exit_status, 0);
+    EXPECT_EQ(marks[2].exit_status, -1);
+
+    std::string output;
+    EXPECT_TRUE(screen.last_command_output(output));
+    EXPECT_EQ(output, "a\nb\n");
+
+    // A done mark without output is out of order and dropped
+    feed(screen, "\x1b]133;D;1\x07");
+    EXPECT_EQ(marks[2].done.line, -1);
+
+    // Nor do empty Enters at the prompts after it hide the last finished command
+    feed(screen, "\r\n\x1b]133;A\x07$ \x1b]133;B\x07\x1b]133;D;0\x07\r\n\x1b]133;A\x07$ ");
+    ASSERT_EQ(marks.size(), 5);
+    EXPECT_TRUE(screen.last_command_output(output));
+    EXPECT_EQ(output, "a\nb\n");
+};
+
+// Test case: Output longer than a line is read back joined, and still found after a reflow.
+TEST_F(ScreenTest, CommandMarksFollowReflow) {
+    Screen screen(10, 20, 0, 0);
+
+    const std::string long_line(30, 'x');
+    run_command(screen, "echo", long_line + "\r\n", 2);
+
+    std::string output;
+    EXPECT_TRUE(screen.last_command_output(output));
+    EXPECT_EQ(output, long_line + "\n");
+
+    Screen wide(10, 80, screen);
+    EXPECT_TRUE(wide.last_command_output(output));
+    EXPECT_EQ(output, long_line + "\n");
+    EXPECT_EQ(wide.get_command_marks()[0].exit_status, 2);
+};
+
+// Test case: In manual scroll, jumps go from prompt to prompt.
+TEST_F(ScreenTest, JumpsBetweenPrompts) {
+    Screen screen(5, 80, 0, 0);
+
+    for (int i = 0; i < 4; i++) {
+        run_command(screen, "seq", "1\r\n2\r\n3\r\n4\r\n", 0);
+    }
+
+    EXPECT_FALSE(screen.jump_to_prompt(true));
+
+    screen.enter_manual_scroll();
+    const std::deque<CommandMark> &marks = screen.get_command_marks();
+
+    EXPECT_TRUE(screen.jump_to_prompt(true));
+    EXPECT_EQ(screen.get_manual_scrolling_start(), marks[3].prompt.line);
+    EXPECT_TRUE(screen.jump_to_prompt(true));
+    EXPECT_EQ(screen.get_manual_scrolling_start(), marks[2].prompt.line);
+    EXPECT_TRUE(screen.jump_to_prompt(false));
+    EXPECT_EQ(screen.get_manual_scrolling_start(), marks[3].prompt.line);
+};
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+#include <session_history.hpp>
+
+class SessionHistoryTest : public testing::Test {
+public:
+    static std::string turn(const std::string &query, const std::string &result) {
+        return "Query: " + query + "\nAnswer: " + result + "\n";
+    }
+
+    static size_t tokens_of(const std::string &query, const std::string &result) {
+        const std::string encoded = turn(query, result);
+        return SessionHistory::estimate_tokens(encoded.data(), encoded.size());
+    }
+};
+
+// Test case: Within the budget the window is the whole history, encoded as the agency expects it.
+TEST_F(SessionHistoryTest, EncodesAsAppended) {
+    SessionHistory history;
+    EXPECT_EQ(history.window(), "");
+
+    history.append("list files", "ls");
+    history.append("disk usage", "du -sh");
+
+    EXPECT_EQ(history.window(), turn("list files", "ls") + turn("disk usage", "du -sh"));
+    ASSERT_EQ(history.size(), 2);
+    EXPECT_EQ(history[1], std::make_pair(std::string("disk usage"), std::string("du -sh")));
+
+    history.clear();
+    EXPECT_TRUE(history.empty());
+    EXPECT_EQ(history.window(), "");
+}
+
+// Test case: Only the most recent turns that fit are sent, however long the session runs.
+TEST_F(SessionHistoryTest, KeepsRecentTurnsWithinBudget) {
+    const size_t per_turn = tokens_of("query 00", "result 00");
+    SessionHistory history(per_turn * 3);
+
+    for (int i = 0; i < 1000; i++) {
+        char number[3];
+        snprintf(number, sizeof(number), "%02d", i % 100);
+        history.append(std::string("query ") + number, std::string("result ") + number);
+    }
+
+    EXPECT_EQ(history.window(), turn("query 97", "result 97") + turn("query 98", "result 98") + turn("query 99", "result 99"));
+    EXPECT_EQ(history.size(), 1000);
+}
+
+// Test case: Pinned turns stay in the window ahead of recent ones, in the order they were added.
+TEST_F(SessionHistoryTest, KeepsPinnedTurns) {
+    const size_t per_turn = tokens_of("query 0", "result 0");
+    SessionHistory history(per_turn * 3);
+
+    for (int i = 0; i < 10; i++) {
+        history.append("query " + std::to_string(i), "result " + std::to_string(i), i == 1);
+    }
+    history.pin(4);
+
+    EXPECT_EQ(history.window(), turn("query 1", "result 1") + turn("query 4", "result 4") + turn("query 9", "result 9"));
+
+    // Already in the recent stretch, counted once
+    history.pin(9);
+    EXPECT_EQ(history.window(), turn("query 1", "result 1") + turn("query 4", "result 4") + turn("query 9", "result 9"));
+
+    // More pinned than fit, the most recent of them win
+    history.pin(6);
+    history.pin(7);
+    EXPECT_EQ(history.window(), turn("query 6", "result 6") + turn("query 7", "result 7") + turn("query 9", "result 9"));
+}
+
+// Test case: An unpinned turn goes back to competing with the other turns by age.
+TEST_F(SessionHistoryTest, Unpin) {
+    const size_t per_turn = tokens_of("query 0", "result 0");
+    SessionHistory history(per_turn * 2);
+
+    for (int i = 0; i < 5; i++) {
+        history.append("query " + std::to_string(i), "result " + std::to_string(i), i == 0 || i == 2);
+    }
+    EXPECT_EQ(history.window(), turn("query 0", "result 0") + turn("query 2", "result 2"));
+
+    history.unpin(0);
+    history.unpin(0);
+    EXPECT_FALSE(history.is_pinned(0));
+    EXPECT_TRUE(history.is_pinned(2));
+    EXPECT_EQ(history.window(), turn("query 2", "result 2") + turn("query 4", "result 4"));
+}
+
+// Test case: A turn bigger than the whole budget is left out rather than blowing the request up.
+TEST_F(SessionHistoryTest, OversizedTurn) {
+    SessionHistory history(64);
+
+    history.append("old", "ok");
+    history.append("dump", std::string(4096, 'x'));
+    EXPECT_EQ(history.window(), "");
+
+    history.append("new", "ok");
+    EXPECT_EQ(history.window(), turn("new", "ok"));
+}
+
+// Test case: The estimate follows words, punctuation and bytes.
+TEST_F(SessionHistoryTest, EstimatesTokens) {
+    const auto estimate = [](const std::string &text) { return SessionHistory::estimate_tokens(text.data(), text.size()); };
+
+    EXPECT_EQ(estimate(""), 0);
+    EXPECT_EQ(estimate("ls"), 1);
+    EXPECT_EQ(estimate("ls -la /tmp"), 5);
+    EXPECT_EQ(estimate("configuration"), 4);
+
+    // Whitespace alone still counts by its bytes, so the budget bounds the size
+    EXPECT_EQ(estimate(std::string(800, ' ')), 100);
+
+    // Three bytes, one character
+    EXPECT_EQ(estimate("\xe2\x82\xac"), 1);
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <thread>
+
+#include <spsc_queue.hpp>
+
+class SpscQueueTest : public ::testing::Test {};
+
+// Test case: Items come out in order and a full queue rejects pushes.
+TEST_F(SpscQueueTest, OrderAndCapacity) {
+    SpscQueue<int> queue(2);
+    int item = 1;
+
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.push(item));
+    item = 2;
+    EXPECT_TRUE(queue.push(item));
+    EXPECT_TRUE(queue.full());
+
+    item = 3;
+    EXPECT_FALSE(queue.push(item));
+    EXPECT_EQ(item, 3);
+
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 1);
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 2);
+    EXPECT_FALSE(queue.pop(item));
+    EXPECT_TRUE(queue.empty());
+};
+
+// Test case: Everything a producer thread pushes reaches the consumer thread in order.
+TEST_F(SpscQueueTest, TwoThreads) {
+    SpscQueue<int> queue(16);
+    constexpr int count = 100000;
+
+    std::thread producer([&queue]() {
+        for (int i = 0; i < count; i++) {
+            int item = i;
+            while (!queue.push(item)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    bool in_order = true;
+    for (int expected = 0; expected < count;) {
+        int item;
+        if (queue.pop(item)) {
+            in_order = in_order && item == expected;
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_TRUE(queue.empty());
+};
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <session_history.hpp>
+#include <stream_parser.hpp>
+#include <utils.hpp>
+#include "../nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+// Feeds the stream in pieces of the given size
+static void feed_in_pieces(StreamParser &parser, const std::string &stream, const size_t piece) {
+    for (size_t i = 0; i < stream.size(); i += piece) {
+        parser.feed(stream.data() + i, std::min(piece, stream.size() - i));
+    }
+}
+
+// Test case: Only streamed content types are detected.
+TEST(StreamParserTest, DetectsFormat) {
+    StreamFormat format;
+    EXPECT_TRUE(StreamParser::detect("text/event-stream; charset=utf-8", format));
+    EXPECT_EQ(format, StreamFormat::SSE);
+    EXPECT_TRUE(StreamParser::detect("application/x-ndjson", format));
+    EXPECT_EQ(format, StreamFormat::NDJSON);
+    EXPECT_FALSE(StreamParser::detect("application/json", format));
+};
+
+// Test case: SSE deltas come out in order however the bytes are split.
+TEST(StreamParserTest, ServerSentEvents) {
+    const std::string stream =
+        ": keep-alive\r\n\r\n"
+        "event: delta\r\ndata: {\"delta\": \"Hel\"}\r\n\r\n"
+        "data: {\"delta\": \"lo\\n\"}\n\n"
+        "data: plain\ndata: text\n\n"
+        "data: [DONE]\n\n"
+        "data: {\"delta\": \"after done\"}\n\n";
+
+    for (const size_t piece : {1, 3, 7, 1000}) {
+        std::vector<std::string> deltas;
+        StreamParser parser(StreamFormat::SSE, [&deltas](const std::string &delta) { deltas.push_back(delta); });
+
+        feed_in_pieces(parser, stream, piece);
+        parser.finish();
+
+        EXPECT_EQ(deltas, (std::vector<std::string>{"Hel", "lo\n", "plain\ntext"}));
+        EXPECT_EQ(parser.get_text(), "Hello\nplain\ntext");
+        EXPECT_TRUE(parser.is_done());
+        EXPECT_TRUE(parser.get_error().empty());
+    }
+};
+
+// Test case: NDJSON lines carry deltas, errors and the end, the last line may lack its newline.
+TEST(StreamParserTest, NewlineDelimitedJson) {
+    const std::string stream = "{\"content\": \"a\"}\n\n{\"delta\": \"b\"}\n{\"error\": \"overloaded\", \"done\": true}";
+
+    std::string seen;
+    StreamParser parser(StreamFormat::NDJSON, [&seen](const std::string &delta) { seen += delta; });
+
+    feed_in_pieces(parser, stream, 5);
+    EXPECT_FALSE(parser.is_done());
+
+    parser.finish();
+    EXPECT_EQ(seen, "ab");
+    EXPECT_EQ(parser.get_error(), "overloaded");
+    EXPECT_TRUE(parser.is_done());
+};
+
+// Test case: Fields of the wrong type are ignored rather than thrown out of the curl callback.
+TEST(StreamParserTest, MalformedFields) {
+    const std::string stream =
+        "{\"delta\": \"a\", \"done\": 1}\n"
+        "{\"delta\": 7, \"done\": null}\n"
+        "{\"content\": [\"x\"], \"done\": \"yes\"}\n"
+        "{\"error\": {\"code\": \"\\u00ff\"}, \"delta\": \"b\"}\n"
+        "{\"delta\": \"c\", \"done\": true}\n";
+
+    std::string seen;
+    StreamParser parser(StreamFormat::NDJSON, [&seen](const std::string &delta) { seen += delta; });
+
+    EXPECT_NO_THROW(feed_in_pieces(parser, stream, 4));
+    EXPECT_EQ(seen, "abc");
+    EXPECT_EQ(parser.get_error(), "{\"code\":\"\xc3\xbf\"}");
+    EXPECT_TRUE(parser.is_done());
+};
+
+// Test case: Plain text that is not UTF-8 is cleaned up, so the next request built from the history still dumps.
+TEST(StreamParserTest, InvalidUtf8PlainText) {
+    StreamParser parser(StreamFormat::SSE, nullptr);
+    const std::string stream = "data: caf\xe9\n\ndata: \xc0\x80 ok\n\n";
+    parser.feed(stream.data(), stream.size());
+    parser.finish();
+
+    EXPECT_EQ(parser.get_text(), "caf??? ok");
+
+    SessionHistory history;
+    history.append("query", parser.get_text());
+    const json request = {{"query", "next"}, {"session_history", history.window()}};
+    EXPECT_NO_THROW(request.dump());
+};
+
+// Test case: A line that never ends is dropped at the limit instead of growing without bound.
+TEST(StreamParserTest, OverlongLine) {
+    StreamParser parser(StreamFormat::NDJSON, nullptr);
+
+    const std::string piece(64 * 1024, 'x');
+    for (size_t fed = 0; fed <= STREAM_LINE_MAX; fed += piece.size()) {
+        parser.feed(piece.data(), piece.size());
+    }
+    EXPECT_FALSE(parser.get_error().empty());
+
+    // The next line is read as usual
+    const std::string next = "\n{\"delta\": \"after\"}\n";
+    parser.feed(next.data(), next.size());
+    EXPECT_EQ(parser.get_text(), "after");
+};
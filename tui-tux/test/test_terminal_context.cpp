@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+#include <string>
+
+#include <terminal_context.hpp>
+#include "../nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+class TerminalContextTest : public ::testing::Test {
+public:
+    void SetUp() override {
+        map_shared_terminal_context();
+    }
+
+    // Other tests build agent requests, which must not pick up what was published here
+    void TearDown() override {
+        munmap(shared_terminal_context, sizeof(SharedTerminalContext));
+        shared_terminal_context = nullptr;
+    }
+};
+
+// Test case: Nothing is read before anything was published.
+TEST_F(TerminalContextTest, EmptyUntilPublished) {
+    const TerminalContext context = read_terminal_context();
+    EXPECT_EQ(context.source, TERMINAL_CONTEXT_NONE);
+    EXPECT_TRUE(context.output.empty());
+};
+
+// Test case: What is published is read back, the latest wins.
+TEST_F(TerminalContextTest, PublishAndRead) {
+    publish_terminal_context(TERMINAL_CONTEXT_LAST_LINES, -1, "old");
+    publish_terminal_context(TERMINAL_CONTEXT_LAST_COMMAND, 2, "ls: cannot access 'x'\n");
+
+    const TerminalContext context = read_terminal_context();
+    EXPECT_EQ(context.source, TERMINAL_CONTEXT_LAST_COMMAND);
+    EXPECT_EQ(context.exit_status, 2);
+    EXPECT_FALSE(context.truncated);
+    EXPECT_EQ(context.output, "ls: cannot access 'x'\n");
+};
+
+// Test case: Long output keeps its end within the budget.
+TEST_F(TerminalContextTest, TruncatedToBudget) {
+    const std::string output = "first\n" + std::string(TERMINAL_CONTEXT_BUDGET, 'x') + "\nlast\n";
+    publish_terminal_context(TERMINAL_CONTEXT_LAST_COMMAND, 0, output);
+
+    const TerminalContext context = read_terminal_context();
+    EXPECT_TRUE(context.truncated);
+    EXPECT_EQ(context.output.size(), TERMINAL_CONTEXT_BUDGET);
+    EXPECT_EQ(context.output.substr(context.output.size() - 6), "\nlast\n");
+};
+
+// Test case: Cuts land on whole characters, stray bytes are replaced.
+TEST_F(TerminalContextTest, KeepsUtf8Valid) {
+    EXPECT_EQ(tail_within_budget("a\xc3\xa9" "b", 2), "b");
+    EXPECT_EQ(tail_within_budget("a\xc3\xa9" "b", 3), "\xc3\xa9" "b");
+    EXPECT_EQ(sanitize_utf8("ok \xe2\x82\xac \xff\xc3"), "ok \xe2\x82\xac ??");
+};
+
+// Test case: Overlong forms, surrogates and leads past U+10FFFF are replaced, so the output always dumps as JSON.
+TEST_F(TerminalContextTest, RejectsIllFormedUtf8) {
+    // Overlong
+    EXPECT_EQ(sanitize_utf8("\xc0\x80"), "??");
+    EXPECT_EQ(sanitize_utf8("\xc1\xbf"), "??");
+    EXPECT_EQ(sanitize_utf8("\xe0\x80\x80"), "???");
+    EXPECT_EQ(sanitize_utf8("\xf0\x80\x80\x80"), "????");
+
+    // UTF-16 surrogate
+    EXPECT_EQ(sanitize_utf8("\xed\xa0\x80"), "???");
+
+    // Past U+10FFFF
+    EXPECT_EQ(sanitize_utf8("\xf4\x90\x80\x80"), "????");
+    EXPECT_EQ(sanitize_utf8("\xf5\x80\x80\x80"), "????");
+    EXPECT_EQ(sanitize_utf8("\xf7\xbf\xbf\xbf"), "????");
+
+    // The edges that are valid
+    const std::string valid = "\xc2\x80 \xe0\xa0\x80 \xed\x9f\xbf \xee\x80\x80 \xf0\x90\x80\x80 \xf4\x8f\xbf\xbf";
+    EXPECT_EQ(sanitize_utf8(valid), valid);
+
+    for (const std::string &text : {std::string("\xc0\x80"), std::string("\xe0\x80\x80"), std::string("\xed\xa0\x80"),
+                                    std::string("\xf5\x80\x80\x80"), valid}) {
+        EXPECT_NO_THROW(json(sanitize_utf8(text)).dump());
+    }
+};
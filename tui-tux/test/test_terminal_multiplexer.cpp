@@ -54,6 +54,32 @@ public:
         stdin_to_app = pipefd[1];
     }
 
+    // Read whatever the app wrote to the named pipe, giving up after the given number of seconds
+    static int read_fifo(char *buf, const size_t size, const int seconds) {
+        // Open named pipe in read non-blocking mode
+        const int pipefd = open(FIFO_NAME, O_RDONLY | O_NONBLOCK);
+
+        int n;
+
+        const time_t time_start = time(nullptr);
+
+        while (true) {
+            n = static_cast<int>(read(pipefd, buf, size - 1));
+            if (n > 0) {
+                break;
+            }
+
+            // Check if time is up
+            if (time(nullptr) - time_start >= seconds) {
+                break;
+            }
+        }
+
+        close(pipefd);
+
+        return n;
+    }
+
     void TearDown() override {
         close(stdin_to_app);
 
@@ -80,32 +106,119 @@ TEST_F(TerminalMultiplexerTest, SwitchAndBash) {
     command += FIFO_NAME;
     command += "; exit\n";
     write(stdin_to_app, command.c_str(), command.size());
-    
-    // Open named pipe in read non-blocking mode
-    const int pipefd = open(FIFO_NAME, O_RDONLY | O_NONBLOCK);
 
     // Try to get results for 1-2 seconds
     char buf[128] = {0};
-    int n;
+    const int n = read_fifo(buf, sizeof(buf), 2);
 
-    const time_t time_start = time(nullptr);
+    unlink(FIFO_NAME);
 
-    while (true) {
-        n = static_cast<int>(read(pipefd, buf, sizeof(buf) - 1));
-        if (n > 0) {
-            break;
-        }
+    EXPECT_EQ(n, 4);
+    EXPECT_STREQ(buf, "test");
+};
 
-        // Check if time is up
-        if (time(nullptr) - time_start >= 2) {
-            break;
-        }
+// Test case: Check that keystrokes still get through while a pane floods its pty
+TEST_F(TerminalMultiplexerTest, FloodDoesNotStarveInput) {
+    // Create named pipe to retrieve results
+    if (const int rc = mkfifo(FIFO_NAME, 0666); rc < 0) {
+        perror("mkfifo");
+        exit(EXIT_FAILURE);
     }
 
-    close(pipefd);
+    // Switch to bash and start flooding its pane
+    std::string command = "\x02\tyes\n";
+    write(stdin_to_app, command.c_str(), command.size());
+    sleep(1);
+
+    // Interrupt the flood, then run the command
+    command = "\x03";
+    command += "echo -n test >";
+    command += FIFO_NAME;
+    command += "; exit\n";
+    write(stdin_to_app, command.c_str(), command.size());
+
+    char buf[128] = {0};
+    const int n = read_fifo(buf, sizeof(buf), 10);
 
     unlink(FIFO_NAME);
 
     EXPECT_EQ(n, 4);
     EXPECT_STREQ(buf, "test");
-};
+}
+
+// Test case: Check that a bracketed paste reaches the pane without triggering key bindings
+TEST_F(TerminalMultiplexerTest, PasteBypassesKeyBindings) {
+    // Create named pipe to retrieve results
+    if (const int rc = mkfifo(FIFO_NAME, 0666); rc < 0) {
+        perror("mkfifo");
+        exit(EXIT_FAILURE);
+    }
+
+    // Switch to bash, then paste a command ending in ^B-TAB, which would switch back if interpreted
+    std::string command = "\x02\t" PASTE_BEGIN_MARKER "echo -n test >";
+    command += FIFO_NAME;
+    command += "; exit # \x02\t" PASTE_END_MARKER "\n";
+    write(stdin_to_app, command.c_str(), command.size());
+
+    char buf[128] = {0};
+    const int n = read_fifo(buf, sizeof(buf), 10);
+
+    unlink(FIFO_NAME);
+
+    EXPECT_EQ(n, 4);
+    EXPECT_STREQ(buf, "test");
+}
+
+// Test case: Check that a burst of resizes does not stall the app
+TEST_F(TerminalMultiplexerTest, ResizeStormStaysResponsive) {
+    // Create named pipe to retrieve results
+    if (const int rc = mkfifo(FIFO_NAME, 0666); rc < 0) {
+        perror("mkfifo");
+        exit(EXIT_FAILURE);
+    }
+
+    std::string command = "\x02\t";
+    write(stdin_to_app, command.c_str(), command.size());
+
+    // Like dragging a window edge
+    for (int i = 0; i < 200; i++) {
+        kill(child_pid, SIGWINCH);
+        usleep(1000);
+    }
+
+    command = "echo -n test >";
+    command += FIFO_NAME;
+    command += "; exit\n";
+    write(stdin_to_app, command.c_str(), command.size());
+
+    char buf[128] = {0};
+    const int n = read_fifo(buf, sizeof(buf), 10);
+
+    unlink(FIFO_NAME);
+
+    EXPECT_EQ(n, 4);
+    EXPECT_STREQ(buf, "test");
+}
+
+// Test case: Check that a cursor position query gets answered instead of timing out
+TEST_F(TerminalMultiplexerTest, AnswersCursorPositionQuery) {
+    // Create named pipe to retrieve results
+    if (const int rc = mkfifo(FIFO_NAME, 0666); rc < 0) {
+        perror("mkfifo");
+        exit(EXIT_FAILURE);
+    }
+
+    // Only writes the result if the reply arrives within a second
+    std::string command = "\x02\tprintf '\\033[6n'; read -rs -t 1 -d R reply && echo -n test >";
+    command += FIFO_NAME;
+    command += "; exit\n";
+    write(stdin_to_app, command.c_str(), command.size());
+
+    char buf[128] = {0};
+    const int n = read_fifo(buf, sizeof(buf), 10);
+
+    unlink(FIFO_NAME);
+
+    EXPECT_EQ(n, 4);
+    EXPECT_STREQ(buf, "test");
+}
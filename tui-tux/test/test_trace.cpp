@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "../nlohmann/json.hpp"
+#include <trace.hpp>
+
+#define TRACE_TEST_FILE "/tmp/ishell-testing-trace.json"
+
+using json = nlohmann::json;
+
+class TraceTest : public ::testing::Test {
+public:
+    void TearDown() override {
+        trace_stop();
+        unlink(TRACE_TEST_FILE);
+    }
+
+    static json read_trace() {
+        std::ifstream file(TRACE_TEST_FILE);
+        return json::parse(file);
+    }
+};
+
+// Test case: Spans of every thread end up in a valid trace.
+TEST_F(TraceTest, SpansFromThreads) {
+    ASSERT_TRUE(trace_start(TRACE_TEST_FILE));
+
+    {
+        TRACE_SPAN("main_span");
+    }
+
+    std::thread thread([] {
+        TRACE_SPAN("thread_span");
+    });
+    thread.join();
+
+    trace_stop();
+
+    const json trace = read_trace();
+    std::set<std::string> names;
+    std::set<int> tids;
+
+    for (const auto &event : trace) {
+        if (event["ph"] == "X") {
+            names.insert(event["name"].get<std::string>());
+            tids.insert(event["tid"].get<int>());
+            EXPECT_GE(event["dur"].get<double>(), 0);
+        }
+    }
+
+    EXPECT_EQ(names, std::set<std::string>({"main_span", "thread_span"}));
+    EXPECT_EQ(tids.size(), 2);
+};
+
+// Test case: Nothing is recorded while tracing is off.
+TEST_F(TraceTest, DisabledRecordsNothing) {
+    {
+        TRACE_SPAN("before");
+    }
+
+    ASSERT_TRUE(trace_start(TRACE_TEST_FILE));
+    trace_stop();
+
+    {
+        TRACE_SPAN("after");
+    }
+
+    const json trace = read_trace();
+    ASSERT_EQ(trace.size(), 1);
+    EXPECT_EQ(trace[0]["ph"], "M");
+};